@@ -0,0 +1,66 @@
+// example of saving tensors in aligned binary format, and loading them back without copy by memory map
+#include <cstdio>
+#include "mshadow/tensor.h"
+#include "mshadow/tensor_io.h"
+using namespace mshadow;
+using namespace mshadow::expr;
+
+int main( void ){
+    InitTensorEngine();
+    // a double vector, a byte matrix with odd number of elements, and a padded double matrix
+    TensorContainer<cpu,1,double> vec( Shape1( 7 ) );
+    TensorContainer<cpu,2,uint8_t> bytes( Shape2( 3, 5 ) );
+    TensorContainer<cpu,2,double> mat( Shape2( 3, 5 ) );
+    for( index_t i = 0; i < vec.shape[0]; ++ i ) vec[i] = i * 0.25;
+    for( index_t i = 0; i < mat.shape[1]; ++ i ){
+        for( index_t j = 0; j < mat.shape[0]; ++ j ){
+            bytes[i][j] = static_cast<uint8_t>( i * 10 + j );
+            mat[i][j] = i - j * 0.5;
+        }
+    }
+    {// each record is padded, so the content of each tensor starts at aligned offset
+        utils::FileStream fo( fopen( "binary-io.bin", "wb" ) );
+        SaveBinaryAligned( fo, vec );
+        SaveBinaryAligned( fo, bytes );
+        SaveBinaryAligned( fo, mat );
+        fo.Close();
+    }
+    int nerr = 0;
+    {// zero-copy load, the tensors point into the mapped file
+        utils::MMapStream fi( "binary-io.bin" );
+        Tensor<cpu,1,double> v;
+        Tensor<cpu,2,uint8_t> b;
+        Tensor<cpu,2,double> m;
+        LoadBinaryMapped( fi, v );
+        LoadBinaryMapped( fi, b );
+        LoadBinaryMapped( fi, m );
+        for( index_t i = 0; i < v.shape[0]; ++ i ) nerr += v[i] != vec[i];
+        for( index_t i = 0; i < m.shape[1]; ++ i ){
+            for( index_t j = 0; j < m.shape[0]; ++ j ){
+                nerr += b[i][j] != bytes[i][j];
+                nerr += m[i][j] != mat[i][j];
+            }
+        }
+        printf( "mapped: vector of %u, %u x %u bytes, %u x %u matrix\n", v.shape[0], b.shape[1], b.shape[0], m.shape[1], m.shape[0] );
+    }
+    {// the same file can also be read into allocated space
+        utils::FileStream fi( fopen( "binary-io.bin", "rb" ) );
+        TensorContainer<cpu,1,double> v( Shape1( 7 ) );
+        TensorContainer<cpu,2,uint8_t> b( Shape2( 3, 5 ) );
+        TensorContainer<cpu,2,double> m( Shape2( 3, 5 ) );
+        LoadBinaryAligned( fi, v, true );
+        LoadBinaryAligned( fi, b, true );
+        LoadBinaryAligned( fi, m, true );
+        for( index_t i = 0; i < v.shape[0]; ++ i ) nerr += v[i] != vec[i];
+        for( index_t i = 0; i < m.shape[1]; ++ i ){
+            for( index_t j = 0; j < m.shape[0]; ++ j ){
+                nerr += b[i][j] != bytes[i][j];
+                nerr += m[i][j] != mat[i][j];
+            }
+        }
+        fi.Close();
+    }
+    printf( "%d mismatch\n", nerr );
+    ShutdownTensorEngine();
+    return nerr != 0;
+}
@@ -0,0 +1,275 @@
+#pragma once
+// data iterator that prepares batches in background threads
+#include <vector>
+#include "mshadow/tensor.h"
+#include "mshadow/tensor_byte.h"
+#include "mshadow/tensor_thread.h"
+#include "util.h"
+
+using namespace mshadow;
+
+/*! \brief a batch of data */
+struct DataBatch{
+    /*! \brief content, each row is an instance */
+    TensorContainer<cpu,2> data;
+    /*! \brief label of each instance */
+    std::vector<int> label;
+};
+
+/*!
+ * \brief source of batches, each batch of an epoch can be filled independently,
+ *        so batches can be prepared by many threads at the same time
+ */
+class IBatchSource{
+public:
+    virtual ~IBatchSource( void ){}
+    /*! \return number of batches in an epoch */
+    virtual index_t NumBatch( void ) const = 0;
+    /*! \brief allocate space of batch */
+    virtual void InitBatch( DataBatch &batch ) const = 0;
+    /*! \brief start a new epoch, e.g. reshuffle the data, no batch is being filled during this call */
+    virtual void BeforeEpoch( void ) = 0;
+    /*! \brief fill i-th batch of current epoch, called concurrently for different batches */
+    virtual void FillBatch( index_t ibatch, DataBatch &batch ) const = 0;
+};
+
+/*!
+ * \brief random augmentation of images, each image is zero padded, then a random window is cropped and mirrored at random,
+ *        the random choices depend only on seed, epoch and position of the image in epoch,
+ *        so the result does not depend on which thread processes the image
+ */
+struct ImageAugmenter{
+    /*! \brief number of zeros padded at each border */
+    index_t pad;
+    /*! \brief whether crop at random position, otherwise crop at center */
+    bool rand_crop;
+    /*! \brief whether mirror half of the images at random */
+    bool rand_mirror;
+    /*! \brief random seed */
+    uint32_t seed;
+    ImageAugmenter( void ):pad(0), rand_crop(false), rand_mirror(false), seed(0){}
+    /*! \return whether any augmentation is enabled */
+    inline bool Enabled( void ) const{
+        return pad != 0 || rand_crop || rand_mirror;
+    }
+    /*!
+     * \brief augment one image, convert to real_t and write to dst
+     * \param dst output image, in shape (channel,height,width), same as src
+     * \param src source image in uint8
+     * \param mean value subtracted
+     * \param scale value multiplied after subtracting mean
+     * \param epoch current epoch
+     * \param pos position of the image in epoch
+     */
+    inline void Process( Tensor<cpu,3> dst, const Tensor<cpu,3,uint8_t> &src, real_t mean, real_t scale, uint32_t epoch, uint64_t pos ) const{
+        using namespace expr;
+        const uint32_t key[2] = { seed, epoch };
+        uint32_t w[4];
+        philox::Block( w, pos, key );
+        const index_t yoff = rand_crop ? w[0] % ( 2 * pad + 1 ) : pad;
+        const index_t xoff = rand_crop ? w[1] % ( 2 * pad + 1 ) : pad;
+        const Shape<2> cshape = Shape2( dst.shape[1], dst.shape[0] );
+        if( rand_mirror && ( w[2] & 1 ) ){
+            dst = mirror( crop( expr::pad( normalize( src, mean, scale ), this->pad ), cshape, yoff, xoff ) );
+        }else{
+            dst = crop( expr::pad( normalize( src, mean, scale ), this->pad ), cshape, yoff, xoff );
+        }
+    }
+};
+
+/*!
+ * \brief mnist dataset in memory, the order of instances is reshuffled at each epoch,
+ *        only the index is shuffled, and batches are gathered from the permuted index,
+ *        pixels are kept as uint8, and converted to real_t when a batch is gathered,
+ *        training images can be augmented by an ImageAugmenter
+ */
+class MNISTSource: public IBatchSource{
+public:
+    MNISTSource( const char *path_img, const char *path_label, index_t batch_size, bool do_shuffle,
+                 const ImageAugmenter &aug = ImageAugmenter() )
+        :batch_size_(batch_size), do_shuffle_(do_shuffle), aug_(aug), epoch_(0){
+        LoadMNIST( path_img, path_label, ylabel_, xdata_ );
+        for( index_t i = 0; i < xdata_.shape[1]; ++ i ){
+            rindex_.push_back( i );
+        }
+        printf("finish loading %ux%u uint8 matrix from %s, shuffle=%d\n", xdata_.shape[1], xdata_.shape[0], path_img, (int)do_shuffle );
+    }
+    virtual ~MNISTSource( void ){
+        FreeSpace( xdata_ );
+    }
+    virtual index_t NumBatch( void ) const{
+        return xdata_.shape[1] / batch_size_;
+    }
+    virtual void InitBatch( DataBatch &batch ) const{
+        batch.data.Resize( Shape2( batch_size_, xdata_.shape[0] ) );
+        batch.label.resize( batch_size_ );
+    }
+    virtual void BeforeEpoch( void ){
+        if( do_shuffle_ ) shuffle( rindex_ );
+        ++ epoch_;
+    }
+    virtual void FillBatch( index_t ibatch, DataBatch &batch ) const{
+        const index_t *index = &rindex_[ ibatch * batch_size_ ];
+        if( aug_.Enabled() ){
+            // each image is augmented and written to its row in batch
+            const long n = static_cast<long>( batch_size_ );
+            #pragma omp parallel for schedule(static)
+            for( long k = 0; k < n; ++ k ){
+                const Shape<3> s = Shape3( 1, kSize, kSize );
+                aug_.Process( Tensor<cpu,3>( batch.data[k].dptr, s ), Tensor<cpu,3,uint8_t>( xdata_[ index[k] ].dptr, s ),
+                              0.0f, 1.0f / 256.0f, epoch_, static_cast<uint64_t>( ibatch ) * batch_size_ + k );
+            }
+        }else{
+            // gather and convert in one pass
+            batch.data = expr::normalize( xdata_, index, batch_size_, 0.0f, 1.0f / 256.0f );
+        }
+        for( index_t k = 0; k < batch_size_; ++ k ){
+            batch.label[k] = ylabel_[ index[k] ];
+        }
+    }
+private:
+    // mnist images are 28x28
+    static const index_t kSize = 28;
+    index_t batch_size_;
+    bool do_shuffle_;
+    ImageAugmenter aug_;
+    uint32_t epoch_;
+    Tensor<cpu,2,uint8_t> xdata_;
+    std::vector<int> ylabel_;
+    // order of instances in current epoch
+    std::vector<index_t> rindex_;
+};
+
+/*!
+ * \brief iterator that prefetches batches of an IBatchSource in background threads,
+ *        batches are kept in a ring of nbuffer slots, so at most nbuffer - 1 batches are prepared ahead of the one in use
+ *        the order of batches is the same as the source, regardless of the number of threads
+ *
+ *  usage:
+ *    PrefetchIterator itr( &src, 2, 3 );
+ *    itr.BeforeFirst();
+ *    while( itr.Next() ){ const DataBatch &b = itr.Value(); ... }
+ */
+class PrefetchIterator{
+public:
+    /*!
+     * \brief constructor
+     * \param src source of batches, not owned
+     * \param nthread number of producer threads, 0 means batches are filled in Next
+     * \param nbuffer number of batch buffers, at least 2 when threads are used
+     */
+    PrefetchIterator( IBatchSource *src, int nthread = 1, int nbuffer = 3 )
+        :src_(src), destroy_(false), busy_(0), has_value_(false){
+        #if !MSHADOW_USE_PTHREAD
+        nthread = 0;
+        #endif
+        if( nthread == 0 ) nbuffer = 1;
+        utils::Assert( nthread == 0 || nbuffer >= 2, "PrefetchIterator: need at least 2 buffers to prefetch" );
+        slots_.resize( nbuffer );
+        for( size_t i = 0; i < slots_.size(); ++ i ){
+            src_->InitBatch( slots_[i].batch );
+            slots_[i].ready = false;
+        }
+        nbatch_ = src_->NumBatch();
+        // nothing to produce until BeforeFirst
+        next_fill_ = nbatch_; next_read_ = released_ = 0;
+        for( int i = 0; i < nthread; ++ i ){
+            threads_.push_back( new utils::Thread() );
+            threads_.back()->Start( ProducerEntry, this );
+        }
+    }
+    ~PrefetchIterator( void ){
+        mutex_.Lock();
+        destroy_ = true;
+        produce_.Broadcast();
+        mutex_.Unlock();
+        for( size_t i = 0; i < threads_.size(); ++ i ){
+            threads_[i]->Join(); delete threads_[i];
+        }
+    }
+    /*! \brief start a new epoch, batches being prepared for the previous epoch are discarded */
+    inline void BeforeFirst( void ){
+        utils::ScopedLock lock( mutex_ );
+        // stop claiming batches, and wait for the batches in progress
+        next_fill_ = nbatch_;
+        while( busy_ != 0 ) consume_.Wait( mutex_ );
+        src_->BeforeEpoch();
+        for( size_t i = 0; i < slots_.size(); ++ i ) slots_[i].ready = false;
+        next_fill_ = next_read_ = released_ = 0;
+        has_value_ = false;
+        produce_.Broadcast();
+    }
+    /*! \brief move to next batch, return false if the epoch ends */
+    inline bool Next( void ){
+        if( threads_.size() == 0 ){
+            if( next_read_ == nbatch_ ) return false;
+            src_->FillBatch( next_read_ ++, slots_[0].batch );
+            current_ = 0;
+            return true;
+        }
+        utils::ScopedLock lock( mutex_ );
+        if( has_value_ ){
+            // release the slot of previous batch to producers
+            slots_[ current_ ].ready = false;
+            ++ released_; has_value_ = false;
+            produce_.Broadcast();
+        }
+        if( next_read_ == nbatch_ ) return false;
+        current_ = next_read_ % slots_.size();
+        while( !slots_[ current_ ].ready ) consume_.Wait( mutex_ );
+        ++ next_read_; has_value_ = true;
+        return true;
+    }
+    /*! \brief current batch, valid until next call of Next or BeforeFirst */
+    inline const DataBatch &Value( void ) const{
+        return slots_[ current_ ].batch;
+    }
+private:
+    struct Slot{
+        DataBatch batch;
+        bool ready;
+    };
+    IBatchSource *src_;
+    std::vector<Slot> slots_;
+    std::vector<utils::Thread*> threads_;
+    utils::Mutex mutex_;
+    // producers wait on produce_, consumer waits on consume_
+    utils::ConditionVariable produce_, consume_;
+    bool destroy_;
+    // number of producers filling a batch
+    int busy_;
+    // whether consumer holds a batch
+    bool has_value_;
+    // slot of current batch
+    size_t current_;
+    // batches in epoch, next batch to claim by producers, next batch to read, batches released by consumer
+    index_t nbatch_, next_fill_, next_read_, released_;
+private:
+    inline static void *ProducerEntry( void *arg ){
+        static_cast<PrefetchIterator*>( arg )->Produce();
+        return NULL;
+    }
+    inline void Produce( void ){
+        mutex_.Lock();
+        while( true ){
+            // batch b goes to slot b % nbuffer, which is free after batch b - nbuffer is released
+            while( !destroy_ && !( next_fill_ < nbatch_ && next_fill_ < released_ + slots_.size() ) ){
+                produce_.Wait( mutex_ );
+            }
+            if( destroy_ ) break;
+            const index_t ibatch = next_fill_ ++;
+            ++ busy_;
+            mutex_.Unlock();
+            Slot &s = slots_[ ibatch % slots_.size() ];
+            src_->FillBatch( ibatch, s.batch );
+            mutex_.Lock();
+            s.ready = true;
+            -- busy_;
+            consume_.Broadcast();
+        }
+        mutex_.Unlock();
+    }
+    // not copyable
+    PrefetchIterator( const PrefetchIterator &it );
+    PrefetchIterator& operator=( const PrefetchIterator &it );
+};
@@ -4,6 +4,8 @@
 #include "mshadow/tensor.h"
 // helper function to load mnist dataset
 #include "util.h"
+// data iterator that prefetches batches
+#include "iter.h"
 // this namespace contains all data structures, functions
 using namespace mshadow;
 // this namespace contains all operator overloads
@@ -146,22 +148,23 @@ int main( int argc, char *argv[] ){
     TensorContainer<cpu,2> pred;    
     pred.Resize( Shape2( batch_size, num_out ) );
     
-    // label 
-    std::vector<int> ytrain, ytest;
     // data
-    TensorContainer<cpu,2> xtrain, xtest;
-    LoadMNIST( "train-images-idx3-ubyte", "train-labels-idx1-ubyte", ytrain, xtrain, true);
-    LoadMNIST( "t10k-images-idx3-ubyte", "t10k-labels-idx1-ubyte", ytest, xtest, false);
+    MNISTSource train( "train-images-idx3-ubyte", "train-labels-idx1-ubyte", batch_size, true );
+    MNISTSource test( "t10k-images-idx3-ubyte", "t10k-labels-idx1-ubyte", batch_size, false );
+    // batches are prepared in a background thread while the net is computing
+    PrefetchIterator itr_train( &train, 1, 3 ), itr_test( &test, 1, 3 );
     
     int num_iter = 20;
 
     for( int i = 0; i < num_iter; ++ i ){
         // training 
-        for( index_t j = 0; j + batch_size <= xtrain.shape[1]; j += batch_size ){
-            net->Forward( xtrain.Slice( j, j + batch_size ), pred );
+        itr_train.BeforeFirst();
+        while( itr_train.Next() ){
+            const DataBatch &batch = itr_train.Value();
+            net->Forward( batch.data, pred );
             // set gradient into pred
             for( int k = 0; k < batch_size; ++ k ){
-                pred[k][ ytrain[k+j] ] -= 1.0f;
+                pred[k][ batch.label[k] ] -= 1.0f;
             }
             // scale gradient by batchs zie
             pred *= 1.0f / batch_size;
@@ -171,15 +174,17 @@ int main( int argc, char *argv[] ){
             net->Update();
         }
         // evaluation
-        long nerr = 0;
-        for( index_t j = 0; j + batch_size <= xtest.shape[1]; j += batch_size ){
-            net->Forward( xtest.Slice( j, j + batch_size ), pred );            
+        long nerr = 0, ntest = 0;
+        itr_test.BeforeFirst();
+        while( itr_test.Next() ){
+            const DataBatch &batch = itr_test.Value();
+            net->Forward( batch.data, pred );            
             for( int k = 0; k < batch_size; ++ k ){                
-                nerr += MaxIndex( pred[k] ) != ytest[j+k];
-                
+                nerr += MaxIndex( pred[k] ) != batch.label[k];
             }
+            ntest += batch_size;
         }
-        printf("round %d: test-err=%f\n", i, (float)nerr/xtest.shape[1] );
+        printf("round %d: test-err=%f\n", i, (float)nerr/ntest );
     }    
     delete net;
     ShutdownTensorEngine();
@@ -26,9 +26,9 @@ inline void shuffle( std::vector<T> &data ){
     shuffle( &data[0], data.size() );
 }
 
-// simple function to load in mnist
+// load mnist as uint8 pixels, each row of xdata is an image, xdata is allocated and must be freed by FreeSpace
 inline void LoadMNIST( const char *path_img, const char *path_label,
-                       std::vector<int>& ylabel, TensorContainer<cpu,2>& xdata, bool do_shuffle ){
+                       std::vector<int>& ylabel, Tensor<cpu,2,uint8_t>& xdata ){
     // load in data
     FILE *fi = fopen( path_img, "rb" );
     if( fi == NULL ){
@@ -36,7 +36,7 @@ inline void LoadMNIST( const char *path_img, const char *path_label,
         exit(-1);
     }
     unsigned char zz[4];
-    unsigned char *t_data, *l_data;
+    unsigned char *l_data;
     int num_image, width, height, nlabel;            
     assert( fread(zz, 4 , 1, fi ) );
     assert( fread(zz, 4 , 1, fi ) );    
@@ -47,8 +47,9 @@ inline void LoadMNIST( const char *path_img, const char *path_label,
     height = pack( zz );
 
     int step = width * height;
-    t_data = new unsigned char[ num_image * step ];    
-    assert( fread( t_data, step*num_image , 1 , fi ) );
+    xdata.shape = Shape2( num_image, step );
+    AllocSpace( xdata, false );
+    assert( fread( xdata.dptr, step*num_image , 1 , fi ) );
     fclose( fi );
     
     // load in label
@@ -59,24 +60,10 @@ inline void LoadMNIST( const char *path_img, const char *path_label,
     assert( num_image == nlabel );
     l_data = new unsigned char[ num_image ];
     assert( fread( l_data, num_image , 1 , fi ) );    
-    // try to do shuffle 
-    std::vector<int> rindex;
-    for( int i = 0; i < num_image; ++ i ){
-        rindex.push_back( i );
-    }
-    if( do_shuffle ){
-        shuffle( rindex );
-    }
-
-    // save out result
+    fclose( fi );
     ylabel.resize( num_image );
-    xdata.Resize( Shape2( num_image, width * height ) );
     for( int i = 0 ; i < num_image ; ++i ){
-        for( int j = 0; j < step; ++j ) {
-            xdata[ i ][ j ] = (float)(t_data[ rindex[i]*step + j ]) / 256.0f;            
-        }        
-        ylabel[ i ] = l_data[ rindex[i] ];
+        ylabel[ i ] = l_data[ i ];
     }
-    delete[] t_data; delete [] l_data;
-    printf("finish loading %dx%d matrix from %s, shuffle=%d\n", num_image, step, path_img, (int)do_shuffle );
+    delete [] l_data;
 }
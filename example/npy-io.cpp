@@ -0,0 +1,66 @@
+// example of reading and writing NumPy .npy files, and of the fallback when a file can not be mapped without copy
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "mshadow/tensor.h"
+#include "mshadow/tensor_npy.h"
+using namespace mshadow;
+
+// write a .npy file of 2 x 3 elements with given dtype and order, as numpy would do
+inline void WriteRaw( const char *fname, const char *descr, bool fortran_order, const void *data, size_t nbytes ){
+    std::string dict = std::string( "{'descr': '" ) + descr + "', 'fortran_order': " + ( fortran_order ? "True" : "False" ) + ", 'shape': (2, 3), }";
+    dict.append( ( 10 + dict.length() + 1 + 63 ) / 64 * 64 - 10 - dict.length() - 1, ' ' );
+    dict += '\n';
+    std::string h( npy::kMagic, sizeof(npy::kMagic) );
+    h += '\x01'; h += '\x00';
+    h += static_cast<char>( dict.length() & 0xFF );
+    h += static_cast<char>( dict.length() >> 8 );
+    h += dict;
+    FILE *fp = fopen( fname, "wb" );
+    fwrite( h.data(), h.length(), 1, fp );
+    fwrite( data, nbytes, 1, fp );
+    fclose( fp );
+}
+
+int main( void ){
+    InitTensorEngine();
+    int nerr = 0;
+    TensorContainer<cpu,2> mat( Shape2( 2, 3 ) );
+    for( index_t i = 0; i < mat.shape[1]; ++ i ){
+        for( index_t j = 0; j < mat.shape[0]; ++ j ) mat[i][j] = i * 10 + j;
+    }
+    {// real_t in native order is mapped without copy
+        utils::FileStream fo( fopen( "npy-io-real.npy", "wb" ) );
+        SaveNpy( fo, mat );
+        fo.Close();
+        utils::MMapStream fi( "npy-io-real.npy" );
+        Tensor<cpu,2> m;
+        if( !LoadNpyMapped( fi, m ) ){
+            ++ nerr;
+        }else{
+            for( index_t i = 0; i < m.shape[1]; ++ i ){
+                for( index_t j = 0; j < m.shape[0]; ++ j ) nerr += m[i][j] != mat[i][j];
+            }
+        }
+    }
+    {// float16 can not be mapped, LoadNpyMapped returns false, and LoadNpy converts a copy
+        const uint16_t half[6] = { 0x0000, 0x3c00, 0x4000, 0x4900, 0x4980, 0x4a00 };
+        WriteRaw( "npy-io-half.npy", "<f2", false, half, sizeof(half) );
+        utils::MMapStream fi( "npy-io-half.npy" );
+        Tensor<cpu,2> m;
+        nerr += LoadNpyMapped( fi, m );
+        TensorContainer<cpu,2> c( Shape2( 2, 3 ) );
+        LoadNpy( fi, c, true );
+        nerr += c[0][1] != 1.0f || c[1][0] != 10.0f || c[1][2] != 12.0f;
+    }
+    {// fortran order is not supported by mapping either
+        const real_t data[6] = { 0, 10, 1, 11, 2, 12 };
+        WriteRaw( "npy-io-fortran.npy", npy::RealDescr(), true, data, sizeof(data) );
+        utils::MMapStream fi( "npy-io-fortran.npy" );
+        Tensor<cpu,2> m;
+        nerr += LoadNpyMapped( fi, m );
+    }
+    printf( "%d mismatch\n", nerr );
+    ShutdownTensorEngine();
+    return nerr != 0;
+}
@@ -0,0 +1,39 @@
+// benchmark of row pitch of CPU tensors: column-wise access of sum_rows and swapaxis on n x n matrices,
+// rows of an unpadded matrix have power of two pitch and map to the same cache sets,
+// AllocSpace with padding adds one cache line to such pitch, see MSHADOW_CPU_ANTI_ALIAS
+#include <cstdio>
+#include <ctime>
+#include "mshadow/tensor.h"
+using namespace mshadow;
+using namespace mshadow::expr;
+
+const int kRepeat = 20;
+
+// average time of one run in ms, for one layout of source
+inline void Bench( index_t n, bool pad ){
+    Tensor<cpu,2> src( Shape2( n, n ) ), dst( Shape2( n, n ) );
+    Tensor<cpu,1> sum( Shape1( n ) );
+    AllocSpace( src, pad ); AllocSpace( dst, pad ); AllocSpace( sum );
+    src = 1.0f;
+    clock_t start = clock();
+    for( int i = 0; i < kRepeat; ++ i ) sum = sum_rows( src );
+    const double tsum = static_cast<double>( clock() - start ) * 1000.0 / CLOCKS_PER_SEC / kRepeat;
+    start = clock();
+    for( int i = 0; i < kRepeat; ++ i ) dst = swapaxis<0,1>( src );
+    const double tswap = static_cast<double>( clock() - start ) * 1000.0 / CLOCKS_PER_SEC / kRepeat;
+    printf( "%-6u%-9u%7.2fms%14.2fms\n", n, src.shape.stride_, tsum, tswap );
+    FreeSpace( src ); FreeSpace( dst ); FreeSpace( sum );
+}
+
+int main( void ){
+    InitTensorEngine();
+    printf( "average of %d reps, n x n matrix, single thread\n", kRepeat );
+    printf( "%-6s%-9s%9s%16s\n", "n", "stride", "sum_rows", "swapaxis<0,1>" );
+    const index_t sizes[] = { 1024, 2048 };
+    for( int i = 0; i < 2; ++ i ){
+        Bench( sizes[i], false );
+        Bench( sizes[i], true );
+    }
+    ShutdownTensorEngine();
+    return 0;
+}
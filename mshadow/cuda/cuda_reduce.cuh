@@ -11,17 +11,19 @@ namespace mshadow{
          * \brief reduce over the dimension x
          * \tparam Reducer reducer
          * \tparam x_bits dimension = 1<<x_bits
+         * \tparam DType element type of buffer
          */
-        template<typename Reducer,int x_bits>
-        inline __device__ void Reduce1D( volatile real_t buf[1<<x_bits] );
+        template<typename Reducer,int x_bits,typename DType>
+        inline __device__ void Reduce1D( volatile DType buf[1<<x_bits] );
         /*
          * \brief reduce over the dimension x
          * \tparam Reducer reducer
          * \tparam xmax_bits maximum size of buffer
+         * \tparam DType element type of buffer
          * \param xsize size of x dimension, not sure if aligned
          */
-        template<typename Reducer, int xmax_bits>
-        inline __device__ void Reduce1DNotAlign( volatile real_t buf[1<<xmax_bits], int xsize );
+        template<typename Reducer, int xmax_bits, typename DType>
+        inline __device__ void Reduce1DNotAlign( volatile DType buf[1<<xmax_bits], int xsize );
     };
 };
 
@@ -37,8 +39,8 @@ namespace mshadow{
 
 namespace mshadow{
     namespace cuda{        
-        template<typename Reducer, int x_bits>
-        inline __device__ void ReduceX( volatile real_t buf[], int tid ){
+        template<typename Reducer, int x_bits, typename DType>
+        inline __device__ void ReduceX( volatile DType buf[], int tid ){
             if( x_bits >= 10 ){
                 if( tid < 512 ) Reducer::Reduce( buf[tid] , buf[tid + 512] );
                 __syncthreads(); 
@@ -82,8 +84,8 @@ namespace mshadow{
             }  
         };
         
-        template<typename Reducer,int x_bits>
-        inline __device__ void Reduce1D( volatile real_t buf[1<<x_bits] ){
+        template<typename Reducer,int x_bits,typename DType>
+        inline __device__ void Reduce1D( volatile DType buf[1<<x_bits] ){
             ReduceX<Reducer,x_bits>( buf, threadIdx.x );
         }
 
@@ -98,8 +100,8 @@ namespace mshadow{
                 ReduceX<Reducer, x_bits>( buf, tid );                   \
             }                                                           \
             
-        template<typename Reducer, int xmax_bits>
-        inline __device__ void Reduce1DNotAlign( volatile real_t buf[], int x_size ){
+        template<typename Reducer, int xmax_bits, typename DType>
+        inline __device__ void Reduce1DNotAlign( volatile DType buf[], int x_size ){
             int tid = threadIdx.x;
             __RD_NON_ALIGN(, 8)
             __RD_NON_ALIGN(else, 7)
@@ -53,8 +53,8 @@ namespace mshadow{
     };
 
     namespace cuda {
-        template<typename Saver, typename Plan, int block_dim_bits>
-        __device__ void MapPlanProc( Tensor<gpu,2> dst, const index_t xstride, const Plan exp, int block_idx ){
+        template<typename Saver, typename Plan, int block_dim_bits, typename DType>
+        __device__ void MapPlanProc( Tensor<gpu,2,DType> dst, const index_t xstride, const Plan exp, int block_idx ){
             const index_t tid = (block_idx << block_dim_bits) + threadIdx.x;
             const int y   = tid / xstride;
             const int x   = tid % xstride;
@@ -62,19 +62,19 @@ namespace mshadow{
                 Saver::Save(dst[y][x], exp.Eval(y,x));
             }
         }
-        template<typename Saver, typename Plan, int block_dim_bits>
-        __global__ void MapPlanKernel( Tensor<gpu,2> dst, const index_t xstride, const Plan exp ){
+        template<typename Saver, typename Plan, int block_dim_bits, typename DType>
+        __global__ void MapPlanKernel( Tensor<gpu,2,DType> dst, const index_t xstride, const Plan exp ){
             MapPlanProc<Saver, Plan,block_dim_bits>( dst, xstride, exp, blockIdx.x );
         }
-        template<typename Saver, typename Plan, int block_dim_bits, int grid_size>
-        __global__ void MapPlanLargeKernel( Tensor<gpu,2> dst, const index_t xstride, const Plan exp, int repeat ){
+        template<typename Saver, typename Plan, int block_dim_bits, int grid_size, typename DType>
+        __global__ void MapPlanLargeKernel( Tensor<gpu,2,DType> dst, const index_t xstride, const Plan exp, int repeat ){
             for( int i = 0; i < repeat; ++i ){
                 MapPlanProc<Saver, Plan,block_dim_bits>( dst, xstride, exp, blockIdx.x + i*grid_size );
             }
         }        
         
-        template<typename Saver, typename E>
-        inline void MapPlan( Tensor<gpu,2> dst, const expr::Plan<E> &plan ){
+        template<typename Saver, typename E, typename DType>
+        inline void MapPlan( Tensor<gpu,2,DType> dst, const expr::Plan<E> &plan ){
             const index_t xstride = GetAlignStride( dst.shape[0], dst.shape.stride_ );
             const int num_block = ( dst.shape[1]*xstride + kBaseThreadNum-1) / kBaseThreadNum;
             dim3 dimBlock(kBaseThreadNum, 1, 1);
@@ -93,20 +93,21 @@ namespace mshadow{
     }; // namespace cuda
     
     namespace cuda{
-        template<typename Saver,typename Reducer, int warp_bits, typename Plan>
-        __global__ void MapRedKeepLowestKernel( Tensor<gpu,1> dst, Plan plan, real_t scale, Shape<2> eshape ){
+        template<typename Saver,typename Reducer, int warp_bits, typename Plan, typename DType>
+        __global__ void MapRedKeepLowestKernel( Tensor<gpu,1,DType> dst, Plan plan, typename DataType<DType>::ComputeType scale, Shape<2> eshape ){
+            typedef typename DataType<DType>::ComputeType CType;
             const unsigned warp_size = 1 << warp_bits;
             const unsigned x = (blockIdx.x<<warp_bits) + threadIdx.x;
-            // to avoid bank conflict
-            __shared__ real_t s_res[ warp_size ][ warp_size + 1 ];
+            // to avoid bank conflict, reduction is done in compute type of DType
+            __shared__ CType s_res[ warp_size ][ warp_size + 1 ];
 
             // note: reverse store [y][x], so that we can reduce over threadIdx.x, use warp optimization
             if( threadIdx.y < eshape[1] && x < eshape[0] ){
-                s_res[ threadIdx.x ][ threadIdx.y ] = plan.Eval( threadIdx.y, x );
+                s_res[ threadIdx.x ][ threadIdx.y ] = static_cast<CType>( plan.Eval( threadIdx.y, x ) );
             }
             for( unsigned y = warp_size; y < eshape[1]; y += warp_size ){
                 if( threadIdx.y + y < eshape[1] && x < eshape[0] ){
-                    Reducer::Reduce( s_res[ threadIdx.x ][ threadIdx.y ], plan.Eval( threadIdx.y + y, x ) );
+                    Reducer::Reduce( s_res[ threadIdx.x ][ threadIdx.y ], static_cast<CType>( plan.Eval( threadIdx.y + y, x ) ) );
                 }
             } 
             __syncthreads();
@@ -122,8 +123,8 @@ namespace mshadow{
             } 
         }        
         
-        template<typename Saver, typename Reducer, typename E>
-        inline void MapReduceKeepLowest( Tensor<gpu,1> dst, const expr::Plan<E> &plan, real_t scale, Shape<2> eshape ){
+        template<typename Saver, typename Reducer, typename E, typename DType>
+        inline void MapReduceKeepLowest( Tensor<gpu,1,DType> dst, const expr::Plan<E> &plan, typename DataType<DType>::ComputeType scale, Shape<2> eshape ){
             dim3 dimBlock( kMemUnit, kMemUnit );
             dim3 dimGrid ( (eshape[0]+kMemUnit-1) >> kMemUnitBits );
             CheckLaunchParam( dimGrid, dimBlock, "MapRedKeepLowestKernel" );
@@ -132,14 +133,15 @@ namespace mshadow{
     }; // namespace cuda
     
     namespace cuda{
-        template<typename Saver,typename Reducer, int block_dim_bits, typename Plan>
-        __global__ void MapReduceKeepDim2Kernel( Tensor<gpu,1> dst, Plan plan, real_t scale, Shape<4> pshape ){
+        template<typename Saver,typename Reducer, int block_dim_bits, typename Plan, typename DType>
+        __global__ void MapReduceKeepDim2Kernel( Tensor<gpu,1,DType> dst, Plan plan, typename DataType<DType>::ComputeType scale, Shape<4> pshape ){
+            typedef typename DataType<DType>::ComputeType CType;
             const int block_size = 1 << block_dim_bits;
-            __shared__ real_t s_rec[ block_size ];
+            __shared__ CType s_rec[ block_size ];
             const int c = blockIdx.x;            
             const index_t tot = pshape[0]*pshape[1]*pshape[3];
 
-            real_t res = Reducer::kInitV;
+            CType res; Reducer::SetInitValue( res );
             for( index_t i_offset = 0; i_offset < tot; i_offset += block_size ){
                 index_t i = i_offset + threadIdx.x;
                 if( i< tot ){
@@ -147,7 +149,7 @@ namespace mshadow{
                     i /= pshape[0]; 
                     const index_t y = i % pshape[1];
                     const index_t n = i / pshape[1];
-                    Reducer::Reduce( res, plan.Eval( (n*pshape[2] + c) * pshape[1] + y, x ) );
+                    Reducer::Reduce( res, static_cast<CType>( plan.Eval( (n*pshape[2] + c) * pshape[1] + y, x ) ) );
                 }
             }                
             s_rec[ threadIdx.x ] = res;
@@ -158,8 +160,8 @@ namespace mshadow{
             }
         }
 
-        template<typename Saver, typename Reducer, typename Plan>
-        inline void MapReduceKeepDim2( Tensor<gpu,1> dst, const Plan &plan, real_t scale, Shape<4> pshape ){  
+        template<typename Saver, typename Reducer, typename Plan, typename DType>
+        inline void MapReduceKeepDim2( Tensor<gpu,1,DType> dst, const Plan &plan, typename DataType<DType>::ComputeType scale, Shape<4> pshape ){  
             dim3 dimBlock( kBaseThreadNum );
             dim3 dimGrid ( dst.shape[0] );
             CheckLaunchParam( dimGrid, dimBlock, "MapReduceKeepDim2" );
@@ -201,9 +201,11 @@ namespace mshadow {
      * \brief general tensor
      * \tparam Device which device the tensor is on
      * \tparam dimension dimension of the tensor
+     * \tparam DType element type of the tensor, default to real_t,
+     *         the tensor takes part in expression with type DataType<DType>::ComputeType
      */
-    template<typename Device, int dimension>
-    struct Tensor: public expr::ContainerExp< Tensor<Device,dimension> >{
+    template<typename Device, int dimension, typename DType = real_t>
+    struct Tensor: public expr::ContainerExp< Tensor<Device,dimension,DType>, typename DataType<DType>::ComputeType >{
     public:
         /*! \brief whether current type lies in cpu */
         const static bool kDevCPU = Device::kDevCPU;
@@ -212,7 +214,7 @@ namespace mshadow {
 
     public:
         /*! \brief pointer to the data */
-        real_t *dptr;
+        DType *dptr;
         /*! \brief shape of the tensor */
         Shape<dimension> shape;
     public:
@@ -221,24 +223,22 @@ namespace mshadow {
         /*! \brief constructor from shape  */
         MSHADOW_XINLINE Tensor(const Shape<dimension> &shape): shape(shape) {}
         /*! \brief constructor from data pointer and shape  */
-        MSHADOW_XINLINE Tensor(real_t *dptr, const Shape<dimension> &shape): dptr((real_t*)dptr), shape(shape) {}
+        MSHADOW_XINLINE Tensor(DType *dptr, const Shape<dimension> &shape): dptr(dptr), shape(shape) {}
         /*!
          * \brief flatten the tensor to 2 dimension, collapse the higher dimensions together
          * \return tensor after flatten
          */
-        MSHADOW_XINLINE Tensor<Device, 2> FlatTo2D(void) const {
-            return Tensor<Device, 2>(reinterpret_cast<real_t*> \
-                                     (dptr), shape.FlatTo2D());
+        MSHADOW_XINLINE Tensor<Device,2,DType> FlatTo2D(void) const {
+            return Tensor<Device,2,DType>(dptr, shape.FlatTo2D());
         }
         /*!
          * \brief get a element of dimension - 1
          * \param idx index
          * \return the result tensor
          */
-        MSHADOW_XINLINE Tensor<Device, kSubdim> operator[](index_t idx) const {
+        MSHADOW_XINLINE Tensor<Device,kSubdim,DType> operator[](index_t idx) const {
             Shape<kSubdim> s = shape.SubShape();
-            return Tensor<Device, kSubdim>(reinterpret_cast<real_t*> \
-                                           (dptr) + s.MSize() * idx, s);
+            return Tensor<Device,kSubdim,DType>(dptr + s.MSize() * idx, s);
         }
         /*!
          * \brief slice the tensor in highest dimension [begin,end)
@@ -246,25 +246,24 @@ namespace mshadow {
          * \param end end position of slice
          * \return tensor after slice
          */
-        MSHADOW_XINLINE Tensor<Device, dimension> Slice(index_t begin, index_t end) const {
+        MSHADOW_XINLINE Tensor<Device,dimension,DType> Slice(index_t begin, index_t end) const {
             Shape<dimension> s = this->shape;
             s[ dimension - 1 ] = end - begin;
-            return Tensor<Device, dimension>(reinterpret_cast<real_t*>\
-                                             (dptr) + s.SubShape().MSize() * begin, s);
+            return Tensor<Device,dimension,DType>(dptr + s.SubShape().MSize() * begin, s);
         }
     public:
         /*!\brief functions to fit expression template */
-        inline Tensor<Device,dimension>& operator=( real_t s ){
+        inline Tensor<Device,dimension,DType>& operator=( typename DataType<DType>::ComputeType s ){
             return this->__assign( s );
         }
         /*!\brief functions to fit expression template */
         template<typename E>
-        inline Tensor<Device,dimension>& operator=( const expr::Exp<E,expr::type::kMapper> &exp ){
+        inline Tensor<Device,dimension,DType>& operator=( const expr::Exp<E,expr::type::kMapper> &exp ){
             return this->__assign( exp );
         }
         /*!\brief functions to fit expression template */
         template<typename E>
-        inline Tensor<Device,dimension>& operator=( const expr::Exp<E,expr::type::kComplex> &exp ){
+        inline Tensor<Device,dimension,DType>& operator=( const expr::Exp<E,expr::type::kComplex> &exp ){
             return this->__assign( exp );
         }
     };
@@ -272,39 +271,37 @@ namespace mshadow {
     /*
      *  respecialized class Tensor1D,thei is due to different implementation in operator[]
      */
-    template<typename Device>
-    struct Tensor<Device,1>: public expr::ContainerExp< Tensor<Device,1> >{
+    template<typename Device, typename DType>
+    struct Tensor<Device,1,DType>: public expr::ContainerExp< Tensor<Device,1,DType>, typename DataType<DType>::ComputeType >{
     public:
-        real_t *dptr;
+        DType *dptr;
         Shape<1> shape;
     public:
         MSHADOW_XINLINE Tensor(void) {}
         MSHADOW_XINLINE Tensor(const Shape<1> &shape): shape(shape) {}
-        MSHADOW_XINLINE Tensor(real_t *dptr, Shape<1> shape) :dptr(dptr), shape(shape) {}
+        MSHADOW_XINLINE Tensor(DType *dptr, Shape<1> shape) :dptr(dptr), shape(shape) {}
 
-        MSHADOW_XINLINE Tensor<Device, 2> FlatTo2D(void) const {
-            return Tensor<Device, 2>(reinterpret_cast<real_t*> \
-                                     (dptr), shape.FlatTo2D());
+        MSHADOW_XINLINE Tensor<Device,2,DType> FlatTo2D(void) const {
+            return Tensor<Device,2,DType>(dptr, shape.FlatTo2D());
         }
-        MSHADOW_XINLINE Tensor<Device, 1> Slice(index_t begin, index_t end) const {
+        MSHADOW_XINLINE Tensor<Device,1,DType> Slice(index_t begin, index_t end) const {
             Shape<1> s;
             s[0] = s.stride_ = end  - begin;
-            return Tensor<Device, 1>(reinterpret_cast<real_t*> \
-                                     (dptr) + begin, s);
+            return Tensor<Device,1,DType>(dptr + begin, s);
         }
-        MSHADOW_XINLINE real_t &operator[](index_t idx) { return dptr[ idx ]; }
-        MSHADOW_XINLINE const real_t &operator[](index_t idx)const { return dptr[ idx ]; }
+        MSHADOW_XINLINE DType &operator[](index_t idx) { return dptr[ idx ]; }
+        MSHADOW_XINLINE const DType &operator[](index_t idx)const { return dptr[ idx ]; }
     public:
         // functions to fit expression template
-        inline Tensor<Device,1>& operator=( double s ){
+        inline Tensor<Device,1,DType>& operator=( typename DataType<DType>::ComputeType s ){
             return this->__assign( s );
         }
         template<typename E>
-        inline Tensor<Device,1>& operator=( const expr::Exp<E,expr::type::kMapper> &exp ){
+        inline Tensor<Device,1,DType>& operator=( const expr::Exp<E,expr::type::kMapper> &exp ){
             return this->__assign( exp );
         }
         template<typename E>
-        inline Tensor<Device,1>& operator=( const expr::Exp<E,expr::type::kComplex> &exp ){
+        inline Tensor<Device,1,DType>& operator=( const expr::Exp<E,expr::type::kComplex> &exp ){
             return this->__assign( exp );
         }
     };
@@ -331,28 +328,43 @@ namespace mshadow {
      * \brief CPU/CPU: allocate space for CTensor, according to the shape in the obj
      *        this function is responsible to set the stride_ in each obj.shape
      * \tparam dim specify the dim of tensor
+     * \tparam DType element type of tensor
      * \param obj the tensor object, with shape specified
      * \param pad whether padding dimension 0, to make last dimension aligned,
      *            padding may help improve efficiency of matrix multiplications
      *            if true, will allocate space with stride_ that may not equals shape[0]
      *            if false, will allocate continuous space
      */
-    template<int dim>
-    inline void AllocSpace(Tensor<cpu,dim> &obj, bool pad = MSHADOW_ALLOC_PAD);
+    template<int dim, typename DType>
+    inline void AllocSpace(Tensor<cpu,dim,DType> &obj, bool pad = MSHADOW_ALLOC_PAD);
     /*! \brief refer to comment of cpu ver \sa AllocSpace */
-    template<int dim>
-    inline void AllocSpace(Tensor<gpu,dim> &obj, bool pad = MSHADOW_ALLOC_PAD);
+    template<int dim, typename DType>
+    inline void AllocSpace(Tensor<gpu,dim,DType> &obj, bool pad = MSHADOW_ALLOC_PAD);
+
+    /*!
+     * \brief CPU/GPU: allocate space for tensor, and set all the content to zero,
+     *        CPU version on linux obtains pre-zeroed pages from system for large space, so no explicit write pass happens,
+     *        and pages are not touched until they are used
+     * \tparam dim specify the dim of tensor
+     * \param obj the tensor object, with shape specified
+     * \param pad whether padding dimension 0, \sa AllocSpace
+     */
+    template<int dim, typename DType>
+    inline void AllocZeroSpace(Tensor<cpu,dim,DType> &obj, bool pad = MSHADOW_ALLOC_PAD);
+    /*! \brief refer to comment of cpu ver \sa AllocZeroSpace */
+    template<int dim, typename DType>
+    inline void AllocZeroSpace(Tensor<gpu,dim,DType> &obj, bool pad = MSHADOW_ALLOC_PAD);
 
     /*!
      * \brief CPU/GPU: free the space of tensor, will set obj.dptr to NULL
      * \tparam dim specify the dim of tensor
      * \param obj the tensor object
      */
-    template<int dim>
-    inline void FreeSpace(Tensor<cpu,dim> &obj);
+    template<int dim, typename DType>
+    inline void FreeSpace(Tensor<cpu,dim,DType> &obj);
     /*! \brief refer to comment of cpu ver \sa FreeSpace */
-    template<int dim>
-    inline void FreeSpace(Tensor<gpu,dim> &obj);
+    template<int dim, typename DType>
+    inline void FreeSpace(Tensor<gpu,dim,DType> &obj);
 
     /*!
      * \brief CPU/GPU: short cut to allocate and initialize a Tensor
@@ -365,24 +377,44 @@ namespace mshadow {
      */
     template<typename Device, int dim>
     inline Tensor<Device,dim> NewTensor(const Shape<dim> &shape, real_t initv, bool pad = MSHADOW_ALLOC_PAD);
+    /*!
+     * \brief CPU/GPU: same as NewTensor, for tensor of element type DType, usage: NewTensor<cpu,double>( shape, 0.0 )
+     * \tparam Device device of tensor
+     * \tparam DType element type of tensor
+     * \tparam dim dimention of tensor
+     */
+    template<typename Device, typename DType, int dim>
+    inline Tensor<Device,dim,DType> NewTensor(const Shape<dim> &shape, typename expr::ExpInfo< Tensor<Device,dim,DType> >::DType initv,
+                                              bool pad = MSHADOW_ALLOC_PAD);
 
     /*!
      * \brief copy data from one tensor to another, with same shape
      * \tparam dim specify the dim of tensor
+     * \tparam DType element type of tensor
      * \param dst target tensor
      * \param src source tensor
      */
-    template<int dim>
-    inline void Copy(Tensor<cpu,dim> dst, const Tensor<cpu,dim> &src );
+    template<int dim, typename DType>
+    inline void Copy(Tensor<cpu,dim,DType> dst, const Tensor<cpu,dim,DType> &src );
     /*! \brief refer to comment of cpu ver \sa Copy */
-    template<int dim>
-    inline void Copy(Tensor<cpu,dim> dst, const Tensor<gpu,dim> &src );
+    template<int dim, typename DType>
+    inline void Copy(Tensor<cpu,dim,DType> dst, const Tensor<gpu,dim,DType> &src );
     /*! \brief refer to comment of cpu ver \sa Copy */
-    template<int dim>
-    inline void Copy(Tensor<gpu,dim> dst, const Tensor<cpu,dim> &src );
+    template<int dim, typename DType>
+    inline void Copy(Tensor<gpu,dim,DType> dst, const Tensor<cpu,dim,DType> &src );
     /*! \brief refer to comment of cpu ver \sa Copy */
-    template<int dim>
-    inline void Copy(Tensor<gpu,dim> dst, const Tensor<gpu,dim> &src );
+    template<int dim, typename DType>
+    inline void Copy(Tensor<gpu,dim,DType> dst, const Tensor<gpu,dim,DType> &src );
+    /*!
+     * \brief CPU: gather rows of src into dst, dst[i] = src[ index[i] ], used to assemble a mini-batch
+     *        from a permutation of the dataset, so shuffling only moves the index, 
+     *        dst = take( src, index ) on cpu is carried out by this function
+     * \param dst destination, dst.shape[1] rows
+     * \param src source, each row is an instance
+     * \param index row indices in src, dst.shape[1] elements
+     */
+    template<typename DType>
+    inline void BatchGather( Tensor<cpu,2,DType> dst, const Tensor<cpu,2,DType> &src, const index_t *index );
 
 
     /*!
@@ -407,15 +439,16 @@ namespace mshadow{
      * \tparam dim dim of the tensor, during usage, there is no need to specify this parameter
      * \tparam E specifies the expression type, not need to specify this parameter during usage
      * \tparam etype expression type
+     * \tparam DType element type of the tensor, must be the same as element type of expression
      * \param dst destination
      * \param exp expression
      * \sa namespace mshadow:sv, mshadow::op, mshadow::expr
      */
-    template<typename Saver, int dim, typename E, int etype>
-    inline void MapExp(Tensor<cpu,dim> dst, const expr::Exp<E,etype> &exp );
+    template<typename Saver, int dim, typename E, int etype, typename DType>
+    inline void MapExp(Tensor<cpu,dim,DType> dst, const expr::Exp<E,etype> &exp );
     /*! \brief refer to comment of cpu ver \sa MapExp */
-    template<typename Saver, int dim, typename E, int etype>
-    inline void MapExp(Tensor<gpu,dim> dst, const expr::Exp<E,etype> &exp );
+    template<typename Saver, int dim, typename E, int etype, typename DType>
+    inline void MapExp(Tensor<gpu,dim,DType> dst, const expr::Exp<E,etype> &exp );
 
     /*!
      * \brief CPU/GPU: map a expression, do reduction to 1D Tensor in lowest dimension (dimension 0)
@@ -428,11 +461,11 @@ namespace mshadow{
      * \param scale scale the result before save
      * \sa namespace mshadow:sv, mshadow::op, mshadow::red, mshadow::expr
      */
-    template<typename Saver, typename Reducer, typename E, int etype>
-    inline void MapReduceKeepLowest( Tensor<cpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale = 1.0f );
+    template<typename Saver, typename Reducer, typename E, int etype, typename DType>
+    inline void MapReduceKeepLowest( Tensor<cpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale = 1 );
     /*! \brief refer to comment of cpu ver \sa MapReduceKeepLowest */
-    template<typename Saver, typename Reducer, typename E, int etype>
-    inline void MapReduceKeepLowest( Tensor<gpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale = 1.0f );
+    template<typename Saver, typename Reducer, typename E, int etype, typename DType>
+    inline void MapReduceKeepLowest( Tensor<gpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale = 1 );
 
 
     /*!
@@ -447,11 +480,11 @@ namespace mshadow{
      * \param scale scale the result before save
      * \sa namespace mshadow:sv, mshadow::op, mshadow::red, mshadow::expr
      */
-    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype>
-    inline void MapReduceKeepHighDim( Tensor<cpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale = 1.0f );
+    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype, typename DType>
+    inline void MapReduceKeepHighDim( Tensor<cpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale = 1 );
     /*! \brief refer to comment of cpu ver \sa MapReduceKeepHighDim */
-    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype>
-    inline void MapReduceKeepHighDim( Tensor<gpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale = 1.0f );
+    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype, typename DType>
+    inline void MapReduceKeepHighDim( Tensor<gpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale = 1 );
 
 };// namespace mshadow
 
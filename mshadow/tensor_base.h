@@ -10,6 +10,8 @@
 #include <cstdio>
 #include <cfloat>
 #include <climits>
+#include <limits>
+#include <stdint.h>
 #include <algorithm>
 // macro defintiions
 
@@ -32,6 +34,50 @@
     #define MSHADOW_MIN_PAD_RATIO 2
 #endif
 
+/*! 
+ * \brief alignment in bytes of each row in padded CPU allocation, default to cache line size,
+ *        rows narrower than MSHADOW_MIN_PAD_RATIO * MSHADOW_CPU_ALIGN_BYTES only get 16 bytes alignment required by sse
+ */
+#ifndef MSHADOW_CPU_ALIGN_BYTES
+    #define MSHADOW_CPU_ALIGN_BYTES 64
+#endif
+
+/*! 
+ * \brief whether add one extra cache line to padded CPU rows whose pitch is power of two or multiple of 4K,
+ *        such pitch maps all rows into the same cache sets, and slows down column-wise access, e.g. sum_rows, swapaxis
+ */
+#ifndef MSHADOW_CPU_ANTI_ALIAS
+    #define MSHADOW_CPU_ANTI_ALIAS 1
+#endif
+
+/*! 
+ * \brief CPU Copy larger than this number of bytes use non-temporal streaming store, so it won't evict the cache,
+ *        should be set around the size of last level cache
+ */
+#ifndef MSHADOW_COPY_STREAM_BYTES
+    #define MSHADOW_COPY_STREAM_BYTES (32UL << 20)
+#endif
+
+/*! \brief CPU Copy larger than this number of bytes is split over threads, when compiled with OpenMP */
+#ifndef MSHADOW_COPY_PARALLEL_BYTES
+    #define MSHADOW_COPY_PARALLEL_BYTES (1UL << 20)
+#endif
+/*!
+ * \brief CPU compute kernel with more than this number of basic operations, e.g. multiply-adds or element conversions,
+ *        is split over threads, when compiled with OpenMP
+ */
+#ifndef MSHADOW_PARALLEL_WORK_THRESHOLD
+    #define MSHADOW_PARALLEL_WORK_THRESHOLD (1UL << 16)
+#endif
+/*! \brief size of user space buffer of BufferedFileStream, in bytes */
+#ifndef MSHADOW_IO_BUFFER_BYTES
+    #define MSHADOW_IO_BUFFER_BYTES (4UL << 20)
+#endif
+/*! \brief header and content of each record written by SaveBinaryAligned are padded to multiple of this number of bytes */
+#ifndef MSHADOW_BINARY_ALIGN_BYTES
+    #define MSHADOW_BINARY_ALIGN_BYTES 64
+#endif
+
 #if MSHADOW_STAND_ALONE
    #define MSHADOW_USE_CBLAS 0
    #define MSHADOW_USE_MKL   0
@@ -62,6 +108,30 @@
 #ifndef MSHADOW_USE_NVML
   #define MSHADOW_USE_NVML 0
 #endif
+/*! \brief whether use pthread for background threads, such as asynchronous checkpoint writer */
+#ifndef MSHADOW_USE_PTHREAD
+  #ifdef _WIN32
+    #define MSHADOW_USE_PTHREAD 0
+  #else
+    #define MSHADOW_USE_PTHREAD 1
+  #endif
+#endif
+/*! \brief whether use POSIX file functions: mmap for zero-copy loading, pread for parallel loading */
+#ifndef MSHADOW_USE_MMAP
+  #ifdef _WIN32
+    #define MSHADOW_USE_MMAP 0
+  #else
+    #define MSHADOW_USE_MMAP 1
+  #endif
+#endif
+/*! \brief whether use F16C instructions to convert half precision floats, on when the compiler targets F16C, e.g. -mf16c */
+#ifndef MSHADOW_USE_F16C
+  #ifdef __F16C__
+    #define MSHADOW_USE_F16C 1
+  #else
+    #define MSHADOW_USE_F16C 0
+  #endif
+#endif
 // SSE is conflict with cudacc
 #ifdef __CUDACC__
   #undef MSHADOW_USE_SSE
@@ -100,7 +170,14 @@ extern "C"{
 /*! \brief cpu force inline */
 #define MSHADOW_CINLINE inline __attribute__((always_inline))
 
+/*! \brief whether the compiler supports c++11, this enables features such as move semantics */
 #if defined(__GXX_EXPERIMENTAL_CXX0X) || defined(__GXX_EXPERIMENTAL_CXX0X__) || __cplusplus >= 201103L
+  #define MSHADOW_IN_CXX11 1
+#else
+  #define MSHADOW_IN_CXX11 0
+#endif
+
+#if MSHADOW_IN_CXX11
   #define MSHADOW_CONSTEXPR constexpr
 #else
   #define MSHADOW_CONSTEXPR const
@@ -114,13 +191,24 @@ namespace mshadow {
     const float kPi = 3.1415926f;
 
 #if MSHADOW_SINGLE_PRECISION
-    /*! \brief type that will be used for content */
+    /*! \brief type that will be used for content, the default element type of Tensor */
     typedef float real_t;
 #else
     typedef double real_t;
 #endif
     /*! \brief type that will be used for index */
     typedef unsigned index_t;
+    /*!
+     * \brief traits of element type of Tensor,
+     *        ComputeType is the type an element is converted to when it is evaluated in expression,
+     *        storage only types such as bf16_t specialize it to float
+     * \tparam DType element type
+     */
+    template<typename DType>
+    struct DataType{
+        /*! \brief type used in computation */
+        typedef DType ComputeType;
+    };
 }; // namespace mshadow
 
 namespace mshadow {
@@ -130,35 +218,40 @@ namespace mshadow {
         /*! \brief mul operator */
         struct mul{
             /*! \brief map a, b to result using defined operation */
-            MSHADOW_XINLINE static real_t Map(real_t a, real_t b) {
+            template<typename DType>
+            MSHADOW_XINLINE static DType Map(DType a, DType b) {
                 return a * b;
             }
         };
         /*! \brief plus operator */
         struct plus {
             /*! \brief map a, b to result using defined operation */
-            MSHADOW_XINLINE static real_t Map(real_t a, real_t b) {
+            template<typename DType>
+            MSHADOW_XINLINE static DType Map(DType a, DType b) {
                 return a + b;
             }
         };
         /*! \brief minus operator */
         struct minus {
             /*! \brief map a, b to result using defined operation */
-            MSHADOW_XINLINE static real_t Map(real_t a, real_t b) {
+            template<typename DType>
+            MSHADOW_XINLINE static DType Map(DType a, DType b) {
                 return a - b;
             }
         };
         /*! \brief divide operator */
         struct div {
             /*! \brief map a, b to result using defined operation */
-            MSHADOW_XINLINE static real_t Map(real_t a, real_t b) {
+            template<typename DType>
+            MSHADOW_XINLINE static DType Map(DType a, DType b) {
                 return a / b;
             }
         };
         /*! \brief get rhs */
         struct right {
             /*! \brief map a, b to result using defined operation */
-            MSHADOW_XINLINE static real_t Map(real_t a, real_t b) {
+            template<typename DType>
+            MSHADOW_XINLINE static DType Map(DType a, DType b) {
                 return b;
             }
         };
@@ -168,8 +261,9 @@ namespace mshadow {
     namespace sv {
         /*! \brief save to saver: = */
         struct saveto {
-            /*! \brief save b to a using save method */
-            MSHADOW_XINLINE static void Save(real_t& a, real_t b) {
+            /*! \brief save b to a using save method, RType is the compute type of DType */
+            template<typename DType, typename RType>
+            MSHADOW_XINLINE static void Save(DType& a, RType b) {
                 a  = b;
             }
             /*! \brief helper constant to use BLAS, alpha */
@@ -181,8 +275,9 @@ namespace mshadow {
         };
         /*! \brief save to saver: += */
         struct plusto {
-            /*! \brief save b to a using save method */
-            MSHADOW_XINLINE static void Save(real_t& a, real_t b) {
+            /*! \brief save b to a using save method, RType is the compute type of DType */
+            template<typename DType, typename RType>
+            MSHADOW_XINLINE static void Save(DType& a, RType b) {
                 a += b;
             }
             /*! \brief helper constant to use BLAS, alpha */
@@ -194,8 +289,9 @@ namespace mshadow {
         };
         /*! \brief minus to saver: -= */
         struct minusto {
-            /*! \brief save b to a using save method */
-            MSHADOW_XINLINE static void Save(real_t& a, real_t b) {
+            /*! \brief save b to a using save method, RType is the compute type of DType */
+            template<typename DType, typename RType>
+            MSHADOW_XINLINE static void Save(DType& a, RType b) {
                 a -= b;
             }
             /*! \brief helper constant to use BLAS, alpha */
@@ -207,8 +303,9 @@ namespace mshadow {
         };
         /*! \brief multiply to saver: *= */
         struct multo {
-            /*! \brief save b to a using save method */
-            MSHADOW_XINLINE static void Save(real_t& a, real_t b) {
+            /*! \brief save b to a using save method, RType is the compute type of DType */
+            template<typename DType, typename RType>
+            MSHADOW_XINLINE static void Save(DType& a, RType b) {
                 a *= b;
             }
             /*! \brief corresponding binary operator type */
@@ -216,8 +313,9 @@ namespace mshadow {
         };
         /*! \brief divide to saver: /= */
         struct divto {
-            /*! \brief save b to a using save method */
-            MSHADOW_XINLINE static void Save(real_t& a, real_t b) {
+            /*! \brief save b to a using save method, RType is the compute type of DType */
+            template<typename DType, typename RType>
+            MSHADOW_XINLINE static void Save(DType& a, RType b) {
                 a /= b;
             }
             /*! \brief corresponding binary operator type */
@@ -233,7 +331,8 @@ namespace mshadow {
         /*! \brief identity function that maps a real number to it self */
         struct identity{
             /*! \brief map a to result using defined operation */
-            MSHADOW_XINLINE static real_t Map(real_t a) {
+            template<typename DType>
+            MSHADOW_XINLINE static DType Map(DType a) {
                 return a;
             }
         };
@@ -241,31 +340,82 @@ namespace mshadow {
 
     /*! \brief namespace for potential reducer operations */
     namespace red {
+        /*! \brief limits of element types, used to initialize reducers */
+        namespace limits{
+            /*! \brief only defined when the argument is true, an incomplete type error names it when DType has no std::numeric_limits */
+            template<bool has_numeric_limits>
+            struct MinValueRequiresNumericLimits;
+            template<>
+            struct MinValueRequiresNumericLimits<true>{};
+            /*! 
+             * \brief minimum value of DType, the general version uses std::numeric_limits,
+             *        DType without std::numeric_limits need to specialize this function
+             */
+            template<typename DType>
+            MSHADOW_XINLINE DType MinValue( void ){
+                (void)sizeof( MinValueRequiresNumericLimits<std::numeric_limits<DType>::is_specialized> );
+                return std::numeric_limits<DType>::is_integer ? std::numeric_limits<DType>::min() : -std::numeric_limits<DType>::max();
+            }
+            template<>
+            MSHADOW_XINLINE float MinValue<float>( void ){
+                return -FLT_MAX;
+            }
+            template<>
+            MSHADOW_XINLINE double MinValue<double>( void ){
+                return -DBL_MAX;
+            }
+            template<>
+            MSHADOW_XINLINE int8_t MinValue<int8_t>( void ){
+                return SCHAR_MIN;
+            }
+            template<>
+            MSHADOW_XINLINE uint8_t MinValue<uint8_t>( void ){
+                return 0;
+            }
+            template<>
+            MSHADOW_XINLINE int32_t MinValue<int32_t>( void ){
+                return INT_MIN;
+            }
+        };
         /*! \brief sum reducer */
         struct sum {
             /*! \brief do reduction into dst */
-            MSHADOW_XINLINE static void Reduce( volatile real_t& dst,  volatile real_t src ) {
+            template<typename DType>
+            MSHADOW_XINLINE static void Reduce( volatile DType& dst,  volatile DType src ) {
                 dst += src;
             }
             /*! \brief calculate gradient of redres with respect to redsrc,  redres: reduced result, redsrc: one of reduction element */
-            MSHADOW_XINLINE static real_t PartialGrad( real_t redres, real_t redsrc ) {
-                return 1.0f;
+            template<typename DType>
+            MSHADOW_XINLINE static DType PartialGrad( DType redres, DType redsrc ) {
+                return 1;
             }
-            /*! \brief an intial value of reducer */
+            /*! \brief set the intial value of reducer */
+            template<typename DType>
+            MSHADOW_XINLINE static void SetInitValue( DType &initv ) {
+                initv = 0;
+            }
+            /*! \brief an intial value of reducer for real_t, deprecated, use SetInitValue which works for all element types */
             MSHADOW_CONSTEXPR static real_t kInitV = 0.0f;
         };
         /*! \brief maximum reducer */
         struct maximum {
             /*! \brief do reduction into dst */
-            MSHADOW_XINLINE static void Reduce( volatile real_t& dst,  volatile real_t src ) {
+            template<typename DType>
+            MSHADOW_XINLINE static void Reduce( volatile DType& dst,  volatile DType src ) {
                 using namespace std;
                 dst = max( dst, src );
             }
             /*! \brief calculate gradient of redres with respect to redsrc,  redres: reduced result, redsrc: one of reduction element */
-            MSHADOW_XINLINE static real_t PartialGrad( real_t redres, real_t redsrc ) {
-                return redres == redsrc ? 1.0f: 0.0f;
+            template<typename DType>
+            MSHADOW_XINLINE static DType PartialGrad( DType redres, DType redsrc ) {
+                return redres == redsrc ? 1 : 0;
+            }
+            /*! \brief set the intial value of reducer */
+            template<typename DType>
+            MSHADOW_XINLINE static void SetInitValue( DType &initv ) {
+                initv = limits::MinValue<DType>();
             }
-            /*! \brief an intial value of reducer */
+            /*! \brief an intial value of reducer for real_t, deprecated, use SetInitValue which works for all element types */
 #if MSHADOW_SINGLE_PRECISION
             MSHADOW_CONSTEXPR static real_t kInitV = -FLT_MAX;
 #else
@@ -0,0 +1,124 @@
+#ifndef MSHADOW_TENSOR_BYTE_H
+#define MSHADOW_TENSOR_BYTE_H
+/*!
+ * \file tensor_byte.h
+ * \brief expression normalize that converts Tensor<cpu,dim,uint8_t>, compact storage of data such as image pixels,
+ *        to real_t when it is used, so the data takes a quarter of the memory of Tensor<cpu,dim>
+ */
+#include <stdint.h>
+#include "tensor.h"
+
+namespace mshadow{
+    #if MSHADOW_IN_CXX11
+    /*! \brief tensor of uint8_t on cpu, stride_ counts bytes, allocated and saved like any other Tensor */
+    template<int dimension>
+    using ByteTensor = Tensor<cpu,dimension,uint8_t>;
+    #endif
+
+    namespace expr{
+        /*!
+         * \brief convert uint8 content to real_t and normalize, result is ( src - mean ) * scale,
+         *        optionally the rows are gathered by an index
+         * \tparam dim dimension of expression
+         */
+        template<int dim>
+        struct NormalizeExp: public MakeTensorExp< NormalizeExp<dim>, cpu, dim >{
+            /*! \brief source, flattened to 2D */
+            Tensor<cpu,2,uint8_t> src_;
+            /*! \brief row index of source, NULL means row y comes from row y */
+            const index_t *index_;
+            /*! \brief mean and scale */
+            real_t mean_, scale_;
+            /*! \brief constructor */
+            NormalizeExp( const Tensor<cpu,2,uint8_t> &src, const index_t *index, const Shape<dim> &shape, real_t mean, real_t scale )
+                :src_(src), index_(index), mean_(mean), scale_(scale){
+                this->shape_ = shape;
+            }
+        };
+        /*!
+         * \brief convert uint8 tensor to real_t, result is ( src - mean ) * scale
+         * \param src source tensor
+         * \param mean value subtracted
+         * \param scale value multiplied after subtracting mean
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline NormalizeExp<dim> normalize( const Tensor<cpu,dim,uint8_t> &src, real_t mean, real_t scale ){
+            return NormalizeExp<dim>( src.FlatTo2D(), NULL, src.shape, mean, scale );
+        }
+        /*!
+         * \brief gather rows of uint8 matrix and convert to real_t, row i of result is ( src[ index[i] ] - mean ) * scale,
+         *        used to assemble a mini-batch from compact storage, only the rows in batch are converted
+         * \param src source matrix, each row is an instance
+         * \param index row indices in src, one for each row of result
+         * \param nrow number of rows of result
+         * \param mean value subtracted
+         * \param scale value multiplied after subtracting mean
+         */
+        inline NormalizeExp<2> normalize( const Tensor<cpu,2,uint8_t> &src, const index_t *index, index_t nrow, real_t mean, real_t scale ){
+            return NormalizeExp<2>( src, index, Shape2( nrow, src.shape[0] ), mean, scale );
+        }
+        // normalize expression reads cpu memory only
+        template<int dim>
+        struct ExpInfo< MakeTensorExp< NormalizeExp<dim>, cpu, dim > >{
+            typedef real_t DType;
+            const static int kDim = dim;
+            const static int kDevMask = cpu::kDevMask;
+        };
+
+        template<int dim>
+        struct Plan< NormalizeExp<dim> >{
+        public:
+            Plan( const NormalizeExp<dim> &e )
+                :dptr_(e.src_.dptr), stride_(e.src_.shape.stride_), index_(e.index_), mean_(e.mean_), scale_(e.scale_){}
+            inline real_t Eval( index_t y, index_t x ) const{
+                return ( static_cast<real_t>( this->Row( y )[x] ) - mean_ ) * scale_;
+            }
+            inline const uint8_t *Row( index_t y ) const{
+                return dptr_ + static_cast<size_t>( index_ == NULL ? y : index_[y] ) * stride_;
+            }
+        private:
+            const uint8_t *dptr_;
+            index_t stride_;
+            const index_t *index_;
+            real_t mean_, scale_;
+        };
+    }; // namespace expr
+
+#if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+    namespace expr{
+        template<int dim>
+        class SSEPlan< NormalizeExp<dim> >{
+        public:
+            SSEPlan( const NormalizeExp<dim> &e )
+                :plan_(e), vmean_( _mm_set1_ps( e.mean_ ) ), vscale_( _mm_set1_ps( e.scale_ ) ){}
+            // widen 4 bytes to 4 floats
+            MSHADOW_CINLINE sse2::FVec<real_t> EvalSSE( index_t y, index_t x ) const{
+                int32_t w;
+                memcpy( &w, plan_.Row( y ) + x, 4 );
+                const __m128i zero = _mm_setzero_si128();
+                __m128i v = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( w ), zero ), zero );
+                return sse2::FVec<real_t>( _mm_mul_ps( _mm_sub_ps( _mm_cvtepi32_ps( v ), vmean_ ), vscale_ ) );
+            }
+            MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const{
+                return plan_.Eval( y, x );
+            }
+        private:
+            Plan< NormalizeExp<dim> > plan_;
+            __m128 vmean_, vscale_;
+        };
+        template<int dim>
+        struct SSECheck< MakeTensorExp< NormalizeExp<dim>, cpu, dim > >{
+            const static bool kPass = true;
+        };
+        // bytes are loaded without alignment requirement
+        template<int dim>
+        struct SSEAlignCheck< dim, MakeTensorExp< NormalizeExp<dim>, cpu, dim > >{
+            inline static bool Check( const MakeTensorExp< NormalizeExp<dim>, cpu, dim > &t ){
+                return true;
+            }
+        };
+    }; // namespace expr
+#endif
+};
+#endif // MSHADOW_TENSOR_BYTE_H
@@ -0,0 +1,549 @@
+#ifndef MSHADOW_TENSOR_CHECKPOINT_H
+#define MSHADOW_TENSOR_CHECKPOINT_H
+/*!
+ * \file tensor_checkpoint.h
+ * \brief checkpoint file that stores many named tensors, with an index for random access
+ *
+ *  file layout, all integers are in native byte order:
+ *    header  : magic "MSHDCKPT", uint32 version, uint32 number of tensors,
+ *              uint64 offset of index, uint64 size of index, uint32 crc32 of index, padded to kAlign bytes
+ *    data    : content of each tensor, row major without padding, each tensor starts at multiple of kAlign
+ *    index   : for each tensor: uint32 length of name, name, uint32 type code, uint32 dim,
+ *              uint32 shape[dim] (lowest dimension first, same as Shape), uint64 offset, uint64 size in bytes, uint32 crc32 of content
+ *  the index is written last, so tensors can be written one by one without knowing the total size
+ */
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <deque>
+#include "tensor.h"
+#include "tensor_io.h"
+#include "tensor_container.h"
+#include "tensor_thread.h"
+#include "tensor_serial.h"
+
+namespace mshadow{
+    /*! \brief constants and records shared by CheckpointWriter and CheckpointReader */
+    namespace checkpoint{
+        /*! \brief magic number at start of file */
+        const char kMagic[8] = { 'M','S','H','D','C','K','P','T' };
+        /*! \brief version of format */
+        const uint32_t kVersion = 1;
+        /*! \brief alignment of each tensor in file, in bytes */
+        const size_t kAlign = 64;
+        /*! \brief type code of float */
+        const uint32_t kFloat32 = 0;
+        /*! \brief type code of double */
+        const uint32_t kFloat64 = 1;
+        /*! \brief type code of real_t */
+        const uint32_t kRealType = sizeof(real_t) == 4 ? kFloat32 : kFloat64;
+        /*! \brief header of checkpoint file */
+        struct Header{
+            char magic[8];
+            uint32_t version;
+            uint32_t count;
+            uint64_t index_offset;
+            uint64_t index_size;
+            uint32_t index_crc;
+            uint32_t reserved;
+        };
+        /*! \brief index record of one tensor */
+        struct Entry{
+            /*! \brief name of tensor */
+            std::string name;
+            /*! \brief type code of content */
+            uint32_t type;
+            /*! \brief shape, lowest dimension first */
+            std::vector<index_t> shape;
+            /*! \brief offset of content in file */
+            uint64_t offset;
+            /*! \brief number of bytes of content */
+            uint64_t size;
+            /*! \brief crc32 of content */
+            uint32_t crc;
+        };
+        /*! \brief take a POD value from buffer at pos, move pos */
+        template<typename T>
+        inline void Take( const std::string &buf, size_t &pos, T *v ){
+            utils::Assert( pos + sizeof(T) <= buf.length(), "checkpoint: index is corrupted" );
+            memcpy( v, buf.data() + pos, sizeof(T) );
+            pos += sizeof(T);
+        }
+    };
+
+    /*!
+     * \brief writer of checkpoint file, tensors are written one by one, and the index is written by Close
+     *
+     *  usage:
+     *    CheckpointWriter w( "model.ckpt" );
+     *    w.Write( "fc1_weight", wmat ); w.Write( "fc1_bias", bias );
+     *    w.Close();
+     */
+    class CheckpointWriter{
+    public:
+        /*!
+         * \brief constructor, create the file
+         * \param fname name of file
+         */
+        explicit CheckpointWriter( const char *fname ){
+            fp_ = fopen( fname, "wb" );
+            utils::Assert( fp_ != NULL, "CheckpointWriter: can not open file" );
+            // header is filled in Close
+            std::string pad( checkpoint::kAlign, '\0' );
+            this->WriteRaw( pad.data(), pad.length() );
+            pos_ = checkpoint::kAlign;
+        }
+        ~CheckpointWriter( void ){
+            this->Close();
+        }
+        /*!
+         * \brief write a tensor
+         * \param name name of the tensor, must be unique in the file
+         * \param src tensor to be written
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline void Write( const std::string &name, const Tensor<cpu,dim> &src ){
+            Tensor<cpu,2> mat = src.FlatTo2D();
+            const size_t nrow = sizeof(real_t) * mat.shape[0];
+            checkpoint::Entry &e = this->NewEntry( name, src.shape.shape_, dim );
+            if( mat.shape.stride_ == mat.shape[0] || mat.shape[1] == 1 ){
+                e.crc = utils::CRC32( e.crc, mat.dptr, nrow * mat.shape[1] );
+                this->WriteRaw( mat.dptr, nrow * mat.shape[1] );
+            }else{
+                for( index_t i = 0; i < mat.shape[1]; ++ i ){
+                    e.crc = utils::CRC32( e.crc, mat[i].dptr, nrow );
+                    this->WriteRaw( mat[i].dptr, nrow );
+                }
+            }
+            e.size = static_cast<uint64_t>( nrow ) * mat.shape[1];
+            pos_ += e.size;
+        }
+        /*!
+         * \brief write a tensor stored continuously in memory, used when the dimension is only known at runtime
+         * \param name name of the tensor, must be unique in the file
+         * \param shape shape of tensor, lowest dimension first
+         * \param dptr content of the tensor
+         */
+        inline void WriteFlat( const std::string &name, const std::vector<index_t> &shape, const real_t *dptr ){
+            checkpoint::Entry &e = this->NewEntry( name, shape.empty() ? NULL : &shape[0], static_cast<int>( shape.size() ) );
+            size_t nbytes = sizeof(real_t);
+            for( size_t k = 0; k < shape.size(); ++ k ) nbytes *= shape[k];
+            e.crc = utils::CRC32( 0, dptr, nbytes );
+            this->WriteRaw( dptr, nbytes );
+            e.size = nbytes;
+            pos_ += e.size;
+        }
+        /*! \brief GPU version, a temp Tensor<cpu,dim> storage will be allocated */
+        template<int dim>
+        inline void Write( const std::string &name, const Tensor<gpu,dim> &src ){
+            Tensor<cpu,dim> tmp( src.shape );
+            AllocSpace( tmp );
+            Copy( tmp, src );
+            this->Write( name, tmp );
+            FreeSpace( tmp );
+        }
+        /*! \brief write the index and header, and close the file */
+        inline void Close( void ){
+            if( fp_ == NULL ) return;
+            std::string index;
+            for( size_t i = 0; i < entries_.size(); ++ i ){
+                const checkpoint::Entry &e = entries_[i];
+                utils::Append( index, static_cast<uint32_t>( e.name.length() ) );
+                index.append( e.name );
+                utils::Append( index, e.type );
+                utils::Append( index, static_cast<uint32_t>( e.shape.size() ) );
+                for( size_t k = 0; k < e.shape.size(); ++ k ){
+                    utils::Append( index, static_cast<uint32_t>( e.shape[k] ) );
+                }
+                utils::Append( index, e.offset );
+                utils::Append( index, e.size );
+                utils::Append( index, e.crc );
+            }
+            this->Align();
+            checkpoint::Header h;
+            memset( &h, 0, sizeof(h) );
+            memcpy( h.magic, checkpoint::kMagic, sizeof(h.magic) );
+            h.version = checkpoint::kVersion;
+            h.count = static_cast<uint32_t>( entries_.size() );
+            h.index_offset = pos_;
+            h.index_size = index.length();
+            h.index_crc = utils::CRC32( 0, index.data(), index.length() );
+            this->WriteRaw( index.data(), index.length() );
+            utils::Assert( fseek( fp_, 0, SEEK_SET ) == 0, "CheckpointWriter: seek failed" );
+            this->WriteRaw( &h, sizeof(h) );
+            utils::Assert( fclose( fp_ ) == 0, "CheckpointWriter: close failed" );
+            fp_ = NULL;
+        }
+    private:
+        /*! \brief file pointer */
+        FILE *fp_;
+        /*! \brief current position in file */
+        uint64_t pos_;
+        /*! \brief index records */
+        std::vector<checkpoint::Entry> entries_;
+        /*! \brief names that are written */
+        std::map<std::string,size_t> names_;
+    private:
+        // add an index record for a tensor that starts at current position
+        inline checkpoint::Entry &NewEntry( const std::string &name, const index_t *shape, int dim ){
+            utils::Assert( fp_ != NULL, "CheckpointWriter: already closed" );
+            utils::Assert( names_.count( name ) == 0, "CheckpointWriter: duplicated tensor name" );
+            names_[ name ] = entries_.size();
+            this->Align();
+            entries_.push_back( checkpoint::Entry() );
+            checkpoint::Entry &e = entries_.back();
+            e.name = name; e.type = checkpoint::kRealType;
+            e.shape.assign( shape, shape + dim );
+            e.offset = pos_; e.size = 0; e.crc = 0;
+            return e;
+        }
+        inline void WriteRaw( const void *ptr, size_t size ){
+            if( size == 0 ) return;
+            utils::Assert( fwrite( ptr, size, 1, fp_ ) == 1, "CheckpointWriter: write failed" );
+        }
+        // pad current position to multiple of kAlign
+        inline void Align( void ){
+            const size_t npad = static_cast<size_t>( ( checkpoint::kAlign - pos_ % checkpoint::kAlign ) % checkpoint::kAlign );
+            if( npad != 0 ){
+                char pad[ checkpoint::kAlign ] = {0};
+                this->WriteRaw( pad, npad );
+                pos_ += npad;
+            }
+        }
+        // not copyable
+        CheckpointWriter( const CheckpointWriter &w );
+        CheckpointWriter& operator=( const CheckpointWriter &w );
+    };
+
+    /*!
+     * \brief reader of checkpoint file, the file is memory mapped, only the tensors that are read are touched,
+     *        tensors can be loaded by copy, or mapped without copy
+     */
+    class CheckpointReader{
+    public:
+        /*!
+         * \brief constructor, open the file and load the index
+         * \param fname name of file
+         */
+        explicit CheckpointReader( const char *fname ):fi_(fname){
+            checkpoint::Header h;
+            utils::Assert( fi_.Read( &h, sizeof(h) ) != 0, "CheckpointReader: file is too small" );
+            utils::Assert( memcmp( h.magic, checkpoint::kMagic, sizeof(h.magic) ) == 0, "CheckpointReader: not a checkpoint file" );
+            utils::Assert( h.version == checkpoint::kVersion, "CheckpointReader: unsupported version" );
+            utils::Assert( h.index_offset + h.index_size <= fi_.Size(), "CheckpointReader: file is truncated" );
+            fi_.Seek( static_cast<size_t>( h.index_offset ) );
+            std::string index( fi_.Data(), static_cast<size_t>( h.index_size ) );
+            utils::Assert( utils::CRC32( 0, index.data(), index.length() ) == h.index_crc, "CheckpointReader: index checksum mismatch" );
+            size_t pos = 0;
+            entries_.resize( h.count );
+            for( uint32_t i = 0; i < h.count; ++ i ){
+                checkpoint::Entry &e = entries_[i];
+                uint32_t len, ndim;
+                checkpoint::Take( index, pos, &len );
+                utils::Assert( pos + len <= index.length(), "CheckpointReader: index is corrupted" );
+                e.name.assign( index.data() + pos, len ); pos += len;
+                checkpoint::Take( index, pos, &e.type );
+                checkpoint::Take( index, pos, &ndim );
+                e.shape.resize( ndim );
+                for( uint32_t k = 0; k < ndim; ++ k ){
+                    uint32_t s; checkpoint::Take( index, pos, &s ); e.shape[k] = s;
+                }
+                checkpoint::Take( index, pos, &e.offset );
+                checkpoint::Take( index, pos, &e.size );
+                checkpoint::Take( index, pos, &e.crc );
+                utils::Assert( e.offset + e.size <= h.index_offset, "CheckpointReader: index is corrupted" );
+                names_[ e.name ] = i;
+            }
+        }
+        /*! \return number of tensors in file */
+        inline size_t Size( void ) const{
+            return entries_.size();
+        }
+        /*! \return name of i-th tensor */
+        inline const std::string &Name( size_t i ) const{
+            return entries_[i].name;
+        }
+        /*! \return whether a tensor of name exists */
+        inline bool Contains( const std::string &name ) const{
+            return names_.count( name ) != 0;
+        }
+        /*! \return dimension of tensor */
+        inline int Dim( const std::string &name ) const{
+            return static_cast<int>( this->Find( name ).shape.size() );
+        }
+        /*!
+         * \brief get shape of tensor
+         * \param name name of tensor
+         * \tparam dim dimension of tensor, must match the one in file
+         */
+        template<int dim>
+        inline Shape<dim> GetShape( const std::string &name ) const{
+            const checkpoint::Entry &e = this->Find( name );
+            utils::Assert( e.shape.size() == static_cast<size_t>( dim ), "CheckpointReader: dimension mismatch" );
+            Shape<dim> s;
+            for( int k = 0; k < dim; ++ k ) s[k] = e.shape[k];
+            s.stride_ = s[0];
+            return s;
+        }
+        /*!
+         * \brief check the content of tensor against checksum in index
+         * \param name name of tensor
+         * \return whether checksum matches
+         */
+        inline bool Verify( const std::string &name ) const{
+            const checkpoint::Entry &e = this->Find( name );
+            return utils::CRC32( 0, this->Content( e ), static_cast<size_t>( e.size ) ) == e.crc;
+        }
+        /*!
+         * \brief load a tensor by copy
+         * \param name name of tensor
+         * \param dst destination
+         * \param pre_alloc whether space of dst is pre-allocated, if true, shape must match, otherwise space is allocated by AllocSpace
+         * \param check whether to verify checksum of content
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline void Read( const std::string &name, Tensor<cpu,dim> &dst, bool pre_alloc, bool check = true ){
+            Shape<dim> shape = this->GetShape<dim>( name );
+            const checkpoint::Entry &e = this->Find( name );
+            utils::Assert( e.type == checkpoint::kRealType, "CheckpointReader: type of tensor does not match real_t" );
+            if( pre_alloc ){
+                utils::Assert( shape == dst.shape, "CheckpointReader: shape mismatch" );
+            }else{
+                dst.shape = shape; AllocSpace( dst );
+            }
+            if( check ){
+                utils::Assert( this->Verify( name ), "CheckpointReader: content checksum mismatch" );
+            }
+            Tensor<cpu,dim> src( reinterpret_cast<real_t*>( const_cast<char*>( this->Content( e ) ) ), shape );
+            Copy( dst, src );
+        }
+        /*! \brief GPU version, a temp Tensor<cpu,dim> storage will be allocated */
+        template<int dim>
+        inline void Read( const std::string &name, Tensor<gpu,dim> &dst, bool pre_alloc, bool check = true ){
+            Tensor<cpu,dim> tmp;
+            this->Read( name, tmp, false, check );
+            if( pre_alloc ){
+                utils::Assert( tmp.shape == dst.shape, "CheckpointReader: shape mismatch" );
+            }else{
+                dst.shape = tmp.shape; AllocSpace( dst );
+            }
+            Copy( dst, tmp );
+            FreeSpace( tmp );
+        }
+        /*!
+         * \brief zero-copy load of a tensor, dst points into the mapped file, and is only valid while the reader is alive,
+         *        dst is read-only and must not be freed, the checksum is not verified, call Verify if needed
+         * \param name name of tensor
+         * \param dst destination
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline void ReadMapped( const std::string &name, Tensor<cpu,dim> &dst ){
+            const checkpoint::Entry &e = this->Find( name );
+            utils::Assert( e.type == checkpoint::kRealType, "CheckpointReader: type of tensor does not match real_t" );
+            dst.shape = this->GetShape<dim>( name );
+            dst.dptr = reinterpret_cast<real_t*>( const_cast<char*>( this->Content( e ) ) );
+        }
+    private:
+        /*! \brief mapped file */
+        utils::MMapStream fi_;
+        /*! \brief index records */
+        std::vector<checkpoint::Entry> entries_;
+        /*! \brief map name to index record */
+        std::map<std::string,size_t> names_;
+    private:
+        inline const checkpoint::Entry &Find( const std::string &name ) const{
+            std::map<std::string,size_t>::const_iterator it = names_.find( name );
+            utils::Assert( it != names_.end(), "CheckpointReader: tensor not found" );
+            return entries_[ it->second ];
+        }
+        inline const char *Content( const checkpoint::Entry &e ) const{
+            return fi_.Begin() + e.offset;
+        }
+    };
+
+    /*!
+     * \brief asynchronous checkpoint writer, tensors are copied into pooled buffers when added to a snapshot,
+     *        and the snapshot is written by a background thread, so training can continue and modify the tensors.
+     *        at most max_queue snapshots wait in queue, Submit blocks when the queue is full.
+     *        buffers are reused by later snapshots, so saving the same model repeatedly does not allocate memory
+     *
+     *  usage:
+     *    AsyncCheckpointWriter saver;
+     *    AsyncCheckpointWriter::Snapshot *s = saver.NewSnapshot( "epoch1.ckpt" );
+     *    s->Add( "fc1_weight", wmat ); s->Add( "fc1_bias", bias );
+     *    int ticket = saver.Submit( s );
+     *    ... continue training, later: saver.IsDone( ticket ) or saver.Wait( ticket )
+     */
+    class AsyncCheckpointWriter{
+    public:
+        /*! \brief copies of tensors to be written to one checkpoint file */
+        class Snapshot{
+        public:
+            /*!
+             * \brief copy a tensor into the snapshot
+             * \param name name of the tensor
+             * \param src the tensor, can be modified after this call returns
+             * \tparam dim dimension of tensor
+             */
+            template<int dim>
+            inline void Add( const std::string &name, const Tensor<cpu,dim> &src ){
+                Copy( this->NewBuffer( name, src.shape ), src );
+            }
+            /*! \brief GPU version, the tensor is copied to host memory */
+            template<int dim>
+            inline void Add( const std::string &name, const Tensor<gpu,dim> &src ){
+                Copy( this->NewBuffer( name, src.shape ), src );
+            }
+        private:
+            friend class AsyncCheckpointWriter;
+            Snapshot( AsyncCheckpointWriter *writer, const std::string &fname )
+                :writer_(writer), fname_(fname){}
+            template<int dim>
+            inline Tensor<cpu,dim> NewBuffer( const std::string &name, const Shape<dim> &shape ){
+                TensorContainer<cpu,1> *buf = writer_->Acquire( shape.Size() );
+                names_.push_back( name );
+                shapes_.push_back( std::vector<index_t>( shape.shape_, shape.shape_ + dim ) );
+                buffers_.push_back( buf );
+                Shape<dim> s = shape; s.stride_ = s[0];
+                return Tensor<cpu,dim>( buf->dptr, s );
+            }
+            AsyncCheckpointWriter *writer_;
+            std::string fname_;
+            std::vector<std::string> names_;
+            std::vector< std::vector<index_t> > shapes_;
+            std::vector< TensorContainer<cpu,1>* > buffers_;
+        };
+    public:
+        /*!
+         * \brief constructor, start the background thread
+         * \param max_queue maximum number of snapshots waiting to be written
+         */
+        explicit AsyncCheckpointWriter( size_t max_queue = 2 )
+            :max_queue_(max_queue), nsubmit_(0), ndone_(0), stop_(false){
+            utils::Assert( max_queue_ != 0, "AsyncCheckpointWriter: max_queue must be positive" );
+            #if MSHADOW_USE_PTHREAD
+            worker_.Start( RunThread, this );
+            #endif
+        }
+        /*! \brief destructor, finish all submitted snapshots and stop the thread */
+        ~AsyncCheckpointWriter( void ){
+            {
+                utils::ScopedLock lock( mutex_ );
+                stop_ = true;
+                cond_.Broadcast();
+            }
+            worker_.Join();
+            for( size_t i = 0; i < pool_.size(); ++ i ) delete pool_[i];
+        }
+        /*!
+         * \brief create a snapshot to be written to file fname, tensors are added to it by Snapshot::Add
+         * \param fname name of checkpoint file
+         */
+        inline Snapshot *NewSnapshot( const std::string &fname ){
+            return new Snapshot( this, fname );
+        }
+        /*!
+         * \brief submit a snapshot for writing, the writer takes ownership of s
+         * \return ticket of the snapshot, used by IsDone and Wait
+         */
+        inline int Submit( Snapshot *s ){
+            utils::Assert( s->writer_ == this, "AsyncCheckpointWriter: snapshot created by another writer" );
+            #if MSHADOW_USE_PTHREAD
+            utils::ScopedLock lock( mutex_ );
+            while( queue_.size() >= max_queue_ ) cond_.Wait( mutex_ );
+            queue_.push_back( s );
+            cond_.Broadcast();
+            return nsubmit_ ++;
+            #else
+            this->WriteSnapshot( s );
+            ndone_ = ++ nsubmit_;
+            return nsubmit_ - 1;
+            #endif
+        }
+        /*! \return whether the snapshot of ticket is written */
+        inline bool IsDone( int ticket ){
+            utils::ScopedLock lock( mutex_ );
+            return ticket < ndone_;
+        }
+        /*! \brief wait until the snapshot of ticket is written */
+        inline void Wait( int ticket ){
+            utils::ScopedLock lock( mutex_ );
+            while( ticket >= ndone_ ) cond_.Wait( mutex_ );
+        }
+        /*! \brief wait until all submitted snapshots are written */
+        inline void WaitAll( void ){
+            utils::ScopedLock lock( mutex_ );
+            while( ndone_ < nsubmit_ ) cond_.Wait( mutex_ );
+        }
+    private:
+        /*! \brief maximum length of queue */
+        size_t max_queue_;
+        /*! \brief number of submitted and written snapshots */
+        int nsubmit_, ndone_;
+        /*! \brief whether the thread should stop after the queue is empty */
+        bool stop_;
+        /*! \brief snapshots waiting to be written */
+        std::deque<Snapshot*> queue_;
+        /*! \brief free buffers */
+        std::vector< TensorContainer<cpu,1>* > pool_;
+        /*! \brief lock of all the states above */
+        utils::Mutex mutex_;
+        /*! \brief signaled when the states change */
+        utils::ConditionVariable cond_;
+        /*! \brief background thread */
+        utils::Thread worker_;
+    private:
+        // get a buffer that holds size elements, prefer the oldest released buffer
+        inline TensorContainer<cpu,1> *Acquire( size_t size ){
+            TensorContainer<cpu,1> *buf = NULL;
+            {
+                utils::ScopedLock lock( mutex_ );
+                if( pool_.size() != 0 ){
+                    buf = pool_.front(); pool_.erase( pool_.begin() );
+                }
+            }
+            if( buf == NULL ) buf = new TensorContainer<cpu,1>( false );
+            buf->Resize( Shape1( static_cast<index_t>( size ) ) );
+            return buf;
+        }
+        inline void WriteSnapshot( Snapshot *s ){
+            {
+                CheckpointWriter w( s->fname_.c_str() );
+                for( size_t i = 0; i < s->names_.size(); ++ i ){
+                    w.WriteFlat( s->names_[i], s->shapes_[i], s->buffers_[i]->dptr );
+                }
+            }
+            utils::ScopedLock lock( mutex_ );
+            pool_.insert( pool_.end(), s->buffers_.begin(), s->buffers_.end() );
+            delete s;
+        }
+        inline void Run( void ){
+            while( true ){
+                Snapshot *s;
+                {
+                    utils::ScopedLock lock( mutex_ );
+                    while( queue_.size() == 0 && !stop_ ) cond_.Wait( mutex_ );
+                    if( queue_.size() == 0 ) return;
+                    s = queue_.front();
+                }
+                this->WriteSnapshot( s );
+                utils::ScopedLock lock( mutex_ );
+                // leave the snapshot in queue while writing, so the queue bounds the memory of snapshots
+                queue_.pop_front();
+                ++ ndone_;
+                cond_.Broadcast();
+            }
+        }
+        inline static void *RunThread( void *self ){
+            static_cast<AsyncCheckpointWriter*>( self )->Run();
+            return NULL;
+        }
+        AsyncCheckpointWriter( const AsyncCheckpointWriter &w );
+        AsyncCheckpointWriter& operator=( const AsyncCheckpointWriter &w );
+    };
+};
+#endif // MSHADOW_TENSOR_CHECKPOINT_H
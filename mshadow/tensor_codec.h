@@ -0,0 +1,546 @@
+#ifndef MSHADOW_TENSOR_CODEC_H
+#define MSHADOW_TENSOR_CODEC_H
+/*!
+ * \file tensor_codec.h
+ * \brief compressed and reduced precision serialization of tensors
+ *
+ *  SaveEncoded/LoadEncoded write a record of format:
+ *    uint32 magic, index_t shape[dim], uint32 codec, float scale, float bias, followed by the content in chunks of at most codec::kChunk elements,
+ *  elements are taken in row major order, each chunk is encoded independently, so encoding and decoding only needs buffers of one chunk
+ *    codec::kRaw  : real_t content
+ *    codec::kFP16 : IEEE half precision, round to nearest even
+ *    codec::kBF16 : bfloat16, upper 16 bits of float, round to nearest even
+ *    codec::kInt8 : uint8 q, value = q * scale + bias, scale and bias are chosen from min and max of the tensor,
+ *                   q is rounded to nearest even, NaN is stored as 0
+ *    codec::kLZ   : lossless, bytes of elements are shuffled into planes, then compressed by a built-in LZ77 compressor,
+ *                   each chunk is stored as uint32 size in bytes followed by the compressed bytes
+ *  the last byte of magic is the version of the format, LoadEncoded rejects records of other versions
+ */
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "tensor.h"
+#include "tensor_io.h"
+
+namespace mshadow{
+    /*! \brief codec of encoded tensor, and the encoding functions */
+    namespace codec{
+        /*! \brief content stored as real_t */
+        const uint32_t kRaw  = 0;
+        /*! \brief content stored as IEEE half precision */
+        const uint32_t kFP16 = 1;
+        /*! \brief content stored as bfloat16 */
+        const uint32_t kBF16 = 2;
+        /*! \brief content stored as 8-bit affine quantized value */
+        const uint32_t kInt8 = 3;
+        /*! \brief content compressed losslessly */
+        const uint32_t kLZ   = 4;
+        /*! \brief number of elements in each chunk */
+        const size_t kChunk = 1 << 16;
+        /*! \brief magic number at the start of each record, the last byte is version of format */
+        const uint32_t kMagic = 0x4d534301U;
+
+        /*! \brief convert a float to half, round to nearest even, overflow becomes infinity */
+        inline uint16_t FloatToHalf( float fv ){
+            uint32_t f; memcpy( &f, &fv, 4 );
+            const uint32_t sign = f & 0x80000000U;
+            f ^= sign;
+            uint32_t o;
+            if( f >= ( ( 127U + 16U ) << 23 ) ){
+                // Inf or NaN
+                o = f > 0x7F800000U ? 0x7E00U : 0x7C00U;
+            }else if( f < ( 113U << 23 ) ){
+                // subnormal or zero, align the mantissa by adding a magic number, float addition does the rounding
+                const uint32_t magic = ( ( 127U - 15U ) + ( 23U - 10U ) + 1U ) << 23;
+                float mf, x; memcpy( &mf, &magic, 4 ); memcpy( &x, &f, 4 );
+                x += mf; memcpy( &o, &x, 4 );
+                o -= magic;
+            }else{
+                const uint32_t odd = ( f >> 13 ) & 1;
+                o = ( f + ( static_cast<uint32_t>( 15 - 127 ) << 23 ) + 0xFFFU + odd ) >> 13;
+            }
+            return static_cast<uint16_t>( o | ( sign >> 16 ) );
+        }
+        /*! \brief convert a half to float */
+        inline float HalfToFloat( uint16_t h ){
+            const uint32_t shifted_exp = 0x7C00U << 13;
+            uint32_t o = ( h & 0x7FFFU ) << 13;
+            const uint32_t exp = o & shifted_exp;
+            o += ( 127U - 15U ) << 23;
+            if( exp == shifted_exp ){
+                o += ( 128U - 16U ) << 23;
+            }else if( exp == 0 ){
+                // zero or subnormal, renormalize
+                const uint32_t magic = 113U << 23;
+                float mf, x;
+                o += 1U << 23;
+                memcpy( &mf, &magic, 4 ); memcpy( &x, &o, 4 );
+                x -= mf; memcpy( &o, &x, 4 );
+            }
+            o |= static_cast<uint32_t>( h & 0x8000U ) << 16;
+            float r; memcpy( &r, &o, 4 );
+            return r;
+        }
+        /*! \brief convert a float to bfloat16, round to nearest even, NaN stays NaN */
+        inline uint16_t FloatToBF16( float fv ){
+            uint32_t f; memcpy( &f, &fv, 4 );
+            if( ( f & 0x7FFFFFFFU ) > 0x7F800000U ) return static_cast<uint16_t>( ( f >> 16 ) | 0x40U );
+            return static_cast<uint16_t>( ( f + 0x7FFFU + ( ( f >> 16 ) & 1 ) ) >> 16 );
+        }
+        /*! \brief convert a bfloat16 to float */
+        inline float BF16ToFloat( uint16_t h ){
+            const uint32_t o = static_cast<uint32_t>( h ) << 16;
+            float r; memcpy( &r, &o, 4 );
+            return r;
+        }
+
+#if MSHADOW_USE_SSE
+        /*! \brief SSE2 version of FloatToHalf for 4 elements, result in lower 16 bits of each lane */
+        inline __m128i FloatToHalf4( __m128 x ){
+            const __m128i sign_mask = _mm_set1_epi32( static_cast<int>( 0x80000000U ) );
+            __m128i f = _mm_castps_si128( x );
+            const __m128i sign = _mm_and_si128( f, sign_mask );
+            f = _mm_xor_si128( f, sign );
+            // f is positive as int32 after removing sign, signed compare is safe
+            const __m128i is_naninf = _mm_cmpgt_epi32( f, _mm_set1_epi32( ( ( 127 + 16 ) << 23 ) - 1 ) );
+            const __m128i is_nan = _mm_cmpgt_epi32( f, _mm_set1_epi32( 0x7F800000 ) );
+            const __m128i is_sub = _mm_cmplt_epi32( f, _mm_set1_epi32( 113 << 23 ) );
+            const __m128i naninf = _mm_or_si128( _mm_and_si128( is_nan, _mm_set1_epi32( 0x7E00 ) ),
+                                                 _mm_andnot_si128( is_nan, _mm_set1_epi32( 0x7C00 ) ) );
+            const __m128i magic = _mm_set1_epi32( ( ( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23 );
+            const __m128i sub = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( _mm_castsi128_ps( f ), _mm_castsi128_ps( magic ) ) ), magic );
+            const __m128i odd = _mm_and_si128( _mm_srli_epi32( f, 13 ), _mm_set1_epi32( 1 ) );
+            __m128i norm = _mm_add_epi32( f, _mm_set1_epi32( static_cast<int>( ( static_cast<uint32_t>( 15 - 127 ) << 23 ) + 0xFFFU ) ) );
+            norm = _mm_srli_epi32( _mm_add_epi32( norm, odd ), 13 );
+            __m128i o = _mm_or_si128( _mm_and_si128( is_sub, sub ), _mm_andnot_si128( is_sub, norm ) );
+            o = _mm_or_si128( _mm_and_si128( is_naninf, naninf ), _mm_andnot_si128( is_naninf, o ) );
+            return _mm_or_si128( o, _mm_srli_epi32( sign, 16 ) );
+        }
+        /*! \brief SSE2 version of HalfToFloat for 4 elements, input in lower 16 bits of each lane */
+        inline __m128 HalfToFloat4( __m128i h ){
+            const __m128i shifted_exp = _mm_set1_epi32( 0x7C00 << 13 );
+            __m128i o = _mm_slli_epi32( _mm_and_si128( h, _mm_set1_epi32( 0x7FFF ) ), 13 );
+            const __m128i exp = _mm_and_si128( o, shifted_exp );
+            o = _mm_add_epi32( o, _mm_set1_epi32( ( 127 - 15 ) << 23 ) );
+            const __m128i is_naninf = _mm_cmpeq_epi32( exp, shifted_exp );
+            const __m128i is_sub = _mm_cmpeq_epi32( exp, _mm_setzero_si128() );
+            o = _mm_add_epi32( o, _mm_and_si128( is_naninf, _mm_set1_epi32( ( 128 - 16 ) << 23 ) ) );
+            const __m128i magic = _mm_set1_epi32( 113 << 23 );
+            const __m128i sub = _mm_castps_si128( _mm_sub_ps( _mm_castsi128_ps( _mm_add_epi32( o, _mm_set1_epi32( 1 << 23 ) ) ),
+                                                             _mm_castsi128_ps( magic ) ) );
+            o = _mm_or_si128( _mm_and_si128( is_sub, sub ), _mm_andnot_si128( is_sub, o ) );
+            o = _mm_or_si128( o, _mm_slli_epi32( _mm_and_si128( h, _mm_set1_epi32( 0x8000 ) ), 16 ) );
+            return _mm_castsi128_ps( o );
+        }
+        /*! \brief SSE2 version of FloatToBF16 for 4 elements, result in lower 16 bits of each lane */
+        inline __m128i FloatToBF16x4( __m128 x ){
+            const __m128i f = _mm_castps_si128( x );
+            const __m128i rounded = _mm_add_epi32( f, _mm_add_epi32( _mm_set1_epi32( 0x7FFF ),
+                                                                     _mm_and_si128( _mm_srli_epi32( f, 16 ), _mm_set1_epi32( 1 ) ) ) );
+            const __m128i nan = _mm_cmpgt_epi32( _mm_and_si128( f, _mm_set1_epi32( 0x7FFFFFFF ) ), _mm_set1_epi32( 0x7F800000 ) );
+            const __m128i qnan = _mm_or_si128( f, _mm_set1_epi32( 0x400000 ) );
+            return _mm_srli_epi32( _mm_or_si128( _mm_and_si128( nan, qnan ), _mm_andnot_si128( nan, rounded ) ), 16 );
+        }
+        /*! \brief pack lower 16 bits of each lane of a and b into 8 uint16 */
+        inline __m128i Pack16( __m128i a, __m128i b ){
+            // sign extend the lower 16 bits, so that signed saturation keeps the bits
+            a = _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 );
+            b = _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 );
+            return _mm_packs_epi32( a, b );
+        }
+#endif
+        /*! \brief encode n floats to half */
+        inline void EncodeFP16( uint16_t *dst, const float *src, size_t n ){
+            size_t i = 0;
+            #if MSHADOW_USE_SSE
+            for( ; i + 8 <= n; i += 8 ){
+                __m128i lo = FloatToHalf4( _mm_loadu_ps( src + i ) );
+                __m128i hi = FloatToHalf4( _mm_loadu_ps( src + i + 4 ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ), Pack16( lo, hi ) );
+            }
+            #endif
+            for( ; i < n; ++ i ) dst[i] = FloatToHalf( src[i] );
+        }
+        /*! \brief decode n halfs to float */
+        inline void DecodeFP16( float *dst, const uint16_t *src, size_t n ){
+            size_t i = 0;
+            #if MSHADOW_USE_SSE
+            for( ; i + 8 <= n; i += 8 ){
+                __m128i h = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+                _mm_storeu_ps( dst + i,     HalfToFloat4( _mm_unpacklo_epi16( h, _mm_setzero_si128() ) ) );
+                _mm_storeu_ps( dst + i + 4, HalfToFloat4( _mm_unpackhi_epi16( h, _mm_setzero_si128() ) ) );
+            }
+            #endif
+            for( ; i < n; ++ i ) dst[i] = HalfToFloat( src[i] );
+        }
+        /*! \brief encode n floats to bfloat16 */
+        inline void EncodeBF16( uint16_t *dst, const float *src, size_t n ){
+            size_t i = 0;
+            #if MSHADOW_USE_SSE
+            for( ; i + 8 <= n; i += 8 ){
+                __m128i lo = FloatToBF16x4( _mm_loadu_ps( src + i ) );
+                __m128i hi = FloatToBF16x4( _mm_loadu_ps( src + i + 4 ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ), Pack16( lo, hi ) );
+            }
+            #endif
+            for( ; i < n; ++ i ) dst[i] = FloatToBF16( src[i] );
+        }
+        /*! \brief decode n bfloat16 to float */
+        inline void DecodeBF16( float *dst, const uint16_t *src, size_t n ){
+            size_t i = 0;
+            #if MSHADOW_USE_SSE
+            for( ; i + 8 <= n; i += 8 ){
+                __m128i h = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ),     _mm_unpacklo_epi16( _mm_setzero_si128(), h ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i + 4 ), _mm_unpackhi_epi16( _mm_setzero_si128(), h ) );
+            }
+            #endif
+            for( ; i < n; ++ i ) dst[i] = BF16ToFloat( src[i] );
+        }
+        /*!
+         * \brief round a value to uint8, q is clipped to [0,255] first and NaN becomes 0,
+         *        adding 2^23 rounds to nearest even in the default rounding mode, the same as _mm_cvtps_epi32
+         */
+        inline uint8_t RoundToUint8( float q ){
+            q = q > 0.0f ? q : 0.0f;
+            q = q < 255.0f ? q : 255.0f;
+            return static_cast<uint8_t>( ( q + 8388608.0f ) - 8388608.0f );
+        }
+        /*! \brief quantize n floats, q = round( ( x - bias ) / scale ) clipped to [0,255], see RoundToUint8 */
+        inline void EncodeInt8( uint8_t *dst, const float *src, size_t n, float scale, float bias ){
+            const float rscale = scale > 0.0f ? 1.0f / scale : 0.0f;
+            size_t i = 0;
+            #if MSHADOW_USE_SSE
+            const __m128 vr = _mm_set1_ps( rscale ), vb = _mm_set1_ps( bias );
+            const __m128 vlo = _mm_setzero_ps(), vhi = _mm_set1_ps( 255.0f );
+            for( ; i + 16 <= n; i += 16 ){
+                __m128i q[4];
+                for( int k = 0; k < 4; ++ k ){
+                    // clip before conversion, max returns the second operand for NaN, same as RoundToUint8
+                    __m128 v = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( src + i + 4 * k ), vb ), vr );
+                    q[k] = _mm_cvtps_epi32( _mm_min_ps( _mm_max_ps( v, vlo ), vhi ) );
+                }
+                __m128i p = _mm_packus_epi16( _mm_packs_epi32( q[0], q[1] ), _mm_packs_epi32( q[2], q[3] ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ), p );
+            }
+            #endif
+            for( ; i < n; ++ i ) dst[i] = RoundToUint8( ( src[i] - bias ) * rscale );
+        }
+        /*! \brief dequantize n values, x = q * scale + bias */
+        inline void DecodeInt8( float *dst, const uint8_t *src, size_t n, float scale, float bias ){
+            size_t i = 0;
+            #if MSHADOW_USE_SSE
+            const __m128 vs = _mm_set1_ps( scale ), vb = _mm_set1_ps( bias );
+            const __m128i zero = _mm_setzero_si128();
+            for( ; i + 16 <= n; i += 16 ){
+                __m128i q = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+                __m128i lo = _mm_unpacklo_epi8( q, zero ), hi = _mm_unpackhi_epi8( q, zero );
+                __m128i w[4] = { _mm_unpacklo_epi16( lo, zero ), _mm_unpackhi_epi16( lo, zero ),
+                                 _mm_unpacklo_epi16( hi, zero ), _mm_unpackhi_epi16( hi, zero ) };
+                for( int k = 0; k < 4; ++ k ){
+                    _mm_storeu_ps( dst + i + 4 * k, _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( w[k] ), vs ), vb ) );
+                }
+            }
+            #endif
+            for( ; i < n; ++ i ) dst[i] = src[i] * scale + bias;
+        }
+        /*!
+         * \brief shuffle bytes of n elements of size elem_size into elem_size planes, byte k of element i goes to dst[k*n+i]
+         */
+        inline void ByteShuffle( uint8_t *dst, const uint8_t *src, size_t n, size_t elem_size ){
+            for( size_t k = 0; k < elem_size; ++ k ){
+                uint8_t *plane = dst + k * n;
+                for( size_t i = 0; i < n; ++ i ) plane[i] = src[ i * elem_size + k ];
+            }
+        }
+        /*! \brief inverse of ByteShuffle */
+        inline void ByteUnshuffle( uint8_t *dst, const uint8_t *src, size_t n, size_t elem_size ){
+            for( size_t k = 0; k < elem_size; ++ k ){
+                const uint8_t *plane = src + k * n;
+                for( size_t i = 0; i < n; ++ i ) dst[ i * elem_size + k ] = plane[i];
+            }
+        }
+
+        /*! \brief maximum size of LZCompress output for n bytes of input */
+        inline size_t LZBound( size_t n ){
+            return n + n / 255 + 16;
+        }
+        // write extended length of LZ sequence
+        inline uint8_t *LZPutLength( uint8_t *op, size_t len ){
+            for( ; len >= 255; len -= 255 ) *op ++ = 255;
+            *op ++ = static_cast<uint8_t>( len );
+            return op;
+        }
+        // emit one LZ sequence: literals, then a match of mlen bytes at offset, mlen = 0 means no match
+        inline uint8_t *LZPutSequence( uint8_t *op, const uint8_t *lit, size_t nlit, size_t offset, size_t mlen ){
+            const size_t ml = mlen == 0 ? 0 : mlen - 4;
+            uint8_t *token = op ++;
+            *token = static_cast<uint8_t>( ( std::min( nlit, static_cast<size_t>( 15 ) ) << 4 ) | std::min( ml, static_cast<size_t>( 15 ) ) );
+            if( nlit >= 15 ) op = LZPutLength( op, nlit - 15 );
+            memcpy( op, lit, nlit ); op += nlit;
+            if( mlen != 0 ){
+                *op ++ = static_cast<uint8_t>( offset & 0xFF );
+                *op ++ = static_cast<uint8_t>( offset >> 8 );
+                if( ml >= 15 ) op = LZPutLength( op, ml - 15 );
+            }
+            return op;
+        }
+        /*!
+         * \brief compress n bytes with LZ77, matches of at least 4 bytes within 64KB are found by a hash table
+         * \param dst output, must have space of LZBound(n)
+         * \return size of compressed data
+         */
+        inline size_t LZCompress( uint8_t *dst, const uint8_t *src, size_t n ){
+            const int kHashBits = 14;
+            std::vector<uint32_t> table( 1 << kHashBits, 0 );
+            uint8_t *op = dst;
+            size_t anchor = 0, ip = 0;
+            while( ip + 4 <= n ){
+                uint32_t seq; memcpy( &seq, src + ip, 4 );
+                const uint32_t h = ( seq * 2654435761U ) >> ( 32 - kHashBits );
+                const size_t ref = table[h];
+                table[h] = static_cast<uint32_t>( ip );
+                uint32_t rseq; memcpy( &rseq, src + ref, 4 );
+                if( ref < ip && ip - ref <= 0xFFFF && rseq == seq ){
+                    size_t len = 4;
+                    while( ip + len < n && src[ ref + len ] == src[ ip + len ] ) ++ len;
+                    op = LZPutSequence( op, src + anchor, ip - anchor, ip - ref, len );
+                    ip += len; anchor = ip;
+                }else{
+                    // skip faster in data that does not compress
+                    ip += 1 + ( ( ip - anchor ) >> 6 );
+                }
+            }
+            op = LZPutSequence( op, src + anchor, n - anchor, 0, 0 );
+            return static_cast<size_t>( op - dst );
+        }
+        /*!
+         * \brief decompress data produced by LZCompress
+         * \param dst output, must have space of n bytes
+         * \param n size of original data
+         * \param src compressed data
+         * \param size size of compressed data
+         */
+        inline void LZDecompress( uint8_t *dst, size_t n, const uint8_t *src, size_t size ){
+            const uint8_t *ip = src, *iend = src + size;
+            uint8_t *op = dst, *oend = dst + n;
+            while( ip < iend ){
+                const uint8_t token = *ip ++;
+                size_t nlit = token >> 4;
+                if( nlit == 15 ){
+                    uint8_t b;
+                    do{
+                        utils::Assert( ip < iend, "LZDecompress: corrupted data" );
+                        b = *ip ++; nlit += b;
+                    }while( b == 255 );
+                }
+                utils::Assert( nlit <= static_cast<size_t>( iend - ip ) && nlit <= static_cast<size_t>( oend - op ), "LZDecompress: corrupted data" );
+                memcpy( op, ip, nlit ); op += nlit; ip += nlit;
+                if( ip == iend ) break;
+                utils::Assert( iend - ip >= 2, "LZDecompress: corrupted data" );
+                const size_t offset = ip[0] | ( static_cast<size_t>( ip[1] ) << 8 );
+                ip += 2;
+                size_t mlen = ( token & 15 ) + 4;
+                if( ( token & 15 ) == 15 ){
+                    uint8_t b;
+                    do{
+                        utils::Assert( ip < iend, "LZDecompress: corrupted data" );
+                        b = *ip ++; mlen += b;
+                    }while( b == 255 );
+                }
+                utils::Assert( offset != 0 && offset <= static_cast<size_t>( op - dst ) && mlen <= static_cast<size_t>( oend - op ),
+                               "LZDecompress: corrupted data" );
+                const uint8_t *ref = op - offset;
+                if( offset >= mlen ){
+                    memcpy( op, ref, mlen ); op += mlen;
+                }else{
+                    // overlapping copy repeats the pattern
+                    for( size_t i = 0; i < mlen; ++ i ) op[i] = ref[i];
+                    op += mlen;
+                }
+            }
+            utils::Assert( op == oend, "LZDecompress: size mismatch" );
+        }
+    };
+
+    /*!
+     * \brief CPU/GPU: save a tensor with a codec, see tensor_codec.h for the format, for GPU version, a temp Tensor<cpu,dim> storage will be allocated
+     *        kFP16, kBF16 and kInt8 are lossy and store 2, 2 and 1 bytes for each element, kLZ is lossless
+     * \param fo output stream
+     * \param src source tensor
+     * \param codec_type codec, one of codec::kRaw, kFP16, kBF16, kInt8, kLZ
+     * \tparam dim dimension of tensor
+     * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
+     */
+    template<int dim, typename TStream>
+    inline void SaveEncoded( TStream &fo, const Tensor<cpu,dim> &src, uint32_t codec_type );
+    /*! \brief refer to comment of cpu ver \sa SaveEncoded */
+    template<int dim, typename TStream>
+    inline void SaveEncoded( TStream &fo, const Tensor<gpu,dim> &src, uint32_t codec_type );
+    /*!
+     * \brief CPU/GPU: load a tensor saved by SaveEncoded, the codec is read from the stream, for GPU version, a temp Tensor<cpu,dim> storage will be allocated
+     * \param fi input stream
+     * \param dst destination
+     * \param pre_alloc whether space is pre-allocated, if false, space allocation will happen
+     * \tparam dim dimension of tensor
+     * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
+     */
+    template<int dim, typename TStream>
+    inline void LoadEncoded( TStream &fi, Tensor<cpu,dim> &dst, bool pre_alloc );
+    /*! \brief refer to comment of cpu ver \sa LoadEncoded */
+    template<int dim, typename TStream>
+    inline void LoadEncoded( TStream &fi, Tensor<gpu,dim> &dst, bool pre_alloc );
+};
+
+namespace mshadow{
+    namespace codec{
+        /*! \brief visit elements of a tensor in row major order, chunk by chunk */
+        struct ChunkCursor{
+            Tensor<cpu,2> mat;
+            index_t row, col;
+            ChunkCursor( const Tensor<cpu,2> &m ):mat(m), row(0), col(0){}
+            /*! \brief copy next n elements into buf */
+            inline void Gather( real_t *buf, size_t n ){
+                while( n != 0 ){
+                    const size_t k = std::min( n, static_cast<size_t>( mat.shape[0] - col ) );
+                    memcpy( buf, mat[row].dptr + col, k * sizeof(real_t) );
+                    this->Advance( k ); buf += k; n -= k;
+                }
+            }
+            /*! \brief copy n elements in buf into next n elements */
+            inline void Scatter( const real_t *buf, size_t n ){
+                while( n != 0 ){
+                    const size_t k = std::min( n, static_cast<size_t>( mat.shape[0] - col ) );
+                    memcpy( mat[row].dptr + col, buf, k * sizeof(real_t) );
+                    this->Advance( k ); buf += k; n -= k;
+                }
+            }
+            inline void Advance( size_t k ){
+                col += static_cast<index_t>( k );
+                if( col == mat.shape[0] ){ col = 0; ++ row; }
+            }
+        };
+        /*! \brief encode n elements of chunk, return size of output in bytes */
+        inline size_t EncodeChunk( uint8_t *out, std::vector<uint8_t> &tmp, const real_t *buf, size_t n, uint32_t codec_type, float scale, float bias ){
+            #if MSHADOW_SINGLE_PRECISION
+            const float *fbuf = buf;
+            #else
+            std::vector<float> fvec( buf, buf + n );
+            const float *fbuf = n != 0 ? &fvec[0] : NULL;
+            #endif
+            switch( codec_type ){
+            case kRaw: memcpy( out, buf, n * sizeof(real_t) ); return n * sizeof(real_t);
+            case kFP16: EncodeFP16( reinterpret_cast<uint16_t*>( out ), fbuf, n ); return n * 2;
+            case kBF16: EncodeBF16( reinterpret_cast<uint16_t*>( out ), fbuf, n ); return n * 2;
+            case kInt8: EncodeInt8( out, fbuf, n, scale, bias ); return n;
+            case kLZ:{
+                tmp.resize( n * sizeof(real_t) );
+                ByteShuffle( &tmp[0], reinterpret_cast<const uint8_t*>( buf ), n, sizeof(real_t) );
+                const uint32_t nbytes = static_cast<uint32_t>( LZCompress( out + 4, &tmp[0], n * sizeof(real_t) ) );
+                memcpy( out, &nbytes, 4 );
+                return nbytes + 4;
+            }
+            default: utils::Error( "SaveEncoded: unknown codec" ); return 0;
+            }
+        }
+    };
+
+    template<int dim, typename TStream>
+    inline void SaveEncoded( TStream &fo, const Tensor<cpu,dim> &src, uint32_t codec_type ){
+        Tensor<cpu,2> mat = src.FlatTo2D();
+        float scale = 0.0f, bias = 0.0f;
+        if( codec_type == codec::kInt8 && mat.shape.Size() != 0 ){
+            real_t vmin = mat[0][0], vmax = mat[0][0];
+            for( index_t i = 0; i < mat.shape[1]; ++ i ){
+                for( index_t j = 0; j < mat.shape[0]; ++ j ){
+                    vmin = std::min( vmin, mat[i][j] ); vmax = std::max( vmax, mat[i][j] );
+                }
+            }
+            bias = static_cast<float>( vmin );
+            scale = static_cast<float>( vmax - vmin ) / 255.0f;
+        }
+        fo.Write( &codec::kMagic, sizeof(codec::kMagic) );
+        fo.Write( src.shape.shape_, sizeof(index_t) * dim );
+        fo.Write( &codec_type, sizeof(codec_type) );
+        fo.Write( &scale, sizeof(scale) );
+        fo.Write( &bias, sizeof(bias) );
+        const size_t total = mat.shape.Size();
+        if( total == 0 ) return;
+        std::vector<real_t> buf( std::min( total, codec::kChunk ) );
+        std::vector<uint8_t> out( codec::LZBound( buf.size() * sizeof(real_t) ) + 4 ), tmp;
+        codec::ChunkCursor cur( mat );
+        for( size_t start = 0; start < total; start += codec::kChunk ){
+            const size_t n = std::min( total - start, codec::kChunk );
+            cur.Gather( &buf[0], n );
+            fo.Write( &out[0], codec::EncodeChunk( &out[0], tmp, &buf[0], n, codec_type, scale, bias ) );
+        }
+    }
+    template<int dim, typename TStream>
+    inline void SaveEncoded( TStream &fo, const Tensor<gpu,dim> &src, uint32_t codec_type ){
+        Tensor<cpu,dim> tmp( src.shape );
+        AllocSpace( tmp );
+        Copy( tmp, src );
+        SaveEncoded( fo, tmp, codec_type );
+        FreeSpace( tmp );
+    }
+    template<int dim, typename TStream>
+    inline void LoadEncoded( TStream &fi, Tensor<cpu,dim> &dst_, bool pre_alloc ){
+        Shape<dim> shape;
+        uint32_t magic, codec_type; float scale, bias;
+        utils::Assert( fi.Read( &magic, sizeof(magic) ) != 0, "mshadow::LoadEncoded" );
+        utils::Assert( magic == codec::kMagic, "mshadow::LoadEncoded: not a record of SaveEncoded or unsupported version" );
+        utils::Assert( fi.Read( shape.shape_, sizeof(index_t) * dim ) != 0, "mshadow::LoadEncoded" );
+        utils::Assert( fi.Read( &codec_type, sizeof(codec_type) ) != 0, "mshadow::LoadEncoded" );
+        utils::Assert( fi.Read( &scale, sizeof(scale) ) != 0 && fi.Read( &bias, sizeof(bias) ) != 0, "mshadow::LoadEncoded" );
+        if( pre_alloc ){
+            utils::Assert( shape == dst_.shape, "mshadow::LoadEncoded: shape mismatch" );
+        }else{
+            dst_.shape = shape; AllocSpace( dst_ );
+        }
+        Tensor<cpu,2> mat = dst_.FlatTo2D();
+        const size_t total = mat.shape.Size();
+        if( total == 0 ) return;
+        std::vector<real_t> buf( std::min( total, codec::kChunk ) );
+        std::vector<float> fbuf( buf.size() );
+        std::vector<uint8_t> in( codec::LZBound( buf.size() * sizeof(real_t) ) ), tmp( buf.size() * sizeof(real_t) );
+        codec::ChunkCursor cur( mat );
+        for( size_t start = 0; start < total; start += codec::kChunk ){
+            const size_t n = std::min( total - start, codec::kChunk );
+            if( codec_type == codec::kRaw ){
+                utils::Assert( fi.Read( &buf[0], n * sizeof(real_t) ) != 0, "mshadow::LoadEncoded" );
+            }else if( codec_type == codec::kLZ ){
+                uint32_t nbytes;
+                utils::Assert( fi.Read( &nbytes, 4 ) != 0 && nbytes <= in.size(), "mshadow::LoadEncoded: corrupted chunk" );
+                utils::Assert( nbytes == 0 || fi.Read( &in[0], nbytes ) != 0, "mshadow::LoadEncoded" );
+                codec::LZDecompress( &tmp[0], n * sizeof(real_t), &in[0], nbytes );
+                codec::ByteUnshuffle( reinterpret_cast<uint8_t*>( &buf[0] ), &tmp[0], n, sizeof(real_t) );
+            }else{
+                const size_t esize = codec_type == codec::kInt8 ? 1 : 2;
+                utils::Assert( codec_type <= codec::kInt8, "mshadow::LoadEncoded: unknown codec" );
+                utils::Assert( fi.Read( &in[0], n * esize ) != 0, "mshadow::LoadEncoded" );
+                switch( codec_type ){
+                case codec::kFP16: codec::DecodeFP16( &fbuf[0], reinterpret_cast<const uint16_t*>( &in[0] ), n ); break;
+                case codec::kBF16: codec::DecodeBF16( &fbuf[0], reinterpret_cast<const uint16_t*>( &in[0] ), n ); break;
+                default: codec::DecodeInt8( &fbuf[0], &in[0], n, scale, bias ); break;
+                }
+                std::copy( fbuf.begin(), fbuf.begin() + n, buf.begin() );
+            }
+            cur.Scatter( &buf[0], n );
+        }
+    }
+    template<int dim, typename TStream>
+    inline void LoadEncoded( TStream &fi, Tensor<gpu,dim> &dst, bool pre_alloc ){
+        Tensor<cpu,dim> tmp;
+        LoadEncoded( fi, tmp, false );
+        if( pre_alloc ){
+            utils::Assert( tmp.shape == dst.shape, "mshadow::LoadEncoded: shape mismatch" );
+        }else{
+            dst.shape = tmp.shape; AllocSpace( dst );
+        }
+        Copy( dst, tmp );
+        FreeSpace( tmp );
+    }
+};
+#endif // MSHADOW_TENSOR_CODEC_H
@@ -16,9 +16,10 @@ namespace mshadow{
      *
      * \tparam Device which device the tensor is on
      * \tparam dimension dimension of the tensor
+     * \tparam DType element type of the tensor
      */
-    template<typename Device, int dimension>
-    class TensorContainer: public Tensor<Device,dimension>{
+    template<typename Device, int dimension, typename DType = real_t>
+    class TensorContainer: public Tensor<Device,dimension,DType>{
     public:
         /*! 
          * \brief constructor 
@@ -46,15 +47,82 @@ namespace mshadow{
          * \param shape intial shape
          * \param initv intial value
          */
-        TensorContainer( const Shape<dimension> &shape, real_t initv ){
+        TensorContainer( const Shape<dimension> &shape, typename DataType<DType>::ComputeType initv ){
             this->pad_ = MSHADOW_ALLOC_PAD;
             data_.dptr = NULL;
-            this->AllocByShape( shape );
-            (*this) = initv;
+            if( initv == DType(0) ){
+                this->AllocByShape( shape, true );
+            }else{
+                this->AllocByShape( shape );
+                (*this) = initv;
+            }
         }
+        /*! 
+         * \brief copy constructor, content of src is deep copied into new space
+         * \param src source container
+         */
+        TensorContainer( const TensorContainer<Device,dimension,DType> &src ){
+            this->pad_ = src.pad_;
+            this->SetEmpty();
+            if( src.dptr != NULL ){
+                this->AllocByShape( src.shape );
+                Copy( *this, src );
+            }
+        }
+        #if MSHADOW_IN_CXX11
+        /*! 
+         * \brief move constructor, take over space of src without copy, src becomes empty
+         * \param src source container
+         */
+        TensorContainer( TensorContainer<Device,dimension,DType> &&src ){
+            this->pad_ = src.pad_;
+            this->SetEmpty();
+            this->Swap( src );
+        }
+        #endif
         ~TensorContainer( void ){
             this->FreeSpace();
         }
+        /*! 
+         * \brief copy assignment, content of src is deep copied, space is reused if it is large enough
+         * \param src source container
+         */
+        inline TensorContainer<Device,dimension,DType>& operator=( const TensorContainer<Device,dimension,DType> &src ){
+            if( this == &src ) return *this;
+            if( src.dptr == NULL ){
+                // become empty, the space is kept for later Resize
+                this->dptr = NULL;
+                this->shape[0] = 0;
+                this->shape.stride_ = 0;
+            }else{
+                this->Resize( src.shape );
+                Copy( *this, src );
+            }
+            return *this;
+        }
+        #if MSHADOW_IN_CXX11
+        /*! 
+         * \brief move assignment, release current space and take over space of src, src becomes empty
+         * \param src source container
+         */
+        inline TensorContainer<Device,dimension,DType>& operator=( TensorContainer<Device,dimension,DType> &&src ){
+            if( this == &src ) return *this;
+            this->FreeSpace(); this->SetEmpty();
+            this->pad_ = src.pad_;
+            this->Swap( src );
+            return *this;
+        }
+        #endif
+        /*! 
+         * \brief swap content and space with another container, no memory allocation or copy happens
+         * \param other the container to be swapped with
+         */
+        inline void Swap( TensorContainer<Device,dimension,DType> &other ){
+            std::swap( this->pad_, other.pad_ );
+            std::swap( this->dptr, other.dptr );
+            std::swap( this->shape, other.shape );
+            std::swap( this->data_, other.data_ );
+        }
         /*! 
          * \brief resize the container to given shape, content is NOT preserved
          * \param shape target shape
@@ -64,6 +132,7 @@ namespace mshadow{
             if( s2.shape_[0] > data_.shape.stride_ || s2.shape_[1] > data_.shape[1] ){
                 this->AllocByShape( shape );
             }else{
+                this->dptr  = data_.dptr;
                 this->shape = shape;
                 if( this->pad_ ){
                     this->shape.stride_ = data_.shape.stride_;
@@ -77,10 +146,40 @@ namespace mshadow{
          * \param shape target shape
          * \param initv initialization value
          */
-        inline void Resize( const Shape<dimension> &shape, real_t initv ){
+        inline void Resize( const Shape<dimension> &shape, typename DataType<DType>::ComputeType initv ){
             this->Resize( shape );
             (*this) = initv;
         }
+        /*! 
+         * \brief make sure the space can hold shape without re-allocation in later Resize, 
+         *        current shape and content are preserved, an empty container stays empty
+         * \param shape shape the space should be able to hold
+         */
+        inline void Reserve( const Shape<dimension> &shape ){
+            Shape<2> s2 = shape.FlatTo2D();
+            if( s2.shape_[0] <= data_.shape.stride_ && s2.shape_[1] <= data_.shape[1] ) return;
+            if( data_.dptr == NULL ){
+                // nothing to preserve, only allocate the space, shape and dptr stay empty
+                data_.shape = s2;
+                mshadow::AllocSpace( data_, pad_ );
+                return;
+            }
+            this->ReAlloc( Shape2( std::max( s2.shape_[1], data_.shape[1] ), 
+                                   std::max( s2.shape_[0], data_.shape.stride_ ) ) );
+        }
+        /*! 
+         * \brief release the extra space that is not used by current shape, 
+         *        current shape and content are preserved
+         */
+        inline void ShrinkToFit( void ){
+            if( data_.dptr == NULL ) return;
+            Shape<2> s2 = this->shape.FlatTo2D();
+            if( s2.shape_[0] == 0 || s2.shape_[1] == 0 ){
+                this->FreeSpace(); this->SetEmpty(); return;
+            }
+            if( s2.shape_[0] == data_.shape[0] && s2.shape_[1] == data_.shape[1] ) return;
+            this->ReAlloc( s2 );
+        }
         /*! \brief set whether padding is allowed in tensor */
         inline void set_pad( bool pad ){
             this->pad_ = pad;
@@ -101,7 +200,7 @@ namespace mshadow{
          */
         template<typename TStream>
         inline void LoadBinary( TStream &fi ) {
-            Tensor<cpu,dimension> tmp;
+            Tensor<cpu,dimension,DType> tmp;
             mshadow::LoadBinary( fi, tmp, false );
             this->Resize( tmp.shape );
             Copy( *this, tmp );
@@ -109,35 +208,61 @@ namespace mshadow{
         }
     public:
         // functions to fit exp template
-        inline Tensor<Device,dimension>& operator=( real_t s ){
+        inline Tensor<Device,dimension,DType>& operator=( typename DataType<DType>::ComputeType s ){
             return this->__assign( s );
         }
         template<typename E>
-        inline Tensor<Device,dimension>& operator=( const expr::Exp<E,expr::type::kMapper> &exp ){
+        inline Tensor<Device,dimension,DType>& operator=( const expr::Exp<E,expr::type::kMapper> &exp ){
             return this->__assign( exp );
         }
         template<typename E>
-        inline Tensor<Device,dimension>& operator=( const expr::Exp<E,expr::type::kComplex> &exp ){
+        inline Tensor<Device,dimension,DType>& operator=( const expr::Exp<E,expr::type::kComplex> &exp ){
             return this->__assign( exp );
         }
     private:
         /*! \brief whether we do padding in the space */
         bool pad_;
         /*! \brief the shape of data_ is actually current data space */
-        Tensor<Device, 2> data_;
+        Tensor<Device, 2, DType> data_;
     private:
+        inline void SetEmpty( void ){
+            this->dptr = data_.dptr = NULL;
+            this->shape[0] = 0;
+            this->shape.stride_ = 0;
+            this->data_.shape.stride_ = 0;
+            this->data_.shape[1] = 0;
+        }
+        /*! \brief re-allocate the space to hold cshape in flat 2D form, preserving current shape and content */
+        inline void ReAlloc( const Shape<2> &cshape ){
+            Tensor<Device,2,DType> space( cshape );
+            mshadow::AllocSpace( space, pad_ );
+            Shape<dimension> shape = this->shape;
+            shape.stride_ = pad_ ? space.shape.stride_ : shape[0];
+            Tensor<Device,dimension,DType> dst( space.dptr, shape );
+            if( this->shape.Size() != 0 ){
+                Copy( dst, *this );
+            }
+            this->FreeSpace();
+            data_ = space;
+            this->dptr  = dst.dptr;
+            this->shape = dst.shape;
+        }
         inline void FreeSpace (void){
             if( data_.dptr != NULL ){
                 mshadow::FreeSpace( data_ );
                 data_.dptr = this->dptr = NULL;
             }
         }
-        inline void AllocByShape (const Shape<dimension>& shape){
+        inline void AllocByShape (const Shape<dimension>& shape, bool zero = false){
             if( data_.dptr != NULL ){
                 this->FreeSpace();
             }
             data_.shape = shape.FlatTo2D();
-            mshadow::AllocSpace( data_, pad_ );
+            if( zero ){
+                mshadow::AllocZeroSpace( data_, pad_ );
+            }else{
+                mshadow::AllocSpace( data_, pad_ );
+            }
             this->dptr  = data_.dptr;
             this->shape = shape;
             if( this->pad_ ){
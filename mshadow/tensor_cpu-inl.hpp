@@ -10,47 +10,135 @@
 #include "tensor_sse-inl.hpp"
 
 namespace mshadow {
-    template<int dim>
-    inline void AllocSpace(Tensor<cpu,dim> &obj, bool pad ){
+    /*! \brief allocate space of CPU tensor, zero specifies whether the space is zero filled by allocator */
+    template<int dim, typename DType>
+    inline void AllocSpace(Tensor<cpu,dim,DType> &obj, bool pad, bool zero ){
         size_t pitch;
         if( pad ){
-            obj.dptr = (real_t*)sse2::AlignedMallocPitch
-                ( pitch, obj.shape[0] * sizeof(real_t), obj.FlatTo2D().shape[1] );
-            obj.shape.stride_ = static_cast<index_t>( pitch / sizeof(real_t) );
+            obj.dptr = (DType*)sse2::AlignedMallocPitch
+                ( pitch, obj.shape[0] * sizeof(DType), obj.FlatTo2D().shape[1], zero );
+            obj.shape.stride_ = static_cast<index_t>( pitch / sizeof(DType) );
         }else{
             obj.shape.stride_ = obj.shape[0];
-            obj.dptr = (real_t*)sse2::AlignedMallocPitch
-                ( pitch, obj.shape.Size() * sizeof(real_t), 1 );
+            obj.dptr = (DType*)sse2::AlignedMallocPitch
+                ( pitch, obj.shape.Size() * sizeof(DType), 1, zero );
         }
     }
+    template<int dim, typename DType>
+    inline void AllocSpace(Tensor<cpu,dim,DType> &obj, bool pad ){
+        AllocSpace( obj, pad, false );
+    }
+    template<int dim, typename DType>
+    inline void AllocZeroSpace(Tensor<cpu,dim,DType> &obj, bool pad ){
+        AllocSpace( obj, pad, true );
+    }
 
+    template<typename Device, typename DType, int dim>
+    inline Tensor<Device,dim,DType> NewTensor(const Shape<dim> &shape, typename expr::ExpInfo< Tensor<Device,dim,DType> >::DType initv, bool pad ){
+        Tensor<Device,dim,DType> obj( shape );
+        if( initv == DType(0) ){
+            AllocZeroSpace( obj, pad );
+        }else{
+            AllocSpace( obj, pad );
+            MapExp<sv::saveto>( obj, expr::ScalarExp< typename DataType<DType>::ComputeType >( initv ) );
+        }
+        return obj;
+    }
     template<typename Device, int dim>
     inline Tensor<Device,dim> NewTensor(const Shape<dim> &shape, real_t initv, bool pad ){
-        Tensor<Device, dim> obj( shape );
-        AllocSpace( obj, pad );
-        MapExp<sv::saveto>( obj, expr::ScalarExp( initv ) );
-        return obj;
+        return NewTensor<Device,real_t,dim>( shape, initv, pad );
     }
 
-    template<int dim>
-    inline void FreeSpace(Tensor<cpu,dim> &obj){
+    template<int dim, typename DType>
+    inline void FreeSpace(Tensor<cpu,dim,DType> &obj){
         sse2::AlignedFree( obj.dptr );
         obj.dptr = NULL;
     }
 
-    template<int dim>
-    inline void Copy(Tensor<cpu,dim> _dst, const Tensor<cpu,dim> &_src ){
+    /*! 
+     * \brief copy a block of memory, use streaming store if stream is true 
+     * \param dst destination
+     * \param src source
+     * \param size number of bytes
+     * \param stream whether use non-temporal streaming store
+     */
+    inline void CopyBlock( void *dst, const void *src, size_t size, bool stream ){
+        #if MSHADOW_USE_SSE
+        if( stream ){
+            sse2::StreamCopy( dst, src, size ); return;
+        }
+        #endif
+        memcpy( dst, src, size );
+    }
+    /*! 
+     * \brief copy a continuous block of memory, large block is split into chunks that are copied by threads
+     * \param dst destination
+     * \param src source
+     * \param size number of bytes
+     */
+    inline void CopyBlock( void *dst, const void *src, size_t size ){
+        const bool stream = size >= MSHADOW_COPY_STREAM_BYTES;
+        if( size < MSHADOW_COPY_PARALLEL_BYTES ){
+            CopyBlock( dst, src, size, stream ); return;
+        }
+        // chunk size, keep it multiple of cache line
+        const size_t kChunk = 1UL << 18;
+        const long nchunk = static_cast<long>( (size + kChunk - 1) / kChunk );
+        #pragma omp parallel for schedule(static)
+        for( long i = 0; i < nchunk; ++ i ){
+            const size_t begin = static_cast<size_t>( i ) * kChunk;
+            const size_t len = std::min( kChunk, size - begin );
+            CopyBlock( static_cast<char*>( dst ) + begin, static_cast<const char*>( src ) + begin, len, stream );
+        }
+    }
+
+    template<int dim, typename DType>
+    inline void Copy(Tensor<cpu,dim,DType> _dst, const Tensor<cpu,dim,DType> &_src ){
         utils::Assert( _dst.shape == _src.shape, "Copy:shape mismatch" );
-        Tensor<cpu,2> dst = _dst.FlatTo2D();
-        Tensor<cpu,2> src = _src.FlatTo2D();
-        for (index_t y = 0; y < dst.shape[1]; ++y ) {
-            memcpy( dst[y].dptr, src[y].dptr, sizeof(real_t) * dst.shape[0] );
+        Tensor<cpu,2,DType> dst = _dst.FlatTo2D();
+        Tensor<cpu,2,DType> src = _src.FlatTo2D();
+        if( dst.shape[1] == 1 || ( dst.shape.stride_ == dst.shape[0] && src.shape.stride_ == src.shape[0] ) ){
+            // both are continuous, copy in one block
+            CopyBlock( dst.dptr, src.dptr, sizeof(DType) * dst.shape.Size() );
+            return;
+        }
+        const size_t nbytes = sizeof(DType) * dst.shape.Size();
+        const bool stream = nbytes >= MSHADOW_COPY_STREAM_BYTES;
+        const long nline = static_cast<long>( dst.shape[1] );
+        #pragma omp parallel for schedule(static) if( nbytes >= MSHADOW_COPY_PARALLEL_BYTES )
+        for( long y = 0; y < nline; ++ y ){
+            CopyBlock( dst[y].dptr, src[y].dptr, sizeof(DType) * dst.shape[0], stream );
+        }
+    }
+
+    template<typename DType>
+    inline void BatchGather( Tensor<cpu,2,DType> dst, const Tensor<cpu,2,DType> &src, const index_t *index ){
+        utils::Assert( dst.shape[0] == src.shape[0], "BatchGather: row size mismatch" );
+        for( index_t i = 0; i < dst.shape[1]; ++ i ){
+            utils::Assert( index[i] < src.shape[1], "BatchGather: index out of range" );
+        }
+        // split rows among threads for large batch
+        const long nrow = static_cast<long>( dst.shape[1] );
+        const long kBlock = 64;
+        const long nblock = ( nrow + kBlock - 1 ) / kBlock;
+        #pragma omp parallel for schedule(static) if( sizeof(DType) * dst.shape.Size() >= MSHADOW_COPY_PARALLEL_BYTES )
+        for( long b = 0; b < nblock; ++ b ){
+            const long begin = b * kBlock, n = std::min( kBlock, nrow - begin );
+            #if MSHADOW_USE_SSE
+            sse2::GatherRows( reinterpret_cast<char*>( dst[ begin ].dptr ), sizeof(DType) * dst.shape.stride_,
+                              reinterpret_cast<const char*>( src.dptr ), sizeof(DType) * src.shape.stride_,
+                              index + begin, static_cast<size_t>( n ), sizeof(DType) * dst.shape[0] );
+            #else
+            for( long i = begin; i < begin + n; ++ i ){
+                memcpy( dst[i].dptr, src[ index[i] ].dptr, sizeof(DType) * dst.shape[0] );
+            }
+            #endif
         }
     }
 
-    template<typename Saver, typename E, int dim>
-    inline void MapPlan(Tensor<cpu,dim> _dst, const expr::Plan<E> &plan){
-        Tensor<cpu,2> dst = _dst.FlatTo2D();
+    template<typename Saver, typename E, int dim, typename DType>
+    inline void MapPlan(Tensor<cpu,dim,DType> _dst, const expr::Plan<E> &plan){
+        Tensor<cpu,2,DType> dst = _dst.FlatTo2D();
         for (index_t y = 0; y < dst.shape[1]; ++y ) {
             for (index_t x = 0; x < dst.shape[0]; ++x ) {
                 // trust your compiler! -_- they will optimize it
@@ -60,21 +148,21 @@ namespace mshadow {
     }
 
     // code to handle SSE optimization
-    template<bool pass_check,typename Saver, int dim, typename E, int etype>
+    template<bool pass_check,typename Saver, int dim, typename DType, typename E, int etype>
     struct MapExpCPUEngine;
-    template<typename SV, int dim, typename E, int etype>
-    struct MapExpCPUEngine<false,SV,dim,E,etype>{
-        inline static void Map(Tensor<cpu,dim> dst, const expr::Exp<E,etype> &exp ){
+    template<typename SV, int dim, typename DType, typename E, int etype>
+    struct MapExpCPUEngine<false,SV,dim,DType,E,etype>{
+        inline static void Map(Tensor<cpu,dim,DType> dst, const expr::Exp<E,etype> &exp ){
             MapPlan<SV>( dst, MakePlan( exp.self() ) );
         }
     };
 
     #if MSHADOW_USE_SSE
-    template<typename SV, int dim, typename E, int etype>
-    struct MapExpCPUEngine<true,SV,dim,E,etype>{
-        inline static void Map(Tensor<cpu,dim> dst, const expr::Exp<E,etype> &exp ){
+    template<typename SV, int dim, typename DType, typename E, int etype>
+    struct MapExpCPUEngine<true,SV,dim,DType,E,etype>{
+        inline static void Map(Tensor<cpu,dim,DType> dst, const expr::Exp<E,etype> &exp ){
             using namespace expr;
-            if( SSEAlignCheck<dim,E>::Check( exp.self() ) && SSEAlignCheck< dim,Tensor<cpu,dim> >::Check(dst) ){
+            if( SSEAlignCheck<dim,E>::Check( exp.self() ) && SSEAlignCheck< dim,Tensor<cpu,dim,DType> >::Check(dst) ){
                 MapSSEPlan<SV>( dst, MakeSSEPlan( exp.self() ) );
             }else{
                 MapPlan<SV>( dst, MakePlan( exp.self() ) );
@@ -83,23 +171,23 @@ namespace mshadow {
     };
     #endif
 
-    template<typename Saver, int dim, typename E, int etype>
-    inline void MapExp(Tensor<cpu,dim> dst, const expr::Exp<E,etype> &exp ){
+    template<typename Saver, int dim, typename E, int etype, typename DType>
+    inline void MapExp(Tensor<cpu,dim,DType> dst, const expr::Exp<E,etype> &exp ){
         using namespace expr;
-        TypeCheckPass< TypeCheck<cpu,dim,E>::kMapPass >::Error_All_Tensor_in_Exp_Must_Have_Same_Type();
+        TypeCheckPass< TypeCheck<cpu,dim,DType,E>::kMapPass >::Error_All_Tensor_in_Exp_Must_Have_Same_Type();
         Shape<dim> eshape = ShapeCheck<dim,E>::Check( exp.self() );
         utils::Assert( eshape[0] == 0 || eshape == dst.shape, "Assignment: Shape of Tensors in expression is not consistent with target" );
         #if MSHADOW_USE_SSE
-        MapExpCPUEngine< SSECheck<E>::kPass,Saver,dim,E,etype >::Map( dst, exp );
+        MapExpCPUEngine< SSECheck<E>::kPass,Saver,dim,DType,E,etype >::Map( dst, exp );
         #else
-        MapExpCPUEngine< false,Saver,dim,E,etype >::Map( dst, exp );
+        MapExpCPUEngine< false,Saver,dim,DType,E,etype >::Map( dst, exp );
         #endif
     }
 
-    template<typename Saver, typename Reducer, typename E, int etype>
-    inline void MapReduceKeepLowest( Tensor<cpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale ){
+    template<typename Saver, typename Reducer, typename E, int etype, typename DType>
+    inline void MapReduceKeepLowest( Tensor<cpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale ){
         using namespace expr;
-        TypeCheckPass< TypeCheck<cpu,1,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
+        TypeCheckPass< TypeCheck<cpu,1,DType,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
         Shape<2> eshape = ShapeCheck< ExpInfo<E>::kDim, E >::Check( exp.self() ).FlatTo2D();
 
         utils::Assert( eshape[0] == dst.shape[0], "reduction dimension do not match" );
@@ -107,7 +195,7 @@ namespace mshadow {
         // execution
         expr::Plan<E> plan = MakePlan( exp.self() );
         for( index_t x = 0; x < eshape[0]; ++x ){
-            real_t res = plan.Eval( 0, x );
+            typename DataType<DType>::ComputeType res = plan.Eval( 0, x );
             for( index_t y = 1; y < eshape[1]; ++y ){
                 Reducer::Reduce( res, plan.Eval( y, x ) );
             }
@@ -115,10 +203,10 @@ namespace mshadow {
         }
     }
 
-    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype>
-    inline void MapReduceKeepHighDim( Tensor<cpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale ){
+    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype, typename DType>
+    inline void MapReduceKeepHighDim( Tensor<cpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale ){
         using namespace expr;
-        TypeCheckPass< TypeCheck<cpu,dimkeep,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
+        TypeCheckPass< TypeCheck<cpu,dimkeep,DType,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
         typedef Shape< ExpInfo<E>::kDim > EShape;
         EShape eshape = ShapeCheck< ExpInfo<E>::kDim, E >::Check( exp.self() );
         utils::Assert( eshape[dimkeep] == dst.shape[0], "reduction dimension do not match" );
@@ -130,9 +218,9 @@ namespace mshadow {
         expr::Plan<E> plan = MakePlan( exp.self() );
 
         for( index_t c = 0; c < pshape[2]; ++c ){
-            real_t res = Reducer::kInitV;
+            typename DataType<DType>::ComputeType res; Reducer::SetInitValue( res );
             for( index_t n = 0; n < pshape[3]; ++n ){
-                real_t tres = Reducer::kInitV;
+                typename DataType<DType>::ComputeType tres; Reducer::SetInitValue( tres );
                 for( index_t y = 0; y < pshape[1]; ++y ){
                     for( index_t x = 0; x < pshape[0]; ++x ){
                         Reducer::Reduce( tres, plan.Eval( (n*pshape[2] + c) * pshape[1] + y, x ) );
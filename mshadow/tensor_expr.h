@@ -36,9 +36,17 @@ namespace mshadow{
             inline static void Eval( Container& dst, const EType &exp );
         };
 
-        template<typename Container>
+        template<typename Container, typename DType>
         class ContainerExp;
-        class ScalarExp;
+        template<typename DType = real_t>
+        struct ScalarExp;
+        /*!
+         * \brief static type inference template, gives the dimension, device and element type of each expression,
+         *        defined in tensor_expr_engine-inl.hpp
+         * \tparam E expression
+         */
+        template<typename E>
+        struct ExpInfo;
 
         /*!
          * \brief base class for expression
@@ -58,13 +66,22 @@ namespace mshadow{
             }
         };
 
-        /*! \brief scalar expression */
-        struct ScalarExp: public Exp<ScalarExp, type::kMapper>{
+        /*!
+         * \brief scalar expression
+         * \tparam DType type of the scalar, same as element type of the expression it is used with, ScalarExp<> is the real_t scalar
+         */
+        template<typename DType>
+        struct ScalarExp: public Exp<ScalarExp<DType>, type::kMapper>{
             /*! \brief scalar value */
-            real_t scalar_;
+            DType scalar_;
             /*! \brief constructor */
-            ScalarExp( real_t scalar ):scalar_(scalar){}
+            ScalarExp( DType scalar ):scalar_(scalar){}
         };
+        /*! \brief make a scalar expression of type DType, usage: scalar<double>(1.0) */
+        template<typename DType>
+        inline ScalarExp<DType> scalar( DType s ){
+            return ScalarExp<DType>( s );
+        }
 
         /*! \brief represent a transpose expression of a container */
         template<typename EType>
@@ -83,8 +100,9 @@ namespace mshadow{
         /*!
          * \brief base class of all variables, that can be assigned to values
          * \tparam Container the actually class of data container, e.g. CTensor1D
+         * \tparam DType element type of the container
          */
-        template<typename Container>
+        template<typename Container, typename DType>
         class ContainerExp: public Exp< Container, type::kContainer >{
         public:
             /*!
@@ -96,28 +114,28 @@ namespace mshadow{
             }
         public:
             /*! \brief operator overload */
-            inline Container &operator+=( real_t s ){
-                ExpEngine<sv::plusto,Container>::Eval( this->refself(), ScalarExp(s) );
+            inline Container &operator+=( DType s ){
+                ExpEngine<sv::plusto,Container>::Eval( this->refself(), ScalarExp<DType>(s) );
                 return this->refself();
             }
             /*! \brief operator overload */
-            inline Container &operator-=( real_t s ){
-                ExpEngine<sv::minusto,Container>::Eval( this->refself(), ScalarExp(s) );
+            inline Container &operator-=( DType s ){
+                ExpEngine<sv::minusto,Container>::Eval( this->refself(), ScalarExp<DType>(s) );
                 return this->refself();
             }
             /*! \brief operator overload */
-            inline Container &operator*=( real_t s ){
-                ExpEngine<sv::multo,Container>::Eval( this->refself(), ScalarExp(s) );
+            inline Container &operator*=( DType s ){
+                ExpEngine<sv::multo,Container>::Eval( this->refself(), ScalarExp<DType>(s) );
                 return this->refself();
             }
             /*! \brief operator overload */
-            inline Container &operator/=( real_t s ){
-                ExpEngine<sv::divto,Container>::Eval( this->refself(), ScalarExp(s) );
+            inline Container &operator/=( DType s ){
+                ExpEngine<sv::divto,Container>::Eval( this->refself(), ScalarExp<DType>(s) );
                 return this->refself();
             }
             /*! \brief operator overload */
-            inline Container &__assign( real_t s ){
-                ExpEngine<sv::saveto,Container>::Eval( this->refself(), ScalarExp(s) );
+            inline Container &__assign( DType s ){
+                ExpEngine<sv::saveto,Container>::Eval( this->refself(), ScalarExp<DType>(s) );
                 return this->refself();
             }
         public:
@@ -161,6 +179,18 @@ namespace mshadow{
     }; // namespace expr
 
     namespace expr{
+        /*!
+         * \brief type of the scale of dot, the compute type of the element, integer dot is scaled in real_t
+         * \tparam DType element type of the operands
+         */
+        template<typename DType, bool is_integer = std::numeric_limits<DType>::is_integer>
+        struct DotScaleType{
+            typedef typename DataType<DType>::ComputeType Type;
+        };
+        template<typename DType>
+        struct DotScaleType<DType,true>{
+            typedef real_t Type;
+        };
         /*!
          * \brief matrix multiplication expression dot( lhs[.T], rhs[.T] )
          * \tparam TA type of lhs
@@ -170,30 +200,34 @@ namespace mshadow{
          */
         template<typename TA,typename TB,bool ltrans,bool rtrans>
         struct DotExp: public Exp< DotExp<TA,TB,ltrans,rtrans>, type::kComplex >{
+            /*! \brief element type of the result */
+            typedef typename ExpInfo<TA>::DType DType;
             /*! \brief left operand */
             const TA& lhs_;
             /*! \brief right operand */
             const TB& rhs_;
+            /*! \brief type of scale */
+            typedef typename DotScaleType<DType>::Type ScaleType;
             /*! \brief scale over result */
-            real_t scale_;
+            ScaleType scale_;
             /*! \brief constructor */
-            DotExp( const TA &lhs, const TB &rhs, real_t scale )
+            DotExp( const TA &lhs, const TB &rhs, ScaleType scale )
                 :lhs_(lhs),rhs_(rhs),scale_(scale){}
         };
 
         /*! \brief dot operator def */
-        template<typename TA, typename TB>
-        inline DotExp<TA,TB,false,false> dot( const ContainerExp<TA> &lhs, const ContainerExp<TB> &rhs ){
+        template<typename TA, typename TB, typename DType>
+        inline DotExp<TA,TB,false,false> dot( const ContainerExp<TA,DType> &lhs, const ContainerExp<TB,DType> &rhs ){
             return DotExp<TA,TB,false,false>( lhs.self(), rhs.self(), 1.0f );
         }
         /*! \brief dot operator def */
-        template<typename TA, typename TB>
-        inline DotExp<TA,TB,true,false> dot( const TransposeExp<TA> &lhs, const ContainerExp<TB> &rhs ){
+        template<typename TA, typename TB, typename DType>
+        inline DotExp<TA,TB,true,false> dot( const TransposeExp<TA> &lhs, const ContainerExp<TB,DType> &rhs ){
             return DotExp<TA,TB,true,false>( lhs.exp, rhs.self(), 1.0f );
         }
         /*! \brief dot operator def */
-        template<typename TA, typename TB>
-        inline DotExp<TA,TB,false,true> dot( const ContainerExp<TA> &lhs, const TransposeExp<TB> &rhs ){
+        template<typename TA, typename TB, typename DType>
+        inline DotExp<TA,TB,false,true> dot( const ContainerExp<TA,DType> &lhs, const TransposeExp<TB> &rhs ){
             return DotExp<TA,TB,false,true>( lhs.self(), rhs.exp, 1.0f );
         }
         /*! \brief dot operator def */
@@ -203,12 +237,12 @@ namespace mshadow{
         }
         /*! \brief dot operator def */
         template<typename TA, typename TB, bool ltrans, bool rtrans >
-        inline DotExp<TA,TB,ltrans,rtrans> operator*( const DotExp<TA,TB,ltrans,rtrans> &lhs, real_t rhs ){
+        inline DotExp<TA,TB,ltrans,rtrans> operator*( const DotExp<TA,TB,ltrans,rtrans> &lhs, typename DotExp<TA,TB,ltrans,rtrans>::ScaleType rhs ){
             return DotExp<TA,TB,ltrans,rtrans>( lhs.lhs_, lhs.rhs_, lhs.scale_ * rhs );
         }
         /*! \brief scale of dot operation */
         template<typename TA, typename TB, bool ltrans, bool rtrans >
-        inline DotExp<TA,TB,ltrans,rtrans> operator*( real_t lhs, const DotExp<TA,TB,ltrans,rtrans> &rhs ){
+        inline DotExp<TA,TB,ltrans,rtrans> operator*( typename DotExp<TA,TB,ltrans,rtrans>::ScaleType lhs, const DotExp<TA,TB,ltrans,rtrans> &rhs ){
             return DotExp<TA,TB,ltrans,rtrans>( rhs.lhs_, rhs.rhs_, rhs.scale_ * lhs );
         }
     }; // namespace expr
@@ -255,12 +289,14 @@ namespace mshadow{
         }
         /*! \brief operator overload for const */
         template<typename OP,typename TA, int ta>
-        inline BinaryMapExp<OP,TA,ScalarExp, (ta|type::kMapper) > F( const Exp<TA,ta> &lhs, const ScalarExp &rhs ){
+        inline BinaryMapExp<OP,TA,ScalarExp<typename ExpInfo<TA>::DType>, (ta|type::kMapper) >
+        F( const Exp<TA,ta> &lhs, const ScalarExp<typename ExpInfo<TA>::DType> &rhs ){
             return MakeExp<OP>( lhs, rhs );
         }
         /*! \brief operator overload for const */
         template<typename OP,typename TB, int tb>
-        inline BinaryMapExp<OP,ScalarExp,TB, (tb|type::kMapper) > F( const ScalarExp &lhs, const Exp<TB,tb>& rhs ){
+        inline BinaryMapExp<OP,ScalarExp<typename ExpInfo<TB>::DType>,TB, (tb|type::kMapper) >
+        F( const ScalarExp<typename ExpInfo<TB>::DType> &lhs, const Exp<TB,tb>& rhs ){
             return MakeExp<OP>( lhs, rhs );
         }
 
@@ -288,43 +324,51 @@ namespace mshadow{
         // constant operators
         /*! \brief operator overload */
         template<typename TA, int ta>
-        inline BinaryMapExp<op::plus, TA, ScalarExp, (ta|type::kMapper) > operator+( const Exp<TA,ta>& lhs,  const ScalarExp& rhs ){
+        inline BinaryMapExp<op::plus, TA, ScalarExp<typename ExpInfo<TA>::DType>, (ta|type::kMapper) >
+        operator+( const Exp<TA,ta>& lhs, const ScalarExp<typename ExpInfo<TA>::DType>& rhs ){
             return MakeExp<op::plus>( lhs, rhs );
         }
         /*! \brief operator overload */
         template<typename TA, int ta>
-        inline BinaryMapExp<op::minus, TA, ScalarExp, (ta|type::kMapper) > operator-( const Exp<TA,ta>& lhs,  const ScalarExp& rhs ){
+        inline BinaryMapExp<op::minus, TA, ScalarExp<typename ExpInfo<TA>::DType>, (ta|type::kMapper) >
+        operator-( const Exp<TA,ta>& lhs, const ScalarExp<typename ExpInfo<TA>::DType>& rhs ){
             return MakeExp<op::minus>( lhs, rhs );
         }
         /*! \brief operator overload */
         template<typename TA, int ta>
-        inline BinaryMapExp<op::mul, TA, ScalarExp, (ta|type::kMapper) > operator*( const Exp<TA,ta>& lhs,  const ScalarExp& rhs ){
+        inline BinaryMapExp<op::mul, TA, ScalarExp<typename ExpInfo<TA>::DType>, (ta|type::kMapper) >
+        operator*( const Exp<TA,ta>& lhs, const ScalarExp<typename ExpInfo<TA>::DType>& rhs ){
             return MakeExp<op::mul>( lhs, rhs );
         }
         /*! \brief operator overload */
         template<typename TA, int ta>
-        inline BinaryMapExp<op::div, TA, ScalarExp, (ta|type::kMapper) > operator/( const Exp<TA,ta>& lhs,  const ScalarExp& rhs ){
+        inline BinaryMapExp<op::div, TA, ScalarExp<typename ExpInfo<TA>::DType>, (ta|type::kMapper) >
+        operator/( const Exp<TA,ta>& lhs, const ScalarExp<typename ExpInfo<TA>::DType>& rhs ){
             return MakeExp<op::div>( lhs, rhs );
         }
         // constant operators 2
         /*! \brief operator overload */
         template<typename TB, int tb>
-        inline BinaryMapExp<op::plus, ScalarExp, TB, (tb|type::kMapper) > operator+( const ScalarExp& lhs, const Exp<TB,tb>& rhs ){
+        inline BinaryMapExp<op::plus, ScalarExp<typename ExpInfo<TB>::DType>, TB, (tb|type::kMapper) >
+        operator+( const ScalarExp<typename ExpInfo<TB>::DType>& lhs, const Exp<TB,tb>& rhs ){
             return MakeExp<op::plus>( lhs, rhs );
         }
         /*! \brief operator overload */
         template<typename TB, int tb>
-        inline BinaryMapExp<op::minus, ScalarExp, TB, (tb|type::kMapper) > operator-( const ScalarExp& lhs, const Exp<TB,tb>& rhs ){
+        inline BinaryMapExp<op::minus, ScalarExp<typename ExpInfo<TB>::DType>, TB, (tb|type::kMapper) >
+        operator-( const ScalarExp<typename ExpInfo<TB>::DType>& lhs, const Exp<TB,tb>& rhs ){
             return MakeExp<op::minus>( lhs, rhs );
         }
         /*! \brief operator overload */
         template<typename TB, int tb>
-        inline BinaryMapExp<op::mul, ScalarExp, TB, (tb|type::kMapper) > operator*( const ScalarExp& lhs, const Exp<TB,tb>& rhs ){
+        inline BinaryMapExp<op::mul, ScalarExp<typename ExpInfo<TB>::DType>, TB, (tb|type::kMapper) >
+        operator*( const ScalarExp<typename ExpInfo<TB>::DType>& lhs, const Exp<TB,tb>& rhs ){
             return MakeExp<op::mul>( lhs, rhs );
         }
         /*! \brief operator overload */
         template<typename TB, int tb>
-        inline BinaryMapExp<op::div, ScalarExp, TB, (tb|type::kMapper) > operator/( const ScalarExp& lhs, const Exp<TB,tb>& rhs ){
+        inline BinaryMapExp<op::div, ScalarExp<typename ExpInfo<TB>::DType>, TB, (tb|type::kMapper) >
+        operator/( const ScalarExp<typename ExpInfo<TB>::DType>& lhs, const Exp<TB,tb>& rhs ){
             return MakeExp<op::div>( lhs, rhs );
         }
     };
@@ -363,5 +407,33 @@ namespace mshadow{
             return MakeExp<OP>(src);
         }
     };
+
+    namespace expr{
+        /*!
+         * \brief type cast expression, convert each element of src to DstDType
+         * \tparam DstDType target element type
+         * \tparam TA type of src
+         * \tparam etype expression type, sa namespace::type
+         */
+        template<typename DstDType, typename TA, int etype>
+        struct TypecastExp: public Exp< TypecastExp<DstDType,TA,etype>, etype >{
+            /*! \brief source expression */
+            const TA& src_;
+            /*! \brief constructor */
+            TypecastExp( const TA &src ):src_(src){}
+        };
+        /*!
+         * \brief cast the elements of an expression to DstDType, usage: acc += tcast<double>( grad ),
+         *        all tensors in one expression have the same element type, tcast is used to mix element types
+         * \param src source expression
+         * \tparam DstDType target element type
+         * \tparam TA source expression
+         * \tparam ta source expression type
+         */
+        template<typename DstDType, typename TA, int ta>
+        inline TypecastExp<DstDType,TA,(ta|type::kMapper) > tcast( const Exp<TA,ta> &src ){
+            return TypecastExp<DstDType,TA,(ta|type::kMapper) >( src.self() );
+        }
+    };
 };
 #endif
@@ -33,54 +33,56 @@ namespace mshadow{
         class Plan{
         public:
             /*!
-             * \brief evaluate the expression at index [y][x]
+             * \brief evaluate the expression at index [y][x], the result has the element type of the expression,
              *        to be implemented by SubType
              */
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const;
+            MSHADOW_XINLINE typename ExpInfo<ExpType>::DType Eval( index_t y, index_t x ) const;
         };
 
-        template <typename Device, int dim>
-        class Plan< Tensor<Device,dim> >{
+        // elements are converted to ComputeType when loaded
+        template <typename Device, int dim, typename DType>
+        class Plan< Tensor<Device,dim,DType> >{
         public:
-            Plan( const Tensor<Device,dim> &t )
+            Plan( const Tensor<Device,dim,DType> &t )
                 :dptr_(t.dptr),stride_(t.shape.stride_){}
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE typename DataType<DType>::ComputeType Eval( index_t y, index_t x ) const{
                 return dptr_[ y * stride_ + x ];
             }
         private:
-            const real_t  *dptr_;
+            const DType  *dptr_;
             index_t stride_;
         };
         // special evaluation case for 1d tensor
-        template <typename Device>
-        class Plan< Tensor<Device,1> >{
+        template <typename Device, typename DType>
+        class Plan< Tensor<Device,1,DType> >{
         public:
-            Plan( const Tensor<Device,1> &t ):dptr_(t.dptr){}
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            Plan( const Tensor<Device,1,DType> &t ):dptr_(t.dptr){}
+            MSHADOW_XINLINE typename DataType<DType>::ComputeType Eval( index_t y, index_t x ) const{
                 return dptr_[ x ];
             }
         private:
-            const real_t  *dptr_;
+            const DType  *dptr_;
         };
         
-        template<>
-        class Plan<ScalarExp>{
+        template<typename DType>
+        class Plan< ScalarExp<DType> >{
         public:
-            Plan( real_t scalar ):scalar_(scalar){}
+            Plan( DType scalar ):scalar_(scalar){}
             /*! \brief evaluate at [y][x] */
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                     return scalar_;
             }
         private:
-            real_t scalar_;
+            DType scalar_;
         };
 
         template<typename OP, typename TA, typename TB,int etype>
         class Plan< BinaryMapExp<OP,TA,TB,etype> >{
         public:
+            typedef typename ExpInfo<TA>::DType DType;
             Plan( const Plan<TA> &lhs, const Plan<TB> &rhs )
                 :lhs_(lhs), rhs_(rhs){}
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                 return OP::Map( lhs_.Eval( y, x ), rhs_.Eval( y, x ) );
             }
         private:
@@ -91,20 +93,32 @@ namespace mshadow{
         template<typename OP, typename TA, int etype>
         class Plan< UnaryMapExp<OP,TA,etype> >{
         public:
+            typedef typename ExpInfo<TA>::DType DType;
             Plan( const Plan<TA> &src ):src_(src){}
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                 return OP::Map( src_.Eval( y, x ) );
             }
         private:
             Plan<TA> src_;
         };
 
+        template<typename DstDType, typename TA, int etype>
+        class Plan< TypecastExp<DstDType,TA,etype> >{
+        public:
+            Plan( const Plan<TA> &src ):src_(src){}
+            MSHADOW_XINLINE typename DataType<DstDType>::ComputeType Eval( index_t y, index_t x ) const{
+                return static_cast< typename DataType<DstDType>::ComputeType >( src_.Eval( y, x ) );
+            }
+        private:
+            Plan<TA> src_;
+        };
         
         template<typename SubType, typename SrcExp, int dim>
         struct Plan< MakeTensorExp<SubType,SrcExp,dim> >{
         public:
+            typedef typename ExpInfo< MakeTensorExp<SubType,SrcExp,dim> >::DType DType;
             Plan( const Plan<SubType> &src ):src_(src){}
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                 return src_.Eval( y, x );
             }
         private:
@@ -116,12 +130,13 @@ namespace mshadow{
         inline Plan< BinaryMapExp<OP,TA,TB,etype> > MakePlan( const BinaryMapExp<OP,TA,TB,etype> &e );
 
         // translate from exp to execution plan
-        inline Plan<ScalarExp> MakePlan( const ScalarExp &e ){
-            return Plan<ScalarExp>( e.scalar_ );
+        template<typename DType>
+        inline Plan< ScalarExp<DType> > MakePlan( const ScalarExp<DType> &e ){
+            return Plan< ScalarExp<DType> >( e.scalar_ );
         }
 
-        template<typename T>
-        inline Plan<T> MakePlan( const ContainerExp<T> &e ){
+        template<typename T, typename DType>
+        inline Plan<T> MakePlan( const ContainerExp<T,DType> &e ){
             return Plan<T>( e.self() );
         }
 
@@ -135,6 +150,11 @@ namespace mshadow{
             return Plan< UnaryMapExp<OP,TA,etype> >( MakePlan(e.src_) );
         }
 
+        template<typename DstDType, typename TA, int etype>
+        inline Plan< TypecastExp<DstDType,TA,etype> > MakePlan( const TypecastExp<DstDType,TA,etype> &e ){
+            return Plan< TypecastExp<DstDType,TA,etype> >( MakePlan(e.src_) );
+        }
+
         template<typename OP, typename TA, typename TB, int etype>
         inline Plan< BinaryMapExp<OP,TA,TB,etype> > MakePlan( const BinaryMapExp<OP,TA,TB,etype> &e ){
             return Plan< BinaryMapExp<OP,TA,TB,etype> >( MakePlan(e.lhs_), MakePlan(e.rhs_) );
@@ -142,11 +162,22 @@ namespace mshadow{
     }; // namespace expr
 
     namespace expr{
+        /*! \brief whether two types are the same, kValue = true if A and B are the same type */
+        template<typename A, typename B>
+        struct SameType{
+            const static bool kValue = false;
+        };
+        template<typename A>
+        struct SameType<A,A>{
+            const static bool kValue = true;
+        };
         /*!
          * \brief static type inference template, 
          *        used to get the dimension of each expression, 
          *        if ExpInfo<E>::kDim == -1, this means here are mismatch in expression
          *        if ( ExpInfo<E>::kDevMask & cpu::kDevMask ) != 0, this means this expression can be assigned to cpu
+         *        ExpInfo<E>::DType is the element type of the expression, all tensors in one expression must have the same element type,
+         *        a tensor takes part in expression with DataType<DType>::ComputeType of its element type
          * \tparam E expression
          */
         template<typename E>
@@ -154,47 +185,61 @@ namespace mshadow{
             const static int kDim = -1;
             const static int kDevMask = 0;
         };
-        template<>
-        struct ExpInfo<ScalarExp>{
+        template<typename DT>
+        struct ExpInfo< ScalarExp<DT> >{
+            typedef DT DType;
             const static int kDim = 0;
             const static int kDevMask = 0xffff;
         };
-        template<typename Device, int dim>
-        struct ExpInfo< Tensor<Device,dim> >{
+        template<typename Device, int dim, typename DT>
+        struct ExpInfo< Tensor<Device,dim,DT> >{
+            typedef typename DataType<DT>::ComputeType DType;
             const static int kDim = dim;
             const static int kDevMask = Device::kDevMask;            
         };
         template<typename T, typename SrcExp, int dim>
         struct ExpInfo< MakeTensorExp<T,SrcExp,dim> >{
+            typedef typename ExpInfo<SrcExp>::DType DType;
             const static int kDimSrc = ExpInfo<SrcExp>::kDim;
             const static int kDim = kDimSrc >= 0 ? dim : -1;
             const static int kDevMask = ExpInfo<SrcExp>::kDevMask;
         };
         template<typename OP, typename TA, int etype>
         struct ExpInfo< UnaryMapExp<OP,TA,etype> >{
+            typedef typename ExpInfo<TA>::DType DType;
+            const static int kDim = ExpInfo<TA>::kDim;
+            const static int kDevMask = ExpInfo<TA>::kDevMask;
+        };
+        template<typename DstDType, typename TA, int etype>
+        struct ExpInfo< TypecastExp<DstDType,TA,etype> >{
+            typedef typename DataType<DstDType>::ComputeType DType;
             const static int kDim = ExpInfo<TA>::kDim;
             const static int kDevMask = ExpInfo<TA>::kDevMask;
         };
         template<typename OP, typename TA, typename TB, int etype>
         struct ExpInfo< BinaryMapExp<OP,TA,TB,etype> >{
+            typedef typename ExpInfo<TA>::DType DType;
+            const static bool kSameType = SameType< DType, typename ExpInfo<TB>::DType >::kValue;
             const static int kDimLhs = ExpInfo<TA>::kDim;
             const static int kDimRhs = ExpInfo<TB>::kDim;
-            const static int kDim = (kDimLhs>=0 && kDimRhs >= 0) ? \
+            const static int kDim = (kSameType && kDimLhs>=0 && kDimRhs >= 0) ? \
                 ( kDimLhs==0 ? kDimRhs : ( (kDimRhs==0||kDimLhs==kDimRhs) ? kDimLhs : -1 ) ):-1;
             const static int kDevMask = ExpInfo<TA>::kDevMask & ExpInfo<TB>::kDevMask;
         };
 
         /*! \brief template to do type check */
-        template<typename Device, int dim, typename E>
+        template<typename Device, int dim, typename DType, typename E>
         struct TypeCheck{
             /*! \brief dimension of expression*/
             const static int kExpDim = ExpInfo<E>::kDim;
             /*! \brief whether the expression device type matches */
             const static bool kDevPass = (ExpInfo<E>::kDevMask & Device::kDevMask) != 0;
+            /*! \brief whether the expression element type matches the target */
+            const static bool kTypePass = SameType< typename DataType<DType>::ComputeType, typename ExpInfo<E>::DType >::kValue;
             /*! \brief whether the expression can be mapped to expression of dim */
-            const static bool kMapPass = (kExpDim == 0 || kExpDim == dim) && kDevPass;
+            const static bool kMapPass = (kExpDim == 0 || kExpDim == dim) && kDevPass && kTypePass;
             /*! \brief whether the expression can be reduced to expression of dim */
-            const static bool kRedPass = (kExpDim > dim) && kDevPass;
+            const static bool kRedPass = (kExpDim > dim) && kDevPass && kTypePass;
         };
 
         template<bool kPass>
@@ -216,17 +261,17 @@ namespace mshadow{
             inline static Shape<dim> Check( const E &t );
         };
         
-        template<int dim>
-        struct ShapeCheck<dim,ScalarExp>{
-            inline static Shape<dim> Check( const ScalarExp &exp ){
+        template<int dim, typename DType>
+        struct ShapeCheck< dim,ScalarExp<DType> >{
+            inline static Shape<dim> Check( const ScalarExp<DType> &exp ){
                 // use lowest dimension to mark scalar exp
                 Shape<dim> shape; shape[0] = 0; 
                 return shape;
             }
         };
-        template<int dim,typename Device>
-        struct ShapeCheck<dim,Tensor<Device,dim> >{
-            inline static Shape<dim> Check( const Tensor<Device,dim> &t ){
+        template<int dim,typename Device,typename DType>
+        struct ShapeCheck<dim,Tensor<Device,dim,DType> >{
+            inline static Shape<dim> Check( const Tensor<Device,dim,DType> &t ){
                 return t.shape;
             }
         };
@@ -243,6 +288,12 @@ namespace mshadow{
                 return s;
             }
         };
+        template<int dim, typename DstDType, typename TA, int etype>
+        struct ShapeCheck< dim,TypecastExp<DstDType,TA,etype> >{
+            inline static Shape<dim> Check( const TypecastExp<DstDType,TA,etype> &t ){
+                return ShapeCheck<dim,TA>::Check( t.src_ );
+            }
+        };
         template<int dim, typename OP, typename TA, typename TB, int etype>
         struct ShapeCheck< dim, BinaryMapExp<OP,TA,TB,etype> >{
             inline static Shape<dim> Check( const BinaryMapExp<OP,TA,TB,etype> &t ){
@@ -258,9 +309,9 @@ namespace mshadow{
 
     // the matrix OP depends on BLAS
     namespace expr{
-        template<typename SV,typename Device, int ddim, int ldim, int rdim, bool ltrans, bool rtrans>
+        template<typename SV,typename Device, int ddim, int ldim, int rdim, bool ltrans, bool rtrans, typename DType>
         struct DotEngine{
-            inline static void Eval( Tensor<Device,ddim> &dst, const Tensor<Device,ldim> &lhs, const Tensor<Device,rdim> &rhs, real_t scale );
+            inline static void Eval( Tensor<Device,ddim,DType> &dst, const Tensor<Device,ldim,DType> &lhs, const Tensor<Device,rdim,DType> &rhs, DType scale );
         };
 
         // handles the dot
@@ -335,9 +386,9 @@ namespace mshadow{
             return transpose ? Shape2(shape[0],shape[1]) : shape;
         }
         // dst = dot( lhs[.T], rhs[.T] )
-        template<typename SV, typename xpu, bool transpose_left, bool transpose_right>
-        struct DotEngine<SV,xpu,2,2,2,transpose_left,transpose_right>{
-            inline static void Eval( Tensor<xpu,2> &dst, const Tensor<xpu,2> &lhs, const Tensor<xpu,2> &rhs, real_t scale ) {
+        template<typename SV, typename xpu, bool transpose_left, bool transpose_right, typename DType>
+        struct DotEngine<SV,xpu,2,2,2,transpose_left,transpose_right,DType>{
+            inline static void Eval( Tensor<xpu,2,DType> &dst, const Tensor<xpu,2,DType> &lhs, const Tensor<xpu,2,DType> &rhs, DType scale ) {
                 Shape<2> sleft  = GetShape( lhs.shape, transpose_left );
                 Shape<2> sright = GetShape( rhs.shape, transpose_right );
                 utils::Assert( dst.shape[1] == sleft[1] && dst.shape[0] == sright[0] \
@@ -355,9 +406,9 @@ namespace mshadow{
                       dst.dptr, dst.shape.stride_ );
             }
         };
-        template<typename SV, typename xpu, bool transpose_right>
-        struct DotEngine<SV,xpu,1,1,2,false,transpose_right>{
-            inline static void Eval( Tensor<xpu,1> &dst, const Tensor<xpu,1> &lhs, const Tensor<xpu,2> &rhs, real_t scale ) {
+        template<typename SV, typename xpu, bool transpose_right, typename DType>
+        struct DotEngine<SV,xpu,1,1,2,false,transpose_right,DType>{
+            inline static void Eval( Tensor<xpu,1,DType> &dst, const Tensor<xpu,1,DType> &lhs, const Tensor<xpu,2,DType> &rhs, DType scale ) {
                 Shape<2> sright = GetShape( rhs.shape, transpose_right );
                 utils::Assert( dst.shape[0] == sright[0] && lhs.shape[0] == sright[1], "dot-gemv: matrix shape mismatch");
                 BLASEngine<xpu>::gemv
@@ -368,16 +419,16 @@ namespace mshadow{
                       dst.dptr, 1 );
             }
         };        
-        template<typename SV, typename xpu>
-        struct DotEngine<SV,xpu,2,1,1,true,false>{
-            inline static void Eval( Tensor<xpu,2> &dst, const Tensor<xpu,1> &lhs, const Tensor<xpu,1> &rhs, real_t scale ) {
+        template<typename SV, typename xpu, typename DType>
+        struct DotEngine<SV,xpu,2,1,1,true,false,DType>{
+            inline static void Eval( Tensor<xpu,2,DType> &dst, const Tensor<xpu,1,DType> &lhs, const Tensor<xpu,1,DType> &rhs, DType scale ) {
                 utils::Assert( dst.shape[1] == lhs.shape[0] && dst.shape[0] == rhs.shape[0], "dot-ger: matrix shape mismatch" );
                 if( SV::kBetaBLAS < 1e-6f ){
                     BLASEngine<xpu>::ger
                         ( rhs.shape[0], lhs.shape[0], scale * SV::kAlphaBLAS,
                           rhs.dptr, 1, lhs.dptr, 1, dst.dptr, dst.shape.stride_ );
                 }else{
-                    DotEngine<SV,xpu,2,2,2,true,false>::Eval( dst, lhs.FlatTo2D(), rhs.FlatTo2D(), scale );
+                    DotEngine<SV,xpu,2,2,2,true,false,DType>::Eval( dst, lhs.FlatTo2D(), rhs.FlatTo2D(), scale );
                 }
             }
         };
@@ -386,29 +437,29 @@ namespace mshadow{
 
     namespace expr{
         /*! \brief some engine that evaluate complex expression */
-        template<typename SV, typename Device, int dim, typename E>
+        template<typename SV, typename Device, int dim, typename DType, typename E>
         struct ExpComplexEngine{
-            inline static void Eval( Tensor<Device,dim>& dst, const E &exp );
+            inline static void Eval( Tensor<Device,dim,DType>& dst, const E &exp );
         };
-        template<typename SV, typename Device, int dim>
-        struct ExpEngine<SV, Tensor<Device,dim> >{
+        template<typename SV, typename Device, int dim, typename DType>
+        struct ExpEngine<SV, Tensor<Device,dim,DType> >{
             template<typename E>
-            inline static void Eval( Tensor<Device,dim>& dst, const Exp<E,type::kMapper> &exp ){
-                MapExp<SV,dim,E>( dst, exp );
+            inline static void Eval( Tensor<Device,dim,DType>& dst, const Exp<E,type::kMapper> &exp ){
+                MapExp<SV>( dst, exp );
             }
             template<typename E>
-            inline static void Eval( Tensor<Device,dim>& dst, const Exp<E,type::kContainer> &exp ){
-                MapExp<SV,dim,E>( dst, exp );
+            inline static void Eval( Tensor<Device,dim,DType>& dst, const Exp<E,type::kContainer> &exp ){
+                MapExp<SV>( dst, exp );
             }
             template<typename E>
-            inline static void Eval( Tensor<Device,dim>& dst, const Exp<E,type::kComplex> &exp ){
-                ExpComplexEngine<SV,Device,dim,E>::Eval( dst, exp.self() );
+            inline static void Eval( Tensor<Device,dim,DType>& dst, const Exp<E,type::kComplex> &exp ){
+                ExpComplexEngine<SV,Device,dim,DType,E>::Eval( dst, exp.self() );
             }
         };
-        template<typename SV, typename Device, int dim, int ldim,int rdim,bool ltrans,bool rtrans>
-        struct ExpComplexEngine< SV, Device, dim, DotExp< Tensor<Device,ldim>, Tensor<Device,rdim>, ltrans, rtrans > >{
-            inline static void Eval( Tensor<Device,dim> &dst, const DotExp< Tensor<Device,ldim>, Tensor<Device,rdim>, ltrans, rtrans > &exp ){
-                DotEngine<SV,Device,dim,ldim,rdim,ltrans,rtrans>::Eval( dst, exp.lhs_, exp.rhs_, exp.scale_ );
+        template<typename SV, typename Device, int dim, int ldim,int rdim,bool ltrans,bool rtrans, typename DType>
+        struct ExpComplexEngine< SV, Device, dim, DType, DotExp< Tensor<Device,ldim,DType>, Tensor<Device,rdim,DType>, ltrans, rtrans > >{
+            inline static void Eval( Tensor<Device,dim,DType> &dst, const DotExp< Tensor<Device,ldim,DType>, Tensor<Device,rdim,DType>, ltrans, rtrans > &exp ){
+                DotEngine<SV,Device,dim,ldim,rdim,ltrans,rtrans,DType>::Eval( dst, exp.lhs_, exp.rhs_, exp.scale_ );
             }
         };
     }; // namespace expr
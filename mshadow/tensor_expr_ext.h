@@ -5,6 +5,8 @@
  * \brief some extension of expressions, used to support something beyond elementwise op
  * \author Tianqi Chen, Bing Xu
  */
+#include <vector>
+#include <algorithm>
 #include "tensor_expr_engine-inl.hpp"
 namespace mshadow{
     // Declaration of expressions goes here
@@ -16,13 +18,14 @@ namespace mshadow{
          * \tparam Device which device it lies
          * \tparam dimdst  target tensor dimension
          * \tparam dimcast the dimension where the 1D tensor fills in by index
+         * \tparam DType element type of the tensor
          */
-        template<typename Device, int dimdst, int dimcast>
-        struct Broadcast1DExp: public MakeTensorExp< Broadcast1DExp<Device,dimdst,dimcast>,Tensor<Device,1>,dimdst>{
+        template<typename Device, int dimdst, int dimcast, typename DType = real_t>
+        struct Broadcast1DExp: public MakeTensorExp< Broadcast1DExp<Device,dimdst,dimcast,DType>,Tensor<Device,1,DType>,dimdst>{
             /*! \brief source operand */
-            const Tensor<Device,1> src_;
+            const Tensor<Device,1,DType> src_;
             /*! \brief constructor */
-            Broadcast1DExp( const Tensor<Device,1> &src, Shape<dimdst> shape ):src_(src){
+            Broadcast1DExp( const Tensor<Device,1,DType> &src, Shape<dimdst> shape ):src_(src){
                 this->shape_ = shape;
             }
         };
@@ -70,17 +73,18 @@ namespace mshadow{
          *    this is a version supporting multiple images
          * \tparam Device which device it lies
          * \tparam dstdim destination dimension
+         * \tparam DType element type of the tensor
          */
-        template<typename Device, int dstdim>
-        struct PackColToPatchXExp: public MakeTensorExp< PackColToPatchXExp<Device,dstdim>, Tensor<Device,2>, dstdim>{
+        template<typename Device, int dstdim, typename DType = real_t>
+        struct PackColToPatchXExp: public MakeTensorExp< PackColToPatchXExp<Device,dstdim,DType>, Tensor<Device,2,DType>, dstdim>{
             /*! \brief source operand */
-            const Tensor<Device,2>& mat_;
+            const Tensor<Device,2,DType>& mat_;
             /*! \brief patch size */
             index_t psize_;
             /*! \brief patch stride */
             index_t pstride_;
             /*! \brief constructor */
-            PackColToPatchXExp( const Tensor<Device,2> &mat, Shape<dstdim> imshape, index_t psize, index_t pstride )
+            PackColToPatchXExp( const Tensor<Device,2,DType> &mat, Shape<dstdim> imshape, index_t psize, index_t pstride )
                 :mat_(mat), psize_(psize), pstride_(pstride){
                 this->shape_ = imshape;
                 const index_t o_height = ( imshape[1]  - psize ) / pstride + 1;                
@@ -148,10 +152,12 @@ namespace mshadow{
         struct ReduceTo1DExp: public Exp< ReduceTo1DExp<EType,Reducer, dimkeep>, type::kComplex >{
             /*! \brief source operand */
             const EType& src_;
+            /*! \brief element type of the expression */
+            typedef typename ExpInfo<EType>::DType DType;
             /*! \brief source operand, scale of the  */
-            real_t scale_;
+            DType scale_;
             /*! \brief construct a repmat expression from src and nrow */
-            ReduceTo1DExp( const EType& src, real_t scale ):src_(src),scale_(scale){}
+            ReduceTo1DExp( const EType& src, DType scale ):src_(src),scale_(scale){}
         };
 
         /*!
@@ -200,22 +206,23 @@ namespace mshadow{
          * \brief unpooling expr reverse operation of pooling, used to pass gradient back
          * \tparam Reducer specifies reduction operation during pooling
          * \tparam Device which device it lies
+         * \tparam DType element type of the tensor
          */
-        template<typename Reducer, typename Device>
-        struct UnPoolingExp: public MakeTensorExp< UnPoolingExp<Reducer, Device>, Tensor<Device,4>, 4> {
+        template<typename Reducer, typename Device, typename DType = real_t>
+        struct UnPoolingExp: public MakeTensorExp< UnPoolingExp<Reducer, Device, DType>, Tensor<Device,4,DType>, 4> {
             /*! \brief source input, corresponds to src in pooling */
-            const Tensor<Device, 4>& data_src_;
+            const Tensor<Device, 4, DType>& data_src_;
             /*! \brief result of pooled data, corresponds to result of pooling */
-            const Tensor<Device, 4>& data_pooled_;
+            const Tensor<Device, 4, DType>& data_pooled_;
             /*! \brief gradient data of pooled part, to be propgate down */
-            const Tensor<Device, 4>& grad_pooled_;
+            const Tensor<Device, 4, DType>& grad_pooled_;
             /*! \brief kernel size */
             index_t ksize_;
             /*! \brief kernel stride */
             index_t kstride_;
             /*! \brief constructor */
-            UnPoolingExp( const Tensor<Device,4> &data_src,  const Tensor<Device,4> &data_pooled,
-                          const Tensor<Device,4> &grad_pooled, index_t ksize, index_t kstride )
+            UnPoolingExp( const Tensor<Device,4,DType> &data_src,  const Tensor<Device,4,DType> &data_pooled,
+                          const Tensor<Device,4,DType> &grad_pooled, index_t ksize, index_t kstride )
                 : data_src_(data_src), data_pooled_(data_pooled), grad_pooled_(grad_pooled),
                   ksize_(ksize), kstride_(kstride) {
                 utils::Assert( grad_pooled.shape == data_pooled.shape, "UnPoolingExp: pooled shape mismatch" );
@@ -325,6 +332,44 @@ namespace mshadow{
                 utils::Assert( this->shape_[2] >= nsize_, "ChannelPoolingExp: local size need to be smaller than number of channels" );
             }
         };
+
+        /*!
+         * \brief gather rows of a matrix by index, row y of result is src[ index[y] ]
+         * \tparam Device which device it lies
+         * \tparam DType element type of the source
+         * \tparam IType element type of the index, e.g. index_t, or real_t for labels
+         */
+        template<typename Device, typename DType, typename IType>
+        struct TakeExp: public MakeTensorExp< TakeExp<Device,DType,IType>, Tensor<Device,2,DType>, 2 >{
+            /*! \brief source operand */
+            const Tensor<Device,2,DType> src_;
+            /*! \brief row index */
+            const Tensor<Device,1,IType> index_;
+            /*! \brief constructor */
+            TakeExp( const Tensor<Device,2,DType> &src, const Tensor<Device,1,IType> &index ):src_(src), index_(index){
+                this->shape_ = Shape2( index.shape[0], src.shape[0] );
+            }
+        };
+
+        /*!
+         * \brief scatter rows of a matrix by index, the result has src[i] added to row index[i], other rows are zero,
+         *        rows with the same index are summed, so this is the gradient of take
+         * \tparam Device which device it lies
+         * \tparam DType element type of the source
+         * \tparam IType element type of the index
+         */
+        template<typename Device, typename DType, typename IType>
+        struct IndexAddExp: public Exp< IndexAddExp<Device,DType,IType>, type::kComplex >{
+            /*! \brief row index of each row of source */
+            const Tensor<Device,1,IType> index_;
+            /*! \brief source operand */
+            const Tensor<Device,2,DType> src_;
+            /*! \brief scale of source */
+            typename DataType<DType>::ComputeType scale_;
+            /*! \brief constructor */
+            IndexAddExp( const Tensor<Device,1,IType> &index, const Tensor<Device,2,DType> &src, typename DataType<DType>::ComputeType scale )
+                :index_(index), src_(src), scale_(scale){}
+        };
     }; // namespace expr
 
 
@@ -332,12 +377,12 @@ namespace mshadow{
     namespace expr{
         /*! \brief operator overload */
         template<typename E, typename R,int d>
-        inline ReduceTo1DExp<E,R,d> operator*( const ReduceTo1DExp<E,R,d> &e, real_t scale ){
+        inline ReduceTo1DExp<E,R,d> operator*( const ReduceTo1DExp<E,R,d> &e, typename ExpInfo<E>::DType scale ){
             return ReduceTo1DExp<E,R,d>( e.src_, e.scale_*scale );
         }
         /*! \brief operator overload */
         template<typename E, typename R,int d>
-        inline ReduceTo1DExp<E,R,d> operator*( real_t scale, const ReduceTo1DExp<E,R,d> &e ){
+        inline ReduceTo1DExp<E,R,d> operator*( typename ExpInfo<E>::DType scale, const ReduceTo1DExp<E,R,d> &e ){
             return ReduceTo1DExp<E,R,d>( e.src_, e.scale_*scale );
         }
 
@@ -350,11 +395,11 @@ namespace mshadow{
          * \tparam Device which device it lies
          * \tparam dimdst dimension of destination tensor
          */
-        template<int dimcast,typename Device,int dimdst>
-        inline Broadcast1DExp<Device,dimdst,dimcast> broadcast( const Tensor<Device,1> &src, Shape<dimdst> shape ){
+        template<int dimcast,typename Device,int dimdst,typename DType>
+        inline Broadcast1DExp<Device,dimdst,dimcast,DType> broadcast( const Tensor<Device,1,DType> &src, Shape<dimdst> shape ){
             TypeCheckPass< dimcast<dimdst >::Error_Expression_Does_Not_Meet_Dimension_Req();
             utils::Assert( src.shape[0] == shape[dimcast], "broadcast, shape mismatch" );
-            return Broadcast1DExp<Device,dimdst,dimcast>( src, shape );
+            return Broadcast1DExp<Device,dimdst,dimcast,DType>( src, shape );
         }
 
         /*!
@@ -388,10 +433,10 @@ namespace mshadow{
          * \param pstride stride of each patch
          * \tparam Device the Device where input data lies
          */
-        template<typename Device, int dstdim>
-        inline PackColToPatchXExp<Device,dstdim> pack_col2patch( const Tensor<Device,2> &mat, Shape<dstdim> imshape, index_t psize, index_t pstride ){
+        template<typename Device, int dstdim, typename DType>
+        inline PackColToPatchXExp<Device,dstdim,DType> pack_col2patch( const Tensor<Device,2,DType> &mat, Shape<dstdim> imshape, index_t psize, index_t pstride ){
             utils::Assert( imshape[0] >= psize && imshape[1] >= psize, "PackColToPatch:image shape smaller than patch size");
-            return PackColToPatchXExp<Device,dstdim>( mat, imshape, psize, pstride );
+            return PackColToPatchXExp<Device,dstdim,DType>( mat, imshape, psize, pstride );
         }
         /*!
          * \brief a expression that reshapes a tensor to another shape
@@ -478,10 +523,10 @@ namespace mshadow{
          * \tparam Reducer reducer type
          * \tparam Device device where data lies
          */
-         template<typename Reducer, typename Device>
-         inline UnPoolingExp<Reducer, Device> unpool( const Tensor<Device,4>&data_src, const Tensor<Device,4> &data_pooled,
-                                                      const Tensor<Device,4> &grad_pooled, index_t ksize, index_t kstride ) {
-             return UnPoolingExp<Reducer, Device>(data_src, data_pooled, grad_pooled,ksize, kstride);
+         template<typename Reducer, typename Device, typename DType>
+         inline UnPoolingExp<Reducer, Device, DType> unpool( const Tensor<Device,4,DType>&data_src, const Tensor<Device,4,DType> &data_pooled,
+                                                             const Tensor<Device,4,DType> &grad_pooled, index_t ksize, index_t kstride ) {
+             return UnPoolingExp<Reducer, Device, DType>(data_src, data_pooled, grad_pooled,ksize, kstride);
          }
 
         /*!
@@ -554,6 +599,57 @@ namespace mshadow{
             TypeCheckPass< ExpInfo<SrcExp>::kDim >= 3 >::Error_Expression_Does_Not_Meet_Dimension_Req();
             return ChannelPoolingExp<Reducer,SrcExp, ExpInfo<SrcExp>::kDim >(src.self(),nsize);
         }
+
+        /*!
+         * \brief gather rows of src by index, e.g. embedding lookup
+         * \param src source matrix, shape[1] rows
+         * \param index row index in src, one for each row of result
+         * \return expression of shape ( index.shape[0], src.shape[0] )
+         * \tparam Device which device it lies
+         */
+        template<typename Device, typename DType, typename IType>
+        inline TakeExp<Device,DType,IType> take( const Tensor<Device,2,DType> &src, const Tensor<Device,1,IType> &index ){
+            return TakeExp<Device,DType,IType>( src, index );
+        }
+        /*! 
+         * \brief whether a row index is in [0,nrow), checked before the index is cast to index_t, 
+         *        so negative, NaN and too large real_t labels are rejected
+         */
+        template<typename IType>
+        inline bool IndexInRange( IType idx, index_t nrow ){
+            return idx >= 0 && static_cast<double>( idx ) < static_cast<double>( nrow );
+        }
+        /*! \brief cpu version of take, index is checked against the number of rows of src */
+        template<typename DType, typename IType>
+        inline TakeExp<cpu,DType,IType> take( const Tensor<cpu,2,DType> &src, const Tensor<cpu,1,IType> &index ){
+            for( index_t i = 0; i < index.shape[0]; ++ i ){
+                utils::Assert( IndexInRange( index[i], src.shape[1] ), "take: index exceed bound" );
+            }
+            return TakeExp<cpu,DType,IType>( src, index );
+        }
+        /*!
+         * \brief scatter rows of src to rows of destination by index, dst += index_add( index, src ) adds src[i] to dst[ index[i] ],
+         *        e.g. gradient of embedding lookup, only the rows in index are touched by += and -=
+         * \param index row index in destination, one for each row of src
+         * \param src source matrix
+         * \return expression of the same shape as destination
+         * \tparam Device which device it lies
+         */
+        template<typename Device, typename DType, typename IType>
+        inline IndexAddExp<Device,DType,IType> index_add( const Tensor<Device,1,IType> &index, const Tensor<Device,2,DType> &src ){
+            utils::Assert( index.shape[0] == src.shape[1], "index_add: number of index must be number of rows of src" );
+            return IndexAddExp<Device,DType,IType>( index, src, 1.0f );
+        }
+        /*! \brief operator overload */
+        template<typename Device, typename DType, typename IType>
+        inline IndexAddExp<Device,DType,IType> operator*( const IndexAddExp<Device,DType,IType> &e, typename DataType<DType>::ComputeType scale ){
+            return IndexAddExp<Device,DType,IType>( e.index_, e.src_, e.scale_ * scale );
+        }
+        /*! \brief operator overload */
+        template<typename Device, typename DType, typename IType>
+        inline IndexAddExp<Device,DType,IType> operator*( typename DataType<DType>::ComputeType scale, const IndexAddExp<Device,DType,IType> &e ){
+            return IndexAddExp<Device,DType,IType>( e.index_, e.src_, e.scale_ * scale );
+        }
         // short cut functions
         /*!
          * \brief a expression that replicate a 1 dimension tensor for nrow times
@@ -562,8 +658,8 @@ namespace mshadow{
          * \return a expresion with type Tensor<Device,2> shape[0], shape[1] = nrow
          * \tparam Device which device it lies
          */
-        template<typename Device>
-        inline Broadcast1DExp<Device,2,0> repmat( const Tensor<Device,1> &src, index_t nrow ){
+        template<typename Device, typename DType>
+        inline Broadcast1DExp<Device,2,0,DType> repmat( const Tensor<Device,1,DType> &src, index_t nrow ){
             return broadcast<0>( src, Shape2( nrow, src.shape[0] ) );
         }
         /*!
@@ -587,51 +683,119 @@ namespace mshadow{
 // --------------------------------------------------
 namespace mshadow{
     namespace expr{
-        template<typename SV, typename Device, typename EType, typename Reducer, int dimkeep>
-        struct ExpComplexEngine< SV, Device, 1, ReduceTo1DExp<EType,Reducer,dimkeep> >{
-            inline static void Eval( Tensor<Device,1> &dst, const ReduceTo1DExp<EType,Reducer,dimkeep> &exp ){
+        template<typename SV, typename Device, typename DType, typename EType, typename Reducer, int dimkeep>
+        struct ExpComplexEngine< SV, Device, 1, DType, ReduceTo1DExp<EType,Reducer,dimkeep> >{
+            inline static void Eval( Tensor<Device,1,DType> &dst, const ReduceTo1DExp<EType,Reducer,dimkeep> &exp ){
                 TypeCheckPass< dimkeep!=0 >::Error_Expression_Does_Not_Meet_Dimension_Req();
                 MapReduceKeepHighDim<SV,Reducer,dimkeep>( dst, exp.src_, exp.scale_ );
             }
         };
 
-        template<typename SV, typename Device, typename EType, typename Reducer>
-        struct ExpComplexEngine< SV, Device, 1, ReduceTo1DExp<EType,Reducer,0> >{
-            inline static void Eval( Tensor<Device,1> &dst, const ReduceTo1DExp<EType,Reducer,0> &exp ){
+        template<typename SV, typename Device, typename DType, typename EType, typename Reducer>
+        struct ExpComplexEngine< SV, Device, 1, DType, ReduceTo1DExp<EType,Reducer,0> >{
+            inline static void Eval( Tensor<Device,1,DType> &dst, const ReduceTo1DExp<EType,Reducer,0> &exp ){
                 MapReduceKeepLowest<SV,Reducer>( dst, exp.src_, exp.scale_ );
             }
         };
+
+        /*!
+         * \brief cpu: rows of src are grouped by destination row, each group is added by one thread,
+         *        so rows of dst are updated in parallel without conflict, and only rows in index are touched
+         */
+        template<typename SV, typename DType, typename IType>
+        struct ExpComplexEngine< SV, cpu, 2, DType, IndexAddExp<cpu,DType,IType> >{
+            inline static void Eval( Tensor<cpu,2,DType> &dst, const IndexAddExp<cpu,DType,IType> &exp ){
+                utils::Assert( dst.shape[0] == exp.src_.shape[0], "index_add: shape mismatch" );
+                if( SV::kBetaBLAS == 0.0f ) dst = 0.0f;
+                // ( destination row, source row ) sorted, rows of the same destination are contiguous
+                std::vector< std::pair<index_t,index_t> > order( exp.index_.shape[0] );
+                for( index_t i = 0; i < order.size(); ++ i ){
+                    utils::Assert( IndexInRange( exp.index_[i], dst.shape[1] ), "index_add: index exceed bound" );
+                    order[i].first = static_cast<index_t>( exp.index_[i] );
+                    order[i].second = i;
+                }
+                std::sort( order.begin(), order.end() );
+                std::vector<index_t> group;
+                for( index_t i = 0; i < order.size(); ++ i ){
+                    if( i == 0 || order[i].first != order[i-1].first ) group.push_back( i );
+                }
+                group.push_back( static_cast<index_t>( order.size() ) );
+                const typename DataType<DType>::ComputeType scale = exp.scale_ * SV::kAlphaBLAS;
+                const long ngroup = static_cast<long>( group.size() ) - 1;
+                #pragma omp parallel for schedule(dynamic, 16) if( exp.src_.shape.Size() >= MSHADOW_PARALLEL_WORK_THRESHOLD )
+                for( long g = 0; g < ngroup; ++ g ){
+                    Tensor<cpu,1,DType> drow = dst[ order[ group[g] ].first ];
+                    for( index_t i = group[g]; i < group[g+1]; ++ i ){
+                        drow += scale * exp.src_[ order[i].second ];
+                    }
+                }
+            }
+        };
     }; // namespace expr
 
     namespace expr{
+        template<typename Device, typename DType, typename IType>
+        struct Plan< TakeExp<Device,DType,IType> >{
+        public:
+            Plan( const TakeExp<Device,DType,IType> &e )
+                :src_(e.src_), index_(e.index_.dptr){}
+            MSHADOW_XINLINE typename DataType<DType>::ComputeType Eval( index_t y, index_t x ) const{
+                return src_[ static_cast<index_t>( index_[y] ) ][ x ];
+            }
+        private:
+            Tensor<Device,2,DType> src_;
+            const IType *index_;
+        };
+    }; // namespace expr
+
+    /*! \brief cpu: dst = take( src, index ) copies whole rows by BatchGather, other savers evaluate the plan element-wise */
+    template<typename SV, typename DType, typename IType>
+    struct MapExpCPUEngine< false, SV, 2, DType, expr::MakeTensorExp< expr::TakeExp<cpu,DType,IType>, Tensor<cpu,2,DType>, 2 >, expr::type::kMapper >{
+        typedef expr::MakeTensorExp< expr::TakeExp<cpu,DType,IType>, Tensor<cpu,2,DType>, 2 > EType;
+        inline static void Map( Tensor<cpu,2,DType> dst, const expr::Exp<EType,expr::type::kMapper> &exp ){
+            using namespace expr;
+            if( !SameType<SV,sv::saveto>::kValue ){
+                MapPlan<SV>( dst, MakePlan( exp.self() ) ); return;
+            }
+            const TakeExp<cpu,DType,IType> &e = exp.self().real_self();
+            std::vector<index_t> index( e.index_.shape[0] );
+            for( index_t i = 0; i < index.size(); ++ i ){
+                index[i] = static_cast<index_t>( e.index_[i] );
+            }
+            if( index.size() != 0 ) BatchGather( dst, e.src_, &index[0] );
+        }
+    };
+
+    namespace expr{
+
         /*! \brief execution plan of Broadcast1DExp */
-        template<typename Device, int dimdst, int dimcast>
-        struct Plan< Broadcast1DExp<Device,dimdst,dimcast> >{
+        template<typename Device, int dimdst, int dimcast, typename DType>
+        struct Plan< Broadcast1DExp<Device,dimdst,dimcast,DType> >{
         public:
-            Plan( const Broadcast1DExp<Device,dimdst,dimcast> &e )
+            Plan( const Broadcast1DExp<Device,dimdst,dimcast,DType> &e )
                 : dptr_( e.src_.dptr ), 
                   ystride_( e.shape_.ProdShape(1,dimcast) ),
                   length_(e.shape_[dimcast]){
                 TypeCheckPass< dimcast!=0 >::Error_Expression_Does_Not_Meet_Dimension_Req();
             }
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                 return dptr_[ (y / ystride_) % length_ ];
             }
         private:
-            const real_t  *dptr_;
+            const DType  *dptr_;
             const index_t  ystride_, length_;
         };
 
         /*! \brief execution plan of Broadcast1DExp */
-        template<typename Device, int dimdst>
-        struct Plan< Broadcast1DExp<Device,dimdst,0> >{
+        template<typename Device, int dimdst, typename DType>
+        struct Plan< Broadcast1DExp<Device,dimdst,0,DType> >{
         public:
-            Plan( const Broadcast1DExp<Device,dimdst,0> &e ): dptr_( e.src_.dptr ){}
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            Plan( const Broadcast1DExp<Device,dimdst,0,DType> &e ): dptr_( e.src_.dptr ){}
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                 return dptr_[ x ];
             }
         private:
-            const real_t *dptr_;
+            const DType *dptr_;
         };
     }; // namespace expr
 
@@ -639,13 +803,14 @@ namespace mshadow{
         template<typename SrcExp, int srcdim>
         struct Plan< UnpackPatchToColXExp<SrcExp,srcdim> >{
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan( const UnpackPatchToColXExp<SrcExp,srcdim> &e )
                 :src_(MakePlan(e.img_)),psize_(e.psize_), pstride_(e.pstride_),
                  i_channel_(e.i_channel_), i_height_(e.i_height_), i_width_(e.i_width_),                 
                  o_height_(( i_height_  - psize_ ) / pstride_ + 1),
                  o_width_ (( i_width_   - psize_ ) / pstride_ + 1){
             }
-            MSHADOW_XINLINE real_t Eval( index_t i, index_t j ) const{
+            MSHADOW_XINLINE DType Eval( index_t i, index_t j ) const{
                 const index_t x_offset = i % psize_;
                 const index_t idivp    = i / psize_;
                 const index_t y_offset = idivp % psize_;
@@ -658,7 +823,7 @@ namespace mshadow{
                 if( x < i_width_ && y < i_height_ ){
                     return src_.Eval( ( n * i_channel_  + c ) * i_height_ + y, x );
                 }else{
-                    return 0.0f;
+                    return DType(0);
                 }
             }
         private:
@@ -666,17 +831,17 @@ namespace mshadow{
             const index_t psize_, pstride_, i_channel_, i_height_, i_width_, o_height_, o_width_;
         };
 
-        template<typename Device, int dstdim>
-        struct Plan< PackColToPatchXExp<Device, dstdim> >{
+        template<typename Device, int dstdim, typename DType>
+        struct Plan< PackColToPatchXExp<Device, dstdim, DType> >{
         public:
-            Plan( const PackColToPatchXExp<Device, dstdim> &e )
+            Plan( const PackColToPatchXExp<Device, dstdim, DType> &e )
                 :mat_(e.mat_), psize_(e.psize_), pstride_(e.pstride_),
                  i_channel_(e.shape_[2]), i_height_(e.shape_[1]),
                  o_width_(( e.shape_[0]  - psize_ ) / pstride_ + 1),
                  o_height_(( e.shape_[1]  - psize_ ) / pstride_ + 1){
                 // note: i/o convention are same as unpack
             }
-            MSHADOW_XINLINE real_t Eval( index_t i, index_t j ) const{
+            MSHADOW_XINLINE DType Eval( index_t i, index_t j ) const{
                 using namespace std;
                 const index_t y = i % i_height_;
                 const index_t idivh = i / i_height_;                
@@ -687,7 +852,7 @@ namespace mshadow{
                 const index_t px_min = x < psize_ ? 0 : (x-psize_+pstride_)/pstride_;
                 const index_t py_max = min( (y+pstride_)/pstride_, o_height_);
                 const index_t px_max = min( (x+pstride_)/pstride_, o_width_ );
-                real_t res = 0.0f;
+                DType res = 0;
                 for( index_t py = py_min; py < py_max; ++py ){
                     for( index_t px = px_min; px < px_max; ++px ){
                         res += mat_[ (c * psize_ + y - py*pstride_) * psize_ + x - px*pstride_ ][ (n * o_height_ + py) * o_width_+px ];
@@ -696,7 +861,7 @@ namespace mshadow{
                 return res;
             }
         private:
-            Tensor<Device,2> mat_;
+            Tensor<Device,2,DType> mat_;
             const index_t psize_, pstride_, i_channel_, i_height_, o_width_, o_height_;
         };
     };
@@ -705,10 +870,11 @@ namespace mshadow{
         template<typename SrcExp, int dimdst, int dimsrc>
         struct Plan< ReshapeExp<SrcExp,dimdst,dimsrc> >{
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan( const ReshapeExp<SrcExp,dimdst,dimsrc> &e )
                 : src_(MakePlan(e.src_)), oshape0_(e.shape_[0]), ishape0_(e.ishape0_){
             }
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                 const index_t idx = y * oshape0_ + x;
                 return src_.Eval( idx / ishape0_, idx % ishape0_ );
             }
@@ -720,10 +886,11 @@ namespace mshadow{
         template<typename SrcExp,int dimdst>
         struct Plan< ReshapeExp<SrcExp,dimdst,1> >{
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan( const ReshapeExp<SrcExp,dimdst,1> &e )
                 : src_(MakePlan(e.src_)), oshape0_(e.shape_[0]){
             }
-            MSHADOW_XINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t y, index_t x ) const{
                 return src_.Eval( 0, y * oshape0_ + x );
             }
         private:
@@ -736,6 +903,7 @@ namespace mshadow{
         template<typename SrcExp,int dimsrc, int a1, int a2>
         struct Plan< SwapAxisExp<SrcExp,dimsrc,a1,a2> >{
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan( const SwapAxisExp<SrcExp,dimsrc,a1,a2> &e )
                 : src_(MakePlan(e.src_)),
                   shape1_( e.shape_.ProdShape( 1, a1 ) ),
@@ -743,7 +911,7 @@ namespace mshadow{
                   shape3_( e.shape_.ProdShape( a1+1, a2 ) ),
                   shape4_( e.shape_[a2] ){
             }
-            MSHADOW_XINLINE real_t Eval( index_t i, index_t j ) const{
+            MSHADOW_XINLINE DType Eval( index_t i, index_t j ) const{
                 const index_t y = i % shape1_;
                 i /= shape1_; 
                 const index_t z = i % shape2_;
@@ -762,13 +930,14 @@ namespace mshadow{
         template<typename SrcExp,int dimsrc, int a2>
         struct Plan< SwapAxisExp<SrcExp,dimsrc,0,a2> >{
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan( const SwapAxisExp<SrcExp,dimsrc,0,a2> &e )
                 : src_(MakePlan(e.src_)),
                   shape0_( e.shape_[0] ),
                   shape1_( e.shape_.ProdShape(1,a2) ),
                   shape2_( e.shape_[a2] ){
             }
-            MSHADOW_XINLINE real_t Eval( index_t i, index_t x ) const{
+            MSHADOW_XINLINE DType Eval( index_t i, index_t x ) const{
                 // swap x and z
                 const index_t y = i % shape1_;
                 i /= shape1_; 
@@ -786,11 +955,12 @@ namespace mshadow{
         template<typename Reducer, typename SrcExp, int srcdim>
         struct Plan< PoolingExp< Reducer, SrcExp, srcdim> > {
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan( const PoolingExp<Reducer, SrcExp, srcdim> &e )
                 : src_( MakePlan( e.src_ ) ), ksize_(e.ksize_), kstride_(e.kstride_),
                   src_height_(e.src_height_),src_width_(e.src_width_), new_height_(e.shape_[1]) {
             }
-            MSHADOW_XINLINE real_t Eval(index_t i, index_t j) const {
+            MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
                 using namespace std;
                 const index_t py = i % new_height_;
                 const index_t y_start = py * kstride_;
@@ -800,7 +970,7 @@ namespace mshadow{
                 const index_t x_end = min( x_start + ksize_, src_width_ );
                 const index_t c = i / new_height_;
 
-                real_t res = Reducer::kInitV;
+                DType res; Reducer::SetInitValue( res );
                 for (index_t y = y_start; y < y_end; ++y) {
                     for (index_t x = x_start; x < x_end; ++x) {
                         Reducer::Reduce( res, src_.Eval( c*src_height_+y, x ) );
@@ -815,25 +985,25 @@ namespace mshadow{
             const index_t new_height_;
         };
 
-        template<typename Reducer, typename Device>
-        struct Plan<UnPoolingExp<Reducer, Device> > {
+        template<typename Reducer, typename Device, typename DType>
+        struct Plan<UnPoolingExp<Reducer, Device, DType> > {
         public:
-            Plan(const UnPoolingExp<Reducer, Device> &e)
+            Plan(const UnPoolingExp<Reducer, Device, DType> &e)
                 : data_src_(e.data_src_), data_pooled_(e.data_pooled_), grad_pooled_(e.grad_pooled_),
                   ksize_(e.ksize_), kstride_(e.kstride_) {}
-            MSHADOW_XINLINE real_t Eval(index_t i, index_t j) const {
+            MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
                 using namespace std;
                 const index_t x = j;
                 const index_t y = i % data_src_.shape[1];
                 const index_t c = i / data_src_.shape[1];
-                const real_t vsrc = data_src_[0][c][y][x];
+                const DType vsrc = data_src_[0][c][y][x];
 
                 const index_t py_min = y < ksize_ ? 0 : (y-ksize_+kstride_)/kstride_;
                 const index_t px_min = x < ksize_ ? 0 : (x-ksize_+kstride_)/kstride_;
                 const index_t py_max = min( (y+kstride_)/kstride_, data_pooled_.shape[1]);
                 const index_t px_max = min( (x+kstride_)/kstride_, data_pooled_.shape[0]);
 
-                real_t val = 0;
+                DType val = 0;
                 for( index_t py = py_min; py < py_max; ++py ){
                     for( index_t px = px_min; px < px_max; ++px ){
                         val += Reducer::PartialGrad(vsrc, data_pooled_[0][c][py][px]) * grad_pooled_[0][c][py][px];
@@ -842,7 +1012,7 @@ namespace mshadow{
                 return val;
             }
         private:
-            Tensor<Device, 4> data_src_, data_pooled_, grad_pooled_;
+            Tensor<Device, 4, DType> data_src_, data_pooled_, grad_pooled_;
             const index_t ksize_;
             const index_t kstride_;
         };
@@ -852,20 +1022,21 @@ namespace mshadow{
         template<typename SrcExp, int srcdim>
         struct Plan< PaddingExp<SrcExp, srcdim> > {
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan(const PaddingExp<SrcExp, srcdim> &e)
                 : src_(MakePlan(e.src_)), pad_(e.pad_), new_height_(e.shape_[1]),
                   src_height_(e.src_height_), src_width_(e.src_width_) {}
-            MSHADOW_XINLINE real_t Eval(index_t i, index_t j) const {
+            MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
                 const index_t x = j;
                 const index_t y = i % new_height_;
                 const index_t c = i / new_height_;
-                if (y < pad_ || x < pad_) return 0.0f;
+                if (y < pad_ || x < pad_) return DType(0);
                 const index_t h = y - pad_;
                 const index_t w = x - pad_;
                 if (h < src_height_ && w < src_width_) {
                     return src_.Eval(c * src_height_ + h, w);
                 } else {
-                    return 0.0f;
+                    return DType(0);
                 }
             }
         private:
@@ -879,10 +1050,11 @@ namespace mshadow{
         template<typename SrcExp, int srcdim>
         struct Plan<CroppingExp<SrcExp, srcdim> > {
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan(const CroppingExp<SrcExp, srcdim> &e)
                 : src_(MakePlan(e.src_)), pad_height_(e.pad_height_),pad_width_(e.pad_width_), 
                   new_height_(e.shape_[1]), src_height_(e.src_height_) {}
-            MSHADOW_XINLINE real_t Eval(index_t i, index_t j) const {
+            MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
                 const index_t x = j;
                 const index_t y = i % new_height_;
                 const index_t c = i / new_height_;
@@ -900,9 +1072,10 @@ namespace mshadow{
         template<typename SrcExp, int srcdim>
         struct Plan< MirroringExp<SrcExp, srcdim> > {
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan(const MirroringExp<SrcExp, srcdim> &e)
                 : src_(MakePlan(e.src_)), width_(e.shape_[0]){}
-            MSHADOW_XINLINE real_t Eval(index_t i, index_t j) const {
+            MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
                 return src_.Eval( i, width_ - j - 1 );
             }
         private:
@@ -915,11 +1088,12 @@ namespace mshadow{
         template<typename Reducer, typename SrcExp, int srcdim>
         struct Plan< ChannelPoolingExp< Reducer, SrcExp, srcdim> > {
         public:
+            typedef typename ExpInfo<SrcExp>::DType DType;
             Plan( const ChannelPoolingExp<Reducer, SrcExp, srcdim> &e )
                 : src_( MakePlan( e.src_ ) ), channel_(e.shape_[2]),
                   height_(e.shape_[1]),width_(e.shape_[0]), hnsize_(e.nsize_/2){
             }
-            MSHADOW_XINLINE real_t Eval(index_t i, index_t j) const {
+            MSHADOW_XINLINE DType Eval(index_t i, index_t j) const {
                 using namespace std;
                 const index_t y = i % height_;
                 i /= height_;
@@ -928,7 +1102,7 @@ namespace mshadow{
                 const index_t x = j;
                 const index_t cstart = c < hnsize_ ? 0  : c - hnsize_;
                 const index_t cend   = min( c + hnsize_ + 1, channel_ );
-                real_t res = Reducer::kInitV;
+                DType res; Reducer::SetInitValue( res );
                 for( index_t cc = cstart; cc < cend; ++ cc ){
                     Reducer::Reduce( res, src_.Eval( (n*channel_+cc)*height_ + y, x ) );
                 }
@@ -946,29 +1120,29 @@ namespace mshadow{
 #include "tensor_sse-inl.hpp"
 namespace mshadow{
     namespace expr{
-        template<int dimdst>
-        struct SSECheck< Broadcast1DExp<cpu,dimdst,0> >{
-            const static bool kPass = true;
+        template<int dimdst, typename DType>
+        struct SSECheck< Broadcast1DExp<cpu,dimdst,0,DType> >{
+            const static bool kPass = SSECheck< Tensor<cpu,1,DType> >::kPass;
         };
-        template<int dimdst>
-        struct SSEAlignCheck<2, Broadcast1DExp<cpu,dimdst,0> >{
-            inline static bool Check( const Broadcast1DExp<cpu,dimdst,0> &exp ){
+        template<int dimdst, typename DType>
+        struct SSEAlignCheck<2, Broadcast1DExp<cpu,dimdst,0,DType> >{
+            inline static bool Check( const Broadcast1DExp<cpu,dimdst,0,DType> &exp ){
                 return sse2::CheckAlign( exp.src_.dptr );
             }
         };
-        template<int dimdst>
-        class SSEPlan< Broadcast1DExp<cpu,dimdst,0> >{
+        template<int dimdst, typename DType>
+        class SSEPlan< Broadcast1DExp<cpu,dimdst,0,DType> >{
         public:
-            SSEPlan( const Broadcast1DExp<cpu,dimdst,0> &t )
+            SSEPlan( const Broadcast1DExp<cpu,dimdst,0,DType> &t )
                 :dptr_(t.src_.dptr){}
-            MSHADOW_CINLINE sse2::FVec<real_t> EvalSSE( index_t y, index_t x ) const{
-                return sse2::FVec<real_t>( &dptr_[ x ] );
+            MSHADOW_CINLINE sse2::FVec<DType> EvalSSE( index_t y, index_t x ) const{
+                return sse2::FVec<DType>( &dptr_[ x ] );
             }
-            MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_CINLINE DType Eval( index_t y, index_t x ) const{
                 return dptr_[ x ];
             }
         private:
-            const real_t  *dptr_;
+            const DType  *dptr_;
         };
     };
 };
@@ -46,49 +46,58 @@ namespace mshadow {
         cublasShutdown();
     }
 
-    template<int dim>
-    inline void AllocSpace(Tensor<gpu,dim> &obj, bool pad){
+    template<int dim, typename DType>
+    inline void AllocSpace(Tensor<gpu,dim,DType> &obj, bool pad){
         size_t pitch;
         // common choice for cuda mem align unit is 32
         if( pad && obj.shape[0] >= MSHADOW_MIN_PAD_RATIO * 32 ){
             cudaError_t err = cudaMallocPitch( (void**)&obj.dptr, &pitch, \
-                                               obj.shape[0] * sizeof(real_t), obj.FlatTo2D().shape[1] );
+                                               obj.shape[0] * sizeof(DType), obj.FlatTo2D().shape[1] );
             utils::Assert( err == cudaSuccess, cudaGetErrorString(err) );
-            obj.shape.stride_ = static_cast<index_t>( pitch / sizeof(real_t) );
+            obj.shape.stride_ = static_cast<index_t>( pitch / sizeof(DType) );
         }else{
             obj.shape.stride_ = obj.shape[0];
             cudaError_t err = cudaMallocPitch( (void**)&obj.dptr, &pitch, \
-                                               obj.shape.Size() * sizeof(real_t), 1 );
+                                               obj.shape.Size() * sizeof(DType), 1 );
             utils::Assert( err == cudaSuccess, cudaGetErrorString(err) );
         }
     }
 
-    template<int dim>
-    inline void FreeSpace(Tensor<gpu,dim> &obj){
+    template<int dim, typename DType>
+    inline void AllocZeroSpace(Tensor<gpu,dim,DType> &obj, bool pad){
+        AllocSpace( obj, pad );
+        Tensor<gpu,2,DType> mat = obj.FlatTo2D();
+        cudaError_t err = cudaMemset2D( mat.dptr, mat.shape.stride_ * sizeof(DType), 0,
+                                        mat.shape[0] * sizeof(DType), mat.shape[1] );
+        utils::Assert( err == cudaSuccess, cudaGetErrorString(err) );
+    }
+
+    template<int dim, typename DType>
+    inline void FreeSpace(Tensor<gpu,dim,DType> &obj){
         cudaFree( obj.dptr ); obj.dptr = NULL;
     }
 
-    template<typename A,typename B, int dim>
-    inline void Copy(Tensor<A,dim> _dst, Tensor<B,dim> _src, cudaMemcpyKind kind){
+    template<typename A,typename B, int dim, typename DType>
+    inline void Copy(Tensor<A,dim,DType> _dst, Tensor<B,dim,DType> _src, cudaMemcpyKind kind){
         utils::Assert( _dst.shape == _src.shape, "Copy:shape mismatch" );
-        Tensor<A,2> dst = _dst.FlatTo2D();
-        Tensor<B,2> src = _src.FlatTo2D();
-        cudaError_t err = cudaMemcpy2D( dst.dptr, dst.shape.stride_ * sizeof(real_t),
-                                        src.dptr, src.shape.stride_ * sizeof(real_t),
-                                        dst.shape[0] * sizeof(real_t),
+        Tensor<A,2,DType> dst = _dst.FlatTo2D();
+        Tensor<B,2,DType> src = _src.FlatTo2D();
+        cudaError_t err = cudaMemcpy2D( dst.dptr, dst.shape.stride_ * sizeof(DType),
+                                        src.dptr, src.shape.stride_ * sizeof(DType),
+                                        dst.shape[0] * sizeof(DType),
                                         dst.shape[1], kind );
         utils::Assert( err == cudaSuccess, cudaGetErrorString(err) );
     }
-    template<int dim>
-    inline void Copy(Tensor<cpu,dim> dst, const Tensor<gpu,dim> &src){
+    template<int dim, typename DType>
+    inline void Copy(Tensor<cpu,dim,DType> dst, const Tensor<gpu,dim,DType> &src){
         Copy( dst, src, cudaMemcpyDeviceToHost );
     }
-    template<int dim>
-    inline void Copy(Tensor<gpu,dim> dst, const Tensor<gpu,dim> &src){
+    template<int dim, typename DType>
+    inline void Copy(Tensor<gpu,dim,DType> dst, const Tensor<gpu,dim,DType> &src){
         Copy( dst, src, cudaMemcpyDeviceToDevice );
     }
-    template<int dim>
-    inline void Copy(Tensor<gpu,dim> dst, const Tensor<cpu,dim> &src){
+    template<int dim, typename DType>
+    inline void Copy(Tensor<gpu,dim,DType> dst, const Tensor<cpu,dim,DType> &src){
         Copy( dst, src, cudaMemcpyHostToDevice );
     }
 };
@@ -98,24 +107,24 @@ namespace mshadow {
 #include "cuda/tensor_gpu-inl.cuh"
 
 namespace mshadow{
-    template<typename Saver, typename E, int dim>
-    inline void MapPlan(Tensor<gpu,dim> _dst, const expr::Plan<E> &plan){
+    template<typename Saver, typename E, int dim, typename DType>
+    inline void MapPlan(Tensor<gpu,dim,DType> _dst, const expr::Plan<E> &plan){
         cuda::MapPlan<Saver>( _dst.FlatTo2D(), plan );
     }
 
-    template<typename Saver, int dim, typename E, int etype>
-    inline void MapExp(Tensor<gpu,dim> dst, const expr::Exp<E,etype> &exp ){
+    template<typename Saver, int dim, typename E, int etype, typename DType>
+    inline void MapExp(Tensor<gpu,dim,DType> dst, const expr::Exp<E,etype> &exp ){
         using namespace expr;
-        TypeCheckPass< TypeCheck<gpu,dim,E>::kMapPass >::Error_All_Tensor_in_Exp_Must_Have_Same_Type();
+        TypeCheckPass< TypeCheck<gpu,dim,DType,E>::kMapPass >::Error_All_Tensor_in_Exp_Must_Have_Same_Type();
         Shape<dim> eshape = ShapeCheck<dim,E>::Check( exp.self() );
         utils::Assert( eshape[0] == 0 || eshape == dst.shape, "Assignment: Shape of Tensors in expression is not consistent with target" );
         MapPlan<Saver>( dst, MakePlan( exp.self() ) );
     }
 
-    template<typename Saver, typename Reducer, typename E, int etype>
-    inline void MapReduceKeepLowest( Tensor<gpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale ){
+    template<typename Saver, typename Reducer, typename E, int etype, typename DType>
+    inline void MapReduceKeepLowest( Tensor<gpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale ){
         using namespace expr;
-        TypeCheckPass< TypeCheck<gpu,1,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
+        TypeCheckPass< TypeCheck<gpu,1,DType,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
         Shape<2> eshape = ShapeCheck< ExpInfo<E>::kDim, E >::Check( exp.self() ).FlatTo2D();
 
         utils::Assert( eshape[0] == dst.shape[0], "reduction dimension do not match" );
@@ -123,10 +132,10 @@ namespace mshadow{
         cuda::MapReduceKeepLowest<Saver,Reducer>( dst, MakePlan( exp.self() ), scale, eshape );
     }
 
-    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype>
-    inline void MapReduceKeepHighDim( Tensor<gpu,1> dst, const expr::Exp<E,etype> &exp, real_t scale ){
+    template<typename Saver, typename Reducer, int dimkeep, typename E, int etype, typename DType>
+    inline void MapReduceKeepHighDim( Tensor<gpu,1,DType> dst, const expr::Exp<E,etype> &exp, typename DataType<DType>::ComputeType scale ){
         using namespace expr;
-        TypeCheckPass< TypeCheck<gpu,dimkeep,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
+        TypeCheckPass< TypeCheck<gpu,dimkeep,DType,E>::kRedPass >::Error_TypeCheck_Not_Pass_For_Reduce_Exp();
         typedef Shape< ExpInfo<E>::kDim > EShape;
         EShape eshape = ShapeCheck< ExpInfo<E>::kDim, E >::Check( exp.self() );
         utils::Assert( eshape[dimkeep] == dst.shape[0], "reduction dimension do not match" );
@@ -0,0 +1,265 @@
+#ifndef MSHADOW_TENSOR_HALF_H
+#define MSHADOW_TENSOR_HALF_H
+/*!
+ * \file tensor_half.h
+ * \brief 16 bit storage types of cpu tensor: bf16_t (bfloat16) and half_t (IEEE half precision),
+ *        elements are converted to float when they are loaded in expression, and rounded once when the result is stored,
+ *        so Tensor<cpu,dim,bf16_t> takes half of the memory and bandwidth of Tensor<cpu,dim,float> while arithmetic stays in float,
+ *        conversion uses F16C instructions when MSHADOW_USE_F16C is on, and SSE2 bit tricks otherwise
+ *
+ *  usage:
+ *    Tensor<cpu,2,bf16_t> wmat = NewTensor<cpu,bf16_t>( Shape2( nhidden, ninput ), 0.0f );
+ *    wmat = tcast<bf16_t>( wfloat );      // convert from Tensor<cpu,2,float>
+ *    wmat -= eta * grad;                  // grad is Tensor<cpu,2,float>
+ *    out = dot( data, wmat.T() );         // out is Tensor<cpu,2,float>, accumulated in float
+ */
+#include <algorithm>
+#include <stdint.h>
+#include "tensor.h"
+#include "tensor_codec.h"
+#if MSHADOW_USE_SSE && MSHADOW_USE_F16C
+#include <immintrin.h>
+#endif
+
+namespace mshadow{
+    /*! \brief bfloat16, upper 16 bits of float, storage only, arithmetic is done in float */
+    struct bf16_t{
+        /*! \brief bits of the value */
+        uint16_t bits_;
+        /*! \brief default constructor, value is not initialized */
+        bf16_t( void ){}
+        /*! \brief convert from float, round to nearest even */
+        bf16_t( float v ):bits_( codec::FloatToBF16( v ) ){}
+        /*! \brief convert to float */
+        inline operator float( void ) const{
+            return codec::BF16ToFloat( bits_ );
+        }
+        // compute in float, round once
+        inline bf16_t &operator+=( float v ){ return *this = bf16_t( static_cast<float>( *this ) + v ); }
+        inline bf16_t &operator-=( float v ){ return *this = bf16_t( static_cast<float>( *this ) - v ); }
+        inline bf16_t &operator*=( float v ){ return *this = bf16_t( static_cast<float>( *this ) * v ); }
+        inline bf16_t &operator/=( float v ){ return *this = bf16_t( static_cast<float>( *this ) / v ); }
+    };
+    /*! \brief IEEE half precision float, storage only, arithmetic is done in float */
+    struct half_t{
+        /*! \brief bits of the value */
+        uint16_t bits_;
+        /*! \brief default constructor, value is not initialized */
+        half_t( void ){}
+        /*! \brief convert from float, round to nearest even, overflow becomes infinity */
+        half_t( float v ):bits_( codec::FloatToHalf( v ) ){}
+        /*! \brief convert to float */
+        inline operator float( void ) const{
+            return codec::HalfToFloat( bits_ );
+        }
+        // compute in float, round once
+        inline half_t &operator+=( float v ){ return *this = half_t( static_cast<float>( *this ) + v ); }
+        inline half_t &operator-=( float v ){ return *this = half_t( static_cast<float>( *this ) - v ); }
+        inline half_t &operator*=( float v ){ return *this = half_t( static_cast<float>( *this ) * v ); }
+        inline half_t &operator/=( float v ){ return *this = half_t( static_cast<float>( *this ) / v ); }
+    };
+    /*! \brief bfloat16 tensor takes part in expression as float */
+    template<>
+    struct DataType<bf16_t>{
+        typedef float ComputeType;
+    };
+    /*! \brief half tensor takes part in expression as float */
+    template<>
+    struct DataType<half_t>{
+        typedef float ComputeType;
+    };
+
+    namespace codec{
+        /*! \brief decode n bfloat16 to float */
+        inline void DecodeHalf( float *dst, const bf16_t *src, size_t n ){
+            DecodeBF16( dst, reinterpret_cast<const uint16_t*>( src ), n );
+        }
+        /*! \brief decode n halfs to float */
+        inline void DecodeHalf( float *dst, const half_t *src, size_t n ){
+            DecodeFP16( dst, reinterpret_cast<const uint16_t*>( src ), n );
+        }
+    }; // namespace codec
+}; // namespace mshadow
+
+#if MSHADOW_USE_SSE
+namespace mshadow{
+    namespace sse2{
+        /*! \brief load 4 bfloat16 as float, src needs no alignment */
+        MSHADOW_CINLINE __m128 LoadHalf4( const bf16_t *src ){
+            __m128i h = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( src ) );
+            return _mm_castsi128_ps( _mm_unpacklo_epi16( _mm_setzero_si128(), h ) );
+        }
+        /*! \brief load 4 halfs as float, src needs no alignment */
+        MSHADOW_CINLINE __m128 LoadHalf4( const half_t *src ){
+            __m128i h = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( src ) );
+            #if MSHADOW_USE_F16C
+            return _mm_cvtph_ps( h );
+            #else
+            return codec::HalfToFloat4( _mm_unpacklo_epi16( h, _mm_setzero_si128() ) );
+            #endif
+        }
+        /*! \brief round 4 floats to bfloat16 and store, dst needs no alignment */
+        MSHADOW_CINLINE void StoreHalf4( bf16_t *dst, __m128 x ){
+            __m128i h = codec::FloatToBF16x4( x );
+            _mm_storel_epi64( reinterpret_cast<__m128i*>( dst ), codec::Pack16( h, h ) );
+        }
+        /*! \brief round 4 floats to half and store, dst needs no alignment */
+        MSHADOW_CINLINE void StoreHalf4( half_t *dst, __m128 x ){
+            #if MSHADOW_USE_F16C
+            _mm_storel_epi64( reinterpret_cast<__m128i*>( dst ), _mm_cvtps_ph( x, 0 ) );
+            #else
+            __m128i h = codec::FloatToHalf4( x );
+            _mm_storel_epi64( reinterpret_cast<__m128i*>( dst ), codec::Pack16( h, h ) );
+            #endif
+        }
+        // savers of 16 bit storage, old value is loaded as float, result is rounded when stored
+        template<typename SV>
+        struct Saver<SV,bf16_t>{
+            MSHADOW_CINLINE static void Save( bf16_t *dst, const FVec<float> &src ){
+                FVec<float> ans = SSEOp<typename SV::OPType>::Map( FVec<float>( LoadHalf4( dst ) ), src );
+                StoreHalf4( dst, ans.data_ );
+            }
+        };
+        template<>
+        struct Saver<sv::saveto,bf16_t>{
+            MSHADOW_CINLINE static void Save( bf16_t *dst, const FVec<float> &src ){
+                StoreHalf4( dst, src.data_ );
+            }
+        };
+        template<typename SV>
+        struct Saver<SV,half_t>{
+            MSHADOW_CINLINE static void Save( half_t *dst, const FVec<float> &src ){
+                FVec<float> ans = SSEOp<typename SV::OPType>::Map( FVec<float>( LoadHalf4( dst ) ), src );
+                StoreHalf4( dst, ans.data_ );
+            }
+        };
+        template<>
+        struct Saver<sv::saveto,half_t>{
+            MSHADOW_CINLINE static void Save( half_t *dst, const FVec<float> &src ){
+                StoreHalf4( dst, src.data_ );
+            }
+        };
+    }; // namespace sse2
+
+    namespace expr{
+        /*! \brief SSEPlan of 16 bit tensor, 4 elements are loaded and converted to float at a time */
+        template<int dim, typename THalf>
+        class HalfSSEPlan{
+        public:
+            HalfSSEPlan( const Tensor<cpu,dim,THalf> &t )
+                :dptr_(t.dptr),stride_(t.shape.stride_){}
+            MSHADOW_CINLINE sse2::FVec<float> EvalSSE( index_t y, index_t x ) const{
+                return sse2::FVec<float>( sse2::LoadHalf4( dptr_ + y * stride_ + x ) );
+            }
+            MSHADOW_CINLINE float Eval( index_t y, index_t x ) const{
+                return dptr_[ y * stride_ + x ];
+            }
+        private:
+            const THalf *dptr_;
+            index_t stride_;
+        };
+        template<int dim>
+        class SSEPlan< Tensor<cpu,dim,bf16_t> >: public HalfSSEPlan<dim,bf16_t>{
+        public:
+            SSEPlan( const Tensor<cpu,dim,bf16_t> &t ):HalfSSEPlan<dim,bf16_t>( t ){}
+        };
+        template<int dim>
+        class SSEPlan< Tensor<cpu,dim,half_t> >: public HalfSSEPlan<dim,half_t>{
+        public:
+            SSEPlan( const Tensor<cpu,dim,half_t> &t ):HalfSSEPlan<dim,half_t>( t ){}
+        };
+        template<int dim>
+        struct SSECheck< Tensor<cpu,dim,bf16_t> >{
+            const static bool kPass = true;
+        };
+        template<int dim>
+        struct SSECheck< Tensor<cpu,dim,half_t> >{
+            const static bool kPass = true;
+        };
+    }; // namespace expr
+}; // namespace mshadow
+#endif // MSHADOW_USE_SSE
+
+#if (MSHADOW_USE_CBLAS||MSHADOW_USE_MKL)
+namespace mshadow{
+    namespace expr{
+        /*! \brief number of elements in K dimension converted to float at a time in dot of 16 bit tensors */
+        const index_t kHalfDotBlock = 256;
+        /*!
+         * \brief get block [k,k+kb) in K dimension of a dot operand as float matrix, float operand is used in place
+         * \param src operand
+         * \param krow whether K is the row dimension (dimension 1) of src
+         * \param k start of block
+         * \param kb size of block
+         * \param buf buffer of converted block, not used for float operand
+         */
+        inline Tensor<cpu,2,float> HalfDotBlock( const Tensor<cpu,2,float> &src, bool krow, index_t k, index_t kb,
+                                                 TensorContainer<cpu,2,float> &buf ){
+            if( krow ) return src.Slice( k, k + kb );
+            Tensor<cpu,2,float> ret( src.dptr + k, Shape2( src.shape[1], kb ) );
+            ret.shape.stride_ = src.shape.stride_;
+            return ret;
+        }
+        template<typename THalf>
+        inline Tensor<cpu,2,float> HalfDotBlock( const Tensor<cpu,2,THalf> &src, bool krow, index_t k, index_t kb,
+                                                 TensorContainer<cpu,2,float> &buf ){
+            Tensor<cpu,2,THalf> blk( src.dptr + ( krow ? k * src.shape.stride_ : k ),
+                                     krow ? Shape2( kb, src.shape[0] ) : Shape2( src.shape[1], kb ) );
+            blk.shape.stride_ = src.shape.stride_;
+            buf.Resize( blk.shape );
+            const long nrow = static_cast<long>( blk.shape[1] );
+            #pragma omp parallel for schedule(static) if( blk.shape.Size() >= MSHADOW_PARALLEL_WORK_THRESHOLD )
+            for( long i = 0; i < nrow; ++ i ){
+                codec::DecodeHalf( buf[i].dptr, blk[i].dptr, blk.shape[0] );
+            }
+            return buf;
+        }
+        /*!
+         * \brief dst = dot( lhs[.T], rhs[.T] ) where lhs or rhs is 16 bit tensor,
+         *        K dimension is processed in blocks of kHalfDotBlock, 16 bit operands of each block are converted to float
+         *        and multiplied by sgemm, so products are accumulated in float
+         */
+        template<typename SV, bool ltrans, bool rtrans, typename LType, typename RType>
+        struct HalfDotEngine{
+            inline static void Eval( Tensor<cpu,2,float> &dst, const DotExp< Tensor<cpu,2,LType>, Tensor<cpu,2,RType>, ltrans, rtrans > &exp ){
+                const Tensor<cpu,2,LType> &lhs = exp.lhs_;
+                const Tensor<cpu,2,RType> &rhs = exp.rhs_;
+                Shape<2> sleft  = GetShape( lhs.shape, ltrans );
+                Shape<2> sright = GetShape( rhs.shape, rtrans );
+                utils::Assert( dst.shape[1] == sleft[1] && dst.shape[0] == sright[0] \
+                               && sleft[0] == sright[1] , "dot-gemm: matrix shape mismatch" );
+                TensorContainer<cpu,2,float> lbuf( false ), rbuf( false );
+                for( index_t k = 0; k < sleft[0]; k += kHalfDotBlock ){
+                    const index_t kb = std::min( kHalfDotBlock, sleft[0] - k );
+                    Tensor<cpu,2,float> lblk = HalfDotBlock( lhs, ltrans, k, kb, lbuf );
+                    Tensor<cpu,2,float> rblk = HalfDotBlock( rhs, !rtrans, k, kb, rbuf );
+                    // first block applies the saver, later blocks accumulate
+                    BLASEngine<cpu>::gemm
+                        ( rtrans, ltrans,
+                          rtrans ? rblk.shape[1] : rblk.shape[0],
+                          ltrans ? lblk.shape[0] : lblk.shape[1],
+                          kb,
+                          exp.scale_ * SV::kAlphaBLAS,
+                          rblk.dptr, rblk.shape.stride_,
+                          lblk.dptr, lblk.shape.stride_,
+                          k == 0 ? static_cast<float>( SV::kBetaBLAS ) : 1.0f,
+                          dst.dptr, dst.shape.stride_ );
+                }
+            }
+        };
+        // dot with at least one 16 bit operand
+        #define MSHADOW_HALF_DOT_ENGINE( LType, RType )                         \
+        template<typename SV, bool ltrans, bool rtrans>                         \
+        struct ExpComplexEngine< SV, cpu, 2, float, DotExp< Tensor<cpu,2,LType>, Tensor<cpu,2,RType>, ltrans, rtrans > > \
+            : public HalfDotEngine<SV,ltrans,rtrans,LType,RType>{};
+        MSHADOW_HALF_DOT_ENGINE( bf16_t, bf16_t )
+        MSHADOW_HALF_DOT_ENGINE( float, bf16_t )
+        MSHADOW_HALF_DOT_ENGINE( bf16_t, float )
+        MSHADOW_HALF_DOT_ENGINE( half_t, half_t )
+        MSHADOW_HALF_DOT_ENGINE( float, half_t )
+        MSHADOW_HALF_DOT_ENGINE( half_t, float )
+        #undef MSHADOW_HALF_DOT_ENGINE
+    }; // namespace expr
+}; // namespace mshadow
+#endif // MSHADOW_USE_CBLAS || MSHADOW_USE_MKL
+#endif // MSHADOW_TENSOR_HALF_H
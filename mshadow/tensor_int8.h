@@ -0,0 +1,435 @@
+#ifndef MSHADOW_TENSOR_INT8_H
+#define MSHADOW_TENSOR_INT8_H
+/*!
+ * \file tensor_int8.h
+ * \brief 8-bit quantized inference on cpu: quantize/dequantize expressions, int8 x int8 -> int32 dot, and calibration of scales
+ *
+ *  quantization is symmetric, a float x is stored as q = round( x / scale ) clipped to [-127,127],
+ *  the scale is per tensor, or per row of the quantized matrix, which is per output channel of a weight stored as ( nout, nin )
+ *
+ *  usage, fully connected layer out = dot( data, wmat.T() ), wmat is ( nout, nin ):
+ *    QuantScaleRows( wscale, wmat );                        // per channel scale of weight, once
+ *    qwmat = quantize( wmat, wscale );                      // Tensor<cpu,2,int8_t>, once
+ *    const float dscale = QuantScale( calib_data );         // per tensor scale of input, from calibration data
+ *    qdata = quantize( data, dscale );
+ *    acc = dot( qdata, qwmat.T() );                         // Tensor<cpu,2,int32_t>
+ *    out = dequantize( acc, wscale, dscale ) + repmat( bias, nbatch );
+ *  dot takes both operands with nin as the lowest dimension, other layouts are transposed to temp space at each call
+ */
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "tensor.h"
+#if MSHADOW_USE_SSE && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace mshadow{
+    /*! \brief namespace of helpers of 8-bit quantization */
+    namespace quant{
+        /*! \brief largest magnitude of quantized value, -128 is not used so that the range is symmetric */
+        const int kQMax = 127;
+        /*! \brief quantize x / scale, round to nearest, clip to [-kQMax,kQMax] */
+        MSHADOW_XINLINE int8_t Quantize( float v ){
+            // NaN is mapped to 0, converting it to integer is undefined
+            if( v != v ) return 0;
+            v = std::min( std::max( v, -static_cast<float>( kQMax ) ), static_cast<float>( kQMax ) );
+            return static_cast<int8_t>( v >= 0.0f ? v + 0.5f : v - 0.5f );
+        }
+        /*! \brief round to nearest int32, used to scale the int32 result of dot */
+        MSHADOW_XINLINE int32_t Round( double v ){
+            return static_cast<int32_t>( v >= 0.0 ? v + 0.5 : v - 0.5 );
+        }
+
+#if MSHADOW_USE_SSE && defined(__AVX2__) && ( ( defined(__AVX512VNNI__) && defined(__AVX512VL__) ) || defined(__AVXVNNI__) )
+        // VNNI multiplies unsigned by signed bytes, lhs is shifted by 128, and 128 * sum of rhs is subtracted from the result
+        #if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+        #define MSHADOW_INT8_DPBUSD( acc, a, b ) _mm256_dpbusd_epi32( acc, a, b )
+        #else
+        #define MSHADOW_INT8_DPBUSD( acc, a, b ) _mm256_dpbusd_avx_epi32( acc, a, b )
+        #endif
+        /*! \brief value added to lhs by DotTile */
+        const int32_t kShiftA = 128;
+#else
+        const int32_t kShiftA = 0;
+#endif
+
+#if MSHADOW_USE_SSE && defined(__AVX2__)
+        /*! \brief sum of int32 lanes */
+        inline int32_t HSum( __m256i v ){
+            __m128i s = _mm_add_epi32( _mm256_castsi256_si128( v ), _mm256_extracti128_si256( v, 1 ) );
+            s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+            s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+            return _mm_cvtsi128_si32( s );
+        }
+#elif MSHADOW_USE_SSE
+        /*! \brief sum of int32 lanes */
+        inline int32_t HSum( __m128i s ){
+            s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+            s = _mm_add_epi32( s, _mm_shuffle_epi32( s, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+            return _mm_cvtsi128_si32( s );
+        }
+        /*! \brief sign extend 16 bytes to two vectors of int16 */
+        inline void Widen( __m128i v, __m128i &lo, __m128i &hi ){
+            lo = _mm_srai_epi16( _mm_unpacklo_epi8( v, v ), 8 );
+            hi = _mm_srai_epi16( _mm_unpackhi_epi8( v, v ), 8 );
+        }
+#endif
+        /*! \brief rows of lhs and rhs in a tile of dst computed by DotTile */
+        const index_t kTileA = 2, kTileB = 4;
+        /*!
+         * \brief dot products of kTileA int8 vectors a with kTileB int8 vectors b, all of length n, accumulated in int32,
+         *        out[i][j] = sum( ( a[i] + kShiftA ) * b[j] ), products are exact: bytes are widened to int16 and added in pairs by pmaddwd,
+         *        or multiplied and added in fours by VNNI, each load of a and b is used kTileB and kTileA times
+         */
+        inline void DotTile( int32_t out[kTileA][kTileB], const int8_t *const a[kTileA], const int8_t *const b[kTileB], index_t n ){
+            index_t k = 0;
+            for( index_t i = 0; i < kTileA; ++ i ){
+                for( index_t j = 0; j < kTileB; ++ j ) out[i][j] = 0;
+            }
+#if MSHADOW_USE_SSE && defined(MSHADOW_INT8_DPBUSD)
+            const __m256i flip = _mm256_set1_epi8( -128 );
+            __m256i c[kTileA][kTileB], va[kTileA];
+            for( index_t i = 0; i < kTileA; ++ i ){
+                for( index_t j = 0; j < kTileB; ++ j ) c[i][j] = _mm256_setzero_si256();
+            }
+            for( ; k + 32 <= n; k += 32 ){
+                for( index_t i = 0; i < kTileA; ++ i ){
+                    va[i] = _mm256_xor_si256( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( a[i] + k ) ), flip );
+                }
+                for( index_t j = 0; j < kTileB; ++ j ){
+                    const __m256i vb = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( b[j] + k ) );
+                    for( index_t i = 0; i < kTileA; ++ i ) c[i][j] = MSHADOW_INT8_DPBUSD( c[i][j], va[i], vb );
+                }
+            }
+#elif MSHADOW_USE_SSE && defined(__AVX2__)
+            __m256i c[kTileA][kTileB], va[kTileA];
+            for( index_t i = 0; i < kTileA; ++ i ){
+                for( index_t j = 0; j < kTileB; ++ j ) c[i][j] = _mm256_setzero_si256();
+            }
+            for( ; k + 16 <= n; k += 16 ){
+                for( index_t i = 0; i < kTileA; ++ i ){
+                    va[i] = _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>( a[i] + k ) ) );
+                }
+                for( index_t j = 0; j < kTileB; ++ j ){
+                    const __m256i vb = _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>( b[j] + k ) ) );
+                    for( index_t i = 0; i < kTileA; ++ i ) c[i][j] = _mm256_add_epi32( c[i][j], _mm256_madd_epi16( va[i], vb ) );
+                }
+            }
+#elif MSHADOW_USE_SSE
+            __m128i c[kTileA][kTileB], alo[kTileA], ahi[kTileA];
+            for( index_t i = 0; i < kTileA; ++ i ){
+                for( index_t j = 0; j < kTileB; ++ j ) c[i][j] = _mm_setzero_si128();
+            }
+            for( ; k + 16 <= n; k += 16 ){
+                for( index_t i = 0; i < kTileA; ++ i ){
+                    Widen( _mm_loadu_si128( reinterpret_cast<const __m128i*>( a[i] + k ) ), alo[i], ahi[i] );
+                }
+                for( index_t j = 0; j < kTileB; ++ j ){
+                    __m128i blo, bhi;
+                    Widen( _mm_loadu_si128( reinterpret_cast<const __m128i*>( b[j] + k ) ), blo, bhi );
+                    for( index_t i = 0; i < kTileA; ++ i ){
+                        c[i][j] = _mm_add_epi32( c[i][j], _mm_add_epi32( _mm_madd_epi16( alo[i], blo ), _mm_madd_epi16( ahi[i], bhi ) ) );
+                    }
+                }
+            }
+#endif
+#if MSHADOW_USE_SSE
+            for( index_t i = 0; i < kTileA; ++ i ){
+                for( index_t j = 0; j < kTileB; ++ j ) out[i][j] = HSum( c[i][j] );
+            }
+#endif
+            for( ; k < n; ++ k ){
+                for( index_t i = 0; i < kTileA; ++ i ){
+                    const int32_t va = static_cast<int32_t>( a[i][k] ) + kShiftA;
+                    for( index_t j = 0; j < kTileB; ++ j ) out[i][j] += va * b[j][k];
+                }
+            }
+        }
+#ifdef MSHADOW_INT8_DPBUSD
+        #undef MSHADOW_INT8_DPBUSD
+#endif
+        /*!
+         * \brief transpose int8 matrix into buf
+         * \return transposed matrix, stored in buf
+         */
+        inline Tensor<cpu,2,int8_t> Transpose( const Tensor<cpu,2,int8_t> &src, TensorContainer<cpu,2,int8_t> &buf ){
+            const index_t kBlock = 64;
+            buf.Resize( Shape2( src.shape[0], src.shape[1] ) );
+            for( index_t y0 = 0; y0 < src.shape[1]; y0 += kBlock ){
+                for( index_t x0 = 0; x0 < src.shape[0]; x0 += kBlock ){
+                    const index_t yend = std::min( y0 + kBlock, src.shape[1] ), xend = std::min( x0 + kBlock, src.shape[0] );
+                    for( index_t x = x0; x < xend; ++ x ){
+                        for( index_t y = y0; y < yend; ++ y ) buf[x][y] = src[y][x];
+                    }
+                }
+            }
+            return buf;
+        }
+        /*!
+         * \brief dst = dot( lhs, rhs.T() ) * scale, saved by SV, K is the lowest dimension of both lhs and rhs,
+         *        dst is split into tiles of kTileA x kTileB elements, tiles sharing the same rows of rhs are consecutive
+         */
+        template<typename SV>
+        inline void Gemm( Tensor<cpu,2,int32_t> dst, const Tensor<cpu,2,int8_t> &lhs, const Tensor<cpu,2,int8_t> &rhs, float scale ){
+            const index_t m = lhs.shape[1], n = rhs.shape[1], k = lhs.shape[0];
+            if( m == 0 || n == 0 ) return;
+            // correction of shifted lhs
+            std::vector<int32_t> rsum( n, 0 );
+            if( kShiftA != 0 ){
+                for( index_t j = 0; j < n; ++ j ){
+                    int32_t s = 0;
+                    for( index_t x = 0; x < k; ++ x ) s += rhs[j][x];
+                    rsum[j] = kShiftA * s;
+                }
+            }
+            const index_t mtile = ( m + kTileA - 1 ) / kTileA;
+            const long ntask = static_cast<long>( ( n + kTileB - 1 ) / kTileB ) * mtile;
+            #pragma omp parallel for schedule(static) if( static_cast<size_t>( m ) * n * k >= MSHADOW_PARALLEL_WORK_THRESHOLD )
+            for( long t = 0; t < ntask; ++ t ){
+                const index_t i0 = static_cast<index_t>( t % mtile ) * kTileA, j0 = static_cast<index_t>( t / mtile ) * kTileB;
+                const index_t ni = std::min( m - i0, kTileA ), nj = std::min( n - j0, kTileB );
+                // rows out of range repeat the last row, their results are dropped
+                const int8_t *a[kTileA], *b[kTileB];
+                for( index_t i = 0; i < kTileA; ++ i ) a[i] = lhs[ i0 + std::min( i, ni - 1 ) ].dptr;
+                for( index_t j = 0; j < kTileB; ++ j ) b[j] = rhs[ j0 + std::min( j, nj - 1 ) ].dptr;
+                int32_t r[kTileA][kTileB];
+                DotTile( r, a, b, k );
+                for( index_t i = 0; i < ni; ++ i ){
+                    for( index_t j = 0; j < nj; ++ j ){
+                        const int32_t v = r[i][j] - rsum[ j0 + j ];
+                        SV::Save( dst[ i0 + i ][ j0 + j ], scale == 1.0f ? v : Round( static_cast<double>( v ) * scale ) );
+                    }
+                }
+            }
+        }
+    }; // namespace quant
+
+    /*!
+     * \brief calibrate per tensor scale of quantization, scale = v / 127,
+     *        v is the largest absolute value, or the given percentile of absolute values to clip outliers
+     * \param src calibration data, e.g. input of a layer on a few batches
+     * \param percentile percentile of absolute value mapped to 127, in (0,1]
+     * \return scale, 1 if src is all zero
+     * \tparam dim dimension of src
+     * \tparam DType element type of src, e.g. real_t
+     */
+    template<int dim, typename DType>
+    inline float QuantScale( const Tensor<cpu,dim,DType> &src, float percentile = 1.0f ){
+        utils::Assert( percentile > 0.0f && percentile <= 1.0f, "QuantScale: percentile must be in (0,1]" );
+        Tensor<cpu,2,DType> s = src.FlatTo2D();
+        float vmax = 0.0f;
+        if( percentile == 1.0f ){
+            for( index_t y = 0; y < s.shape[1]; ++ y ){
+                for( index_t x = 0; x < s.shape[0]; ++ x ) vmax = std::max( vmax, std::fabs( static_cast<float>( s[y][x] ) ) );
+            }
+        }else{
+            std::vector<float> v;
+            v.reserve( s.shape.Size() );
+            for( index_t y = 0; y < s.shape[1]; ++ y ){
+                for( index_t x = 0; x < s.shape[0]; ++ x ) v.push_back( std::fabs( static_cast<float>( s[y][x] ) ) );
+            }
+            if( v.size() != 0 ){
+                const size_t pos = std::min( static_cast<size_t>( percentile * v.size() ), v.size() - 1 );
+                std::nth_element( v.begin(), v.begin() + pos, v.end() );
+                vmax = v[ pos ];
+            }
+        }
+        return vmax > 0.0f ? vmax / quant::kQMax : 1.0f;
+    }
+    /*!
+     * \brief calibrate per row scale of quantization, dst[y] = max_x | src[y][x] | / 127, 1 for rows of zeros,
+     *        for weight stored as ( nout, nin ) this is the per output channel scale
+     * \param dst scale of each row
+     * \param src matrix to be quantized
+     * \tparam DType element type of src, e.g. real_t
+     */
+    template<typename DType>
+    inline void QuantScaleRows( Tensor<cpu,1,float> dst, const Tensor<cpu,2,DType> &src ){
+        utils::Assert( dst.shape[0] == src.shape[1], "QuantScaleRows: shape mismatch" );
+        for( index_t y = 0; y < src.shape[1]; ++ y ){
+            float vmax = 0.0f;
+            for( index_t x = 0; x < src.shape[0]; ++ x ) vmax = std::max( vmax, std::fabs( static_cast<float>( src[y][x] ) ) );
+            dst[y] = vmax > 0.0f ? vmax / quant::kQMax : 1.0f;
+        }
+    }
+
+    namespace expr{
+        /*!
+         * \brief quantize a float expression to int8, q = round( src / scale ) clipped to [-127,127]
+         * \tparam SrcExp source expression
+         * \tparam dim dimension of expression
+         */
+        template<typename SrcExp, int dim>
+        struct QuantizeExp: public MakeTensorExp< QuantizeExp<SrcExp,dim>, SrcExp, dim >{
+            /*! \brief source operand */
+            const SrcExp &src_;
+            /*! \brief scale of each row of src flattened to 2D, NULL means scale_ is used */
+            const float *rscale_;
+            /*! \brief per tensor scale */
+            float scale_;
+            /*! \brief constructor */
+            QuantizeExp( const SrcExp &src, const float *rscale, float scale )
+                :src_(src), rscale_(rscale), scale_(scale){
+                this->shape_ = ShapeCheck<dim,SrcExp>::Check( src_ );
+            }
+        };
+        /*!
+         * \brief dequantize an integer expression to float, result is src * scale * cscale[x]
+         * \tparam SrcExp source expression, int32 accumulator of dot or int8 tensor
+         * \tparam dim dimension of expression
+         */
+        template<typename SrcExp, int dim>
+        struct DequantizeExp: public MakeTensorExp< DequantizeExp<SrcExp,dim>, SrcExp, dim >{
+            /*! \brief source operand */
+            const SrcExp &src_;
+            /*! \brief scale of each column (lowest dimension), NULL means no per column scale */
+            const float *cscale_;
+            /*! \brief per tensor scale */
+            float scale_;
+            /*! \brief constructor */
+            DequantizeExp( const SrcExp &src, const float *cscale, float scale )
+                :src_(src), cscale_(cscale), scale_(scale){
+                this->shape_ = ShapeCheck<dim,SrcExp>::Check( src_ );
+            }
+        };
+        /*!
+         * \brief quantize float expression with per tensor scale, result is assigned to Tensor<cpu,dim,int8_t>
+         * \param src source expression
+         * \param scale scale of quantization, e.g. from QuantScale
+         */
+        template<typename SrcExp, int etype>
+        inline QuantizeExp<SrcExp,ExpInfo<SrcExp>::kDim> quantize( const Exp<SrcExp,etype> &src, float scale ){
+            return QuantizeExp<SrcExp,ExpInfo<SrcExp>::kDim>( src.self(), NULL, scale );
+        }
+        /*!
+         * \brief quantize float expression with per row scale, e.g. weight of shape ( nout, nin ) per output channel
+         * \param src source expression
+         * \param rscale scale of each row of src flattened to 2D, e.g. from QuantScaleRows
+         */
+        template<typename SrcExp, int etype>
+        inline QuantizeExp<SrcExp,ExpInfo<SrcExp>::kDim> quantize( const Exp<SrcExp,etype> &src, const Tensor<cpu,1,float> &rscale ){
+            return QuantizeExp<SrcExp,ExpInfo<SrcExp>::kDim>( src.self(), rscale.dptr, 1.0f );
+        }
+        /*!
+         * \brief dequantize integer expression with per tensor scale, result is src * scale
+         * \param src source expression
+         * \param scale scale of quantization
+         */
+        template<typename SrcExp, int etype>
+        inline DequantizeExp<SrcExp,ExpInfo<SrcExp>::kDim> dequantize( const Exp<SrcExp,etype> &src, float scale ){
+            return DequantizeExp<SrcExp,ExpInfo<SrcExp>::kDim>( src.self(), NULL, scale );
+        }
+        /*!
+         * \brief dequantize result of int8 dot, result is src * scale * cscale[x],
+         *        cscale is per output channel scale of weight, scale is per tensor scale of input
+         * \param src source expression
+         * \param cscale scale of each column (lowest dimension)
+         * \param scale per tensor scale
+         */
+        template<typename SrcExp, int etype>
+        inline DequantizeExp<SrcExp,ExpInfo<SrcExp>::kDim> dequantize( const Exp<SrcExp,etype> &src, const Tensor<cpu,1,float> &cscale, float scale ){
+            return DequantizeExp<SrcExp,ExpInfo<SrcExp>::kDim>( src.self(), cscale.dptr, scale );
+        }
+        // quantize and dequantize change the element type
+        template<typename SrcExp, int dim>
+        struct ExpInfo< MakeTensorExp< QuantizeExp<SrcExp,dim>, SrcExp, dim > >{
+            typedef int8_t DType;
+            const static int kDim = ExpInfo<SrcExp>::kDim >= 0 ? dim : -1;
+            const static int kDevMask = ExpInfo<SrcExp>::kDevMask & cpu::kDevMask;
+        };
+        template<typename SrcExp, int dim>
+        struct ExpInfo< MakeTensorExp< DequantizeExp<SrcExp,dim>, SrcExp, dim > >{
+            typedef float DType;
+            const static int kDim = ExpInfo<SrcExp>::kDim >= 0 ? dim : -1;
+            const static int kDevMask = ExpInfo<SrcExp>::kDevMask & cpu::kDevMask;
+        };
+
+        template<typename SrcExp, int dim>
+        struct Plan< QuantizeExp<SrcExp,dim> >{
+        public:
+            Plan( const QuantizeExp<SrcExp,dim> &e )
+                :src_(MakePlan(e.src_)), rscale_(e.rscale_), rscale_inv_(1.0f / e.scale_){}
+            MSHADOW_XINLINE int8_t Eval( index_t y, index_t x ) const{
+                const float v = src_.Eval( y, x );
+                return quant::Quantize( rscale_ == NULL ? v * rscale_inv_ : v / rscale_[y] );
+            }
+        private:
+            Plan<SrcExp> src_;
+            const float *rscale_;
+            float rscale_inv_;
+        };
+        template<typename SrcExp, int dim>
+        struct Plan< DequantizeExp<SrcExp,dim> >{
+        public:
+            Plan( const DequantizeExp<SrcExp,dim> &e )
+                :src_(MakePlan(e.src_)), cscale_(e.cscale_), scale_(e.scale_){}
+            MSHADOW_XINLINE float Eval( index_t y, index_t x ) const{
+                const float v = static_cast<float>( src_.Eval( y, x ) ) * scale_;
+                return cscale_ == NULL ? v : v * cscale_[x];
+            }
+        private:
+            Plan<SrcExp> src_;
+            const float *cscale_;
+            float scale_;
+        };
+
+        /*!
+         * \brief dst = dot( lhs[.T], rhs[.T] ) of int8 matrices, accumulated in int32,
+         *        the kernel takes both operands with K as the lowest dimension, i.e. dot( lhs, rhs.T() ),
+         *        operands in other layout are transposed to temp space
+         */
+        template<typename SV, bool ltrans, bool rtrans>
+        struct ExpComplexEngine< SV, cpu, 2, int32_t, DotExp< Tensor<cpu,2,int8_t>, Tensor<cpu,2,int8_t>, ltrans, rtrans > >{
+            inline static void Eval( Tensor<cpu,2,int32_t> &dst, const DotExp< Tensor<cpu,2,int8_t>, Tensor<cpu,2,int8_t>, ltrans, rtrans > &exp ){
+                Shape<2> sleft  = GetShape( exp.lhs_.shape, ltrans );
+                Shape<2> sright = GetShape( exp.rhs_.shape, rtrans );
+                utils::Assert( dst.shape[1] == sleft[1] && dst.shape[0] == sright[0] \
+                               && sleft[0] == sright[1] , "dot-gemm: matrix shape mismatch" );
+                TensorContainer<cpu,2,int8_t> ltmp( false ), rtmp( false );
+                Tensor<cpu,2,int8_t> lhs = ltrans ? quant::Transpose( exp.lhs_, ltmp ) : exp.lhs_;
+                Tensor<cpu,2,int8_t> rhs = rtrans ? exp.rhs_ : quant::Transpose( exp.rhs_, rtmp );
+                quant::Gemm<SV>( dst, lhs, rhs, exp.scale_ );
+            }
+        };
+    }; // namespace expr
+
+#if MSHADOW_USE_SSE
+    namespace expr{
+        // dequantize of int32 tensor, 4 integers are converted at a time
+        template<int dim>
+        class SSEPlan< DequantizeExp< Tensor<cpu,dim,int32_t>, dim > >{
+        public:
+            SSEPlan( const DequantizeExp< Tensor<cpu,dim,int32_t>, dim > &e )
+                :plan_(e), dptr_(e.src_.dptr), stride_(e.src_.shape.stride_), cscale_(e.cscale_), vscale_( _mm_set1_ps( e.scale_ ) ){}
+            MSHADOW_CINLINE sse2::FVec<float> EvalSSE( index_t y, index_t x ) const{
+                __m128 v = _mm_mul_ps( _mm_cvtepi32_ps( _mm_loadu_si128( reinterpret_cast<const __m128i*>( dptr_ + y * stride_ + x ) ) ), vscale_ );
+                if( cscale_ != NULL ) v = _mm_mul_ps( v, _mm_loadu_ps( cscale_ + x ) );
+                return sse2::FVec<float>( v );
+            }
+            MSHADOW_CINLINE float Eval( index_t y, index_t x ) const{
+                return plan_.Eval( y, x );
+            }
+        private:
+            Plan< DequantizeExp< Tensor<cpu,dim,int32_t>, dim > > plan_;
+            const int32_t *dptr_;
+            index_t stride_;
+            const float *cscale_;
+            __m128 vscale_;
+        };
+        template<int dim>
+        struct SSECheck< MakeTensorExp< DequantizeExp< Tensor<cpu,dim,int32_t>, dim >, Tensor<cpu,dim,int32_t>, dim > >{
+            const static bool kPass = true;
+        };
+        // integers and scales are loaded without alignment requirement
+        template<int dim>
+        struct SSEAlignCheck< dim, MakeTensorExp< DequantizeExp< Tensor<cpu,dim,int32_t>, dim >, Tensor<cpu,dim,int32_t>, dim > >{
+            inline static bool Check( const MakeTensorExp< DequantizeExp< Tensor<cpu,dim,int32_t>, dim >, Tensor<cpu,dim,int32_t>, dim > &t ){
+                return true;
+            }
+        };
+    }; // namespace expr
+#endif
+};
+#endif // MSHADOW_TENSOR_INT8_H
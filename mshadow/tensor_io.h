@@ -6,7 +6,16 @@
  * \author Tianqi Chen
  */
 #include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
 #include "tensor.h"
+#if MSHADOW_USE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 namespace mshadow{
     namespace utils{
@@ -40,13 +49,14 @@ namespace mshadow{
      * \param fo output binary stream
      * \param src source data file
      * \tparam dim dimension of tensor
+     * \tparam DType element type of tensor, the content is stored as raw DType values
      * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
      */
-    template<int dim,typename TStream>
-    inline void SaveBinary( TStream &fo, const Tensor<cpu,dim> &src );
+    template<int dim, typename DType, typename TStream>
+    inline void SaveBinary( TStream &fo, const Tensor<cpu,dim,DType> &src );
     /*! \brief refer to comment of cpu ver \sa SaveBinary */
-    template<int dim,typename TStream>
-    inline void SaveBinary( TStream &fo, const Tensor<gpu,dim> &src );
+    template<int dim, typename DType, typename TStream>
+    inline void SaveBinary( TStream &fo, const Tensor<gpu,dim,DType> &src );
 
     /*! 
      * \brief CPU/GPU: load a tensor by binary format, for GPU version, a temp Tensor<cpu,dim> storage will be allocated
@@ -55,15 +65,68 @@ namespace mshadow{
      * \param fi output binary stream
      * \param dst destination file
      * \param pre_alloc whether space is pre-allocated, if false, space allocation will happen
-     * \tparam dim dimension of tensor     
+     * \tparam dim dimension of tensor
+     * \tparam DType element type of tensor
      * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
      */
-    template<int dim,typename TStream>
-    inline void LoadBinary( TStream &fi, Tensor<cpu,dim> &dst, bool pre_alloc );
+    template<int dim, typename DType, typename TStream>
+    inline void LoadBinary( TStream &fi, Tensor<cpu,dim,DType> &dst, bool pre_alloc );
     /*! \brief refer to comment of cpu ver \sa LoadBinary */
-    template<int dim,typename TStream>
-    inline void LoadBinary( TStream &fi, Tensor<gpu,dim> &dst, bool pre_alloc );
+    template<int dim, typename DType, typename TStream>
+    inline void LoadBinary( TStream &fi, Tensor<gpu,dim,DType> &dst, bool pre_alloc );
     
+    namespace utils{
+        class MMapStream;
+    };
+    /*!
+     * \brief CPU: load a tensor saved by SaveBinary using multiple threads, each thread reads a disjoint part of the file by pread,
+     *        large tensors on fast storage are loaded at the bandwidth of the device instead of the speed of one read loop
+     * \param fname name of file
+     * \param offset offset of the tensor in file, moved to the end of the tensor after loading, so several tensors can be loaded in sequence
+     * \param dst destination
+     * \param pre_alloc whether space is pre-allocated, if false, space allocation will happen
+     * \tparam dim dimension of tensor
+     * \tparam DType element type of tensor
+     */
+    template<int dim, typename DType>
+    inline void LoadBinaryParallel( const char *fname, size_t &offset, Tensor<cpu,dim,DType> &dst, bool pre_alloc );
+    /*!
+     * \brief CPU: save a tensor in aligned binary format, the record is a header of magic, dimension and shape,
+     *        followed by the content, both are zero padded to multiple of MSHADOW_BINARY_ALIGN_BYTES,
+     *        so when a file only contains such records, the content of every tensor starts at aligned offset,
+     *        the format is read by LoadBinaryAligned and LoadBinaryMapped
+     * \param fo output binary stream
+     * \param src source tensor
+     * \tparam dim dimension of tensor
+     * \tparam DType element type of tensor
+     * \tparam TStream type of stream, need to support Write
+     */
+    template<int dim, typename DType, typename TStream>
+    inline void SaveBinaryAligned( TStream &fo, const Tensor<cpu,dim,DType> &src );
+    /*!
+     * \brief CPU: load a tensor saved by SaveBinaryAligned, see LoadBinary for meaning of pre_alloc
+     * \param fi input binary stream
+     * \param dst destination
+     * \param pre_alloc whether space is pre-allocated, if false, space allocation will happen
+     * \tparam dim dimension of tensor
+     * \tparam DType element type of tensor
+     * \tparam TStream type of stream, need to support Read
+     */
+    template<int dim, typename DType, typename TStream>
+    inline void LoadBinaryAligned( TStream &fi, Tensor<cpu,dim,DType> &dst, bool pre_alloc );
+    /*!
+     * \brief CPU: zero-copy load of a tensor saved by SaveBinaryAligned, dst points directly into the memory mapped file, 
+     *        no space is allocated, dst must not be freed by FreeSpace, and is only valid while fi is open
+     *        the mapping is read-only, dst must not be modified, pages are shared with other processes mapping the same file,
+     *        the record must start at offset that is multiple of MSHADOW_BINARY_ALIGN_BYTES, which holds when the file is written by SaveBinaryAligned only
+     * \param fi memory mapped input stream, the tensor is loaded from current position, position moves to the end of the tensor
+     * \param dst destination, shape is set to the loaded shape
+     * \tparam dim dimension of tensor
+     * \tparam DType element type of tensor
+     */
+    template<int dim, typename DType>
+    inline void LoadBinaryMapped( utils::MMapStream &fi, Tensor<cpu,dim,DType> &dst );
+
     namespace utils{
         /*! \brief implementation of file i/o stream */
         class FileStream: public IStream{
@@ -83,31 +146,207 @@ namespace mshadow{
         private:
             FILE *fp_;
         };
+
+        /*!
+         * \brief file stream with a large user space buffer, small reads and writes are served from the buffer, 
+         *        large blocks are transferred directly, a stream should be used either for reading or for writing
+         */
+        class BufferedFileStream: public IStream{
+        public:
+            /*!
+             * \brief constructor, the buffering of fp is turned off by setvbuf, 
+             *        so the stream must be constructed before any other operation on fp, including fseek
+             * \param fp file pointer, not owned by the stream, same as FileStream, call Close to close it
+             * \param buffer_size size of buffer in bytes
+             */
+            BufferedFileStream( FILE *fp, size_t buffer_size = MSHADOW_IO_BUFFER_BYTES )
+                :fp_(fp), buf_(buffer_size), begin_(0), end_(0), nwrite_(0){
+                utils::Assert( fp_ != NULL, "BufferedFileStream: invalid file" );
+                setvbuf( fp_, NULL, _IONBF, 0 );
+            }
+            /*! \brief destructor, buffered content is written to file, the file is not closed */
+            virtual ~BufferedFileStream( void ){
+                if( fp_ != NULL ) this->Flush();
+            }
+            virtual size_t Read( void *ptr, size_t size ){
+                char *dst = static_cast<char*>( ptr );
+                size_t nread = std::min( size, end_ - begin_ );
+                memcpy( dst, &buf_[0] + begin_, nread );
+                begin_ += nread;
+                if( nread == size ) return size;
+                if( size - nread >= buf_.size() ){
+                    // large block, read directly
+                    nread += fread( dst + nread, 1, size - nread, fp_ );
+                }else{
+                    begin_ = 0;
+                    end_ = fread( &buf_[0], 1, buf_.size(), fp_ );
+                    const size_t n = std::min( size - nread, end_ );
+                    memcpy( dst + nread, &buf_[0], n );
+                    begin_ = n; nread += n;
+                }
+                return nread == size ? size : 0;
+            }
+            virtual void Write( const void *ptr, size_t size ){
+                if( nwrite_ + size > buf_.size() ) this->Flush();
+                if( size >= buf_.size() ){
+                    // large block, write directly
+                    utils::Assert( fwrite( ptr, 1, size, fp_ ) == size, "BufferedFileStream: write failed" );
+                }else{
+                    memcpy( &buf_[0] + nwrite_, ptr, size );
+                    nwrite_ += size;
+                }
+            }
+            /*! \brief write buffered content to file */
+            inline void Flush( void ){
+                if( nwrite_ != 0 ){
+                    utils::Assert( fwrite( &buf_[0], 1, nwrite_, fp_ ) == nwrite_, "BufferedFileStream: write failed" );
+                    nwrite_ = 0;
+                }
+            }
+            /*! \brief flush and close file */
+            inline void Close( void ){
+                if( fp_ == NULL ) return;
+                this->Flush();
+                fclose( fp_ );
+                fp_ = NULL;
+            }
+        private:
+            /*! \brief file pointer */
+            FILE *fp_;
+            /*! \brief buffer */
+            std::vector<char> buf_;
+            /*! \brief range of unread content in buffer, for reading */
+            size_t begin_, end_;
+            /*! \brief size of buffered content, for writing */
+            size_t nwrite_;
+            // not copyable
+            BufferedFileStream( const BufferedFileStream &s );
+            BufferedFileStream& operator=( const BufferedFileStream &s );
+        };
+
+        /*! 
+         * \brief read-only stream on a memory mapped file, also supports zero-copy access to the content,
+         *        when mmap is not available, the whole file is read into memory instead
+         */
+        class MMapStream: public IStream{
+        public:
+            /*! 
+             * \brief constructor, map the whole file 
+             * \param fname name of file
+             */
+            MMapStream( const char *fname ){
+                pos_ = 0; size_ = 0; data_ = NULL;
+                #if MSHADOW_USE_MMAP
+                int fd = open( fname, O_RDONLY );
+                utils::Assert( fd >= 0, "MMapStream: can not open file" );
+                struct stat st;
+                utils::Assert( fstat( fd, &st ) == 0, "MMapStream: can not stat file" );
+                size_ = static_cast<size_t>( st.st_size );
+                if( size_ != 0 ){
+                    void *p = mmap( NULL, size_, PROT_READ, MAP_SHARED, fd, 0 );
+                    utils::Assert( p != MAP_FAILED, "MMapStream: mmap failed" );
+                    data_ = static_cast<char*>( p );
+                }
+                close( fd );
+                #else
+                FILE *fp = fopen( fname, "rb" );
+                utils::Assert( fp != NULL, "MMapStream: can not open file" );
+                fseek( fp, 0, SEEK_END );
+                size_ = static_cast<size_t>( ftell( fp ) );
+                fseek( fp, 0, SEEK_SET );
+                if( size_ != 0 ){
+                    size_t pitch;
+                    // aligned the same as a mapped page, so LoadBinaryMapped behaves the same
+                    data_ = static_cast<char*>( sse2::AlignedMallocPitch( pitch, size_, 1 ) );
+                    utils::Assert( fread( data_, size_, 1, fp ) == 1, "MMapStream: read failed" );
+                }
+                fclose( fp );
+                #endif
+            }
+            virtual ~MMapStream( void ){
+                this->Close();
+            }
+            virtual size_t Read( void *ptr, size_t size ){
+                if( size > size_ - pos_ ) return 0;
+                memcpy( ptr, data_ + pos_, size );
+                pos_ += size;
+                return size;
+            }
+            virtual void Write( const void *ptr, size_t size ){
+                utils::Error( "MMapStream is read-only" );
+            }
+            /*! \brief unmap the file, tensors loaded by LoadBinaryMapped become invalid */
+            inline void Close( void ){
+                if( data_ != NULL ){
+                    #if MSHADOW_USE_MMAP
+                    munmap( data_, size_ );
+                    #else
+                    sse2::AlignedFree( data_ );
+                    #endif
+                    data_ = NULL;
+                }
+                size_ = pos_ = 0;
+            }
+            /*! \brief pointer to start of content */
+            inline const char *Begin( void ) const{
+                return data_;
+            }
+            /*! \brief pointer to current position */
+            inline const char *Data( void ) const{
+                return data_ + pos_;
+            }
+            /*! \return current position */
+            inline size_t Tell( void ) const{
+                return pos_;
+            }
+            /*! \brief set current position */
+            inline void Seek( size_t pos ){
+                utils::Assert( pos <= size_, "MMapStream: seek out of range" );
+                pos_ = pos;
+            }
+            /*! \return size of file */
+            inline size_t Size( void ) const{
+                return size_;
+            }
+        private:
+            /*! \brief start of mapped content */
+            char *data_;
+            /*! \brief size of content and current position */
+            size_t size_, pos_;
+            // not copyable
+            MMapStream( const MMapStream &s );
+            MMapStream& operator=( const MMapStream &s );
+        };
     };
 };
 
 namespace mshadow{
     // implementations
-    template<int dim, typename TStream>
-    inline void SaveBinary( TStream &fo, const Tensor<cpu,dim> &src_ ){
+    template<int dim, typename DType, typename TStream>
+    inline void SaveBinary( TStream &fo, const Tensor<cpu,dim,DType> &src_ ){
         fo.Write( src_.shape.shape_, sizeof(index_t) * dim );
-        Tensor<cpu,2> src = src_.FlatTo2D();
+        Tensor<cpu,2,DType> src = src_.FlatTo2D();
+        if( src.shape[0] == 0 ) return;
+        // continuous tensor is written in one block
+        if( src.shape.stride_ == src.shape[0] || src.shape[1] == 1 ){
+            fo.Write( src.dptr, sizeof(DType) * src.shape.Size() ); return;
+        }
         for( index_t i = 0; i < src.shape[1]; ++ i ){
-            fo.Write( src[i].dptr, sizeof(real_t)*src.shape[0] );
+            fo.Write( src[i].dptr, sizeof(DType)*src.shape[0] );
         }
     }
-    template<int dim, typename TStream>
-    inline void SaveBinary( TStream &fo, const Tensor<gpu,dim> &src ){
+    template<int dim, typename DType, typename TStream>
+    inline void SaveBinary( TStream &fo, const Tensor<gpu,dim,DType> &src ){
         // copy to CPU, then save
-        Tensor<cpu,dim> tmp( src.shape ); 
+        Tensor<cpu,dim,DType> tmp( src.shape ); 
         AllocSpace( tmp );
         Copy( tmp, src );
         SaveBinary( fo, tmp );
         FreeSpace( tmp );
     }
 
-    template<int dim, typename TStream>
-    inline void LoadBinary( TStream &fi, Tensor<cpu,dim> &dst_, bool pre_alloc ){
+    template<int dim, typename DType, typename TStream>
+    inline void LoadBinary( TStream &fi, Tensor<cpu,dim,DType> &dst_, bool pre_alloc ){
         Shape<dim> shape;
         utils::Assert( fi.Read( shape.shape_, sizeof(index_t) * dim ) != 0, "mshadow::LoadBinary" );
         if( pre_alloc ){
@@ -115,15 +354,184 @@ namespace mshadow{
         }else{
             dst_.shape = shape; AllocSpace( dst_ );
         }
-        Tensor<cpu,2> dst = dst_.FlatTo2D();
+        Tensor<cpu,2,DType> dst = dst_.FlatTo2D();
         if( dst.shape[0] == 0 ) return;        
+        if( dst.shape.stride_ == dst.shape[0] || dst.shape[1] == 1 ){
+            utils::Assert( fi.Read( dst.dptr, sizeof(DType) * dst.shape.Size() ) != 0, "mshadow::LoadBinary" ); return;
+        }
         for( index_t i = 0; i < dst.shape[1]; ++ i ){
-            utils::Assert( fi.Read( dst[i].dptr, sizeof(real_t)*dst.shape[0] ) != 0, "mshadow::LoadBinary" );
+            utils::Assert( fi.Read( dst[i].dptr, sizeof(DType)*dst.shape[0] ) != 0, "mshadow::LoadBinary" );
         }
     } 
-    template<int dim, typename TStream>
-    inline void LoadBinary( TStream &fi, Tensor<gpu,dim> &dst, bool pre_alloc ){
-        Tensor<cpu,dim> tmp;
+    namespace utils{
+        /*! \brief magic number at the start of record of SaveBinaryAligned, the last byte is version of format */
+        const uint32_t kBinaryAlignedMagic = 0x4d534101U;
+        /*! \return x rounded up to multiple of MSHADOW_BINARY_ALIGN_BYTES */
+        inline size_t BinaryAlignUp( size_t x ){
+            return ( x + MSHADOW_BINARY_ALIGN_BYTES - 1 ) / MSHADOW_BINARY_ALIGN_BYTES * MSHADOW_BINARY_ALIGN_BYTES;
+        }
+        /*! \brief size of header of SaveBinaryAligned: magic, dimension and shape */
+        template<int dim>
+        inline size_t BinaryAlignedHeaderSize( void ){
+            return BinaryAlignUp( sizeof(uint32_t) * 2 + sizeof(index_t) * dim );
+        }
+        /*! \brief write size zero bytes */
+        template<typename TStream>
+        inline void WriteZeros( TStream &fo, size_t size ){
+            const char zeros[ MSHADOW_BINARY_ALIGN_BYTES ] = { 0 };
+            for( size_t n; size != 0; size -= n ){
+                n = std::min( size, sizeof(zeros) );
+                fo.Write( zeros, n );
+            }
+        }
+        /*! \brief check the header of SaveBinaryAligned, header points to BinaryAlignedHeaderSize<dim>() bytes */
+        template<int dim>
+        inline Shape<dim> ParseBinaryAlignedHeader( const char *header ){
+            uint32_t magic, ndim;
+            memcpy( &magic, header, sizeof(magic) );
+            memcpy( &ndim, header + sizeof(magic), sizeof(ndim) );
+            utils::Assert( magic == kBinaryAlignedMagic, "mshadow::LoadBinaryAligned: not a record of SaveBinaryAligned" );
+            utils::Assert( ndim == static_cast<uint32_t>( dim ), "mshadow::LoadBinaryAligned: dimension mismatch" );
+            Shape<dim> shape;
+            memcpy( shape.shape_, header + sizeof(uint32_t) * 2, sizeof(index_t) * dim );
+            shape.stride_ = shape[0];
+            return shape;
+        }
+    };
+
+    template<int dim, typename DType, typename TStream>
+    inline void SaveBinaryAligned( TStream &fo, const Tensor<cpu,dim,DType> &src_ ){
+        const size_t nheader = utils::BinaryAlignedHeaderSize<dim>();
+        std::vector<char> header( nheader, 0 );
+        const uint32_t magic = utils::kBinaryAlignedMagic, ndim = static_cast<uint32_t>( dim );
+        memcpy( &header[0], &magic, sizeof(magic) );
+        memcpy( &header[sizeof(magic)], &ndim, sizeof(ndim) );
+        memcpy( &header[sizeof(uint32_t) * 2], src_.shape.shape_, sizeof(index_t) * dim );
+        fo.Write( &header[0], nheader );
+        // content has the same layout as SaveBinary, i.e. rows without padding
+        Tensor<cpu,2,DType> src = src_.FlatTo2D();
+        const size_t nbytes = sizeof(DType) * src.shape.Size();
+        if( nbytes == 0 ) return;
+        if( src.shape.stride_ == src.shape[0] || src.shape[1] == 1 ){
+            fo.Write( src.dptr, nbytes );
+        }else{
+            for( index_t i = 0; i < src.shape[1]; ++ i ){
+                fo.Write( src[i].dptr, sizeof(DType) * src.shape[0] );
+            }
+        }
+        utils::WriteZeros( fo, utils::BinaryAlignUp( nbytes ) - nbytes );
+    }
+    template<int dim, typename DType, typename TStream>
+    inline void LoadBinaryAligned( TStream &fi, Tensor<cpu,dim,DType> &dst_, bool pre_alloc ){
+        const size_t nheader = utils::BinaryAlignedHeaderSize<dim>();
+        std::vector<char> header( nheader );
+        utils::Assert( fi.Read( &header[0], nheader ) != 0, "mshadow::LoadBinaryAligned" );
+        Shape<dim> shape = utils::ParseBinaryAlignedHeader<dim>( &header[0] );
+        if( pre_alloc ){
+            utils::Assert( shape == dst_.shape, "mshadow::LoadBinaryAligned: shape mismatch" );
+        }else{
+            dst_.shape = shape; AllocSpace( dst_ );
+        }
+        Tensor<cpu,2,DType> dst = dst_.FlatTo2D();
+        const size_t nbytes = sizeof(DType) * dst.shape.Size();
+        if( nbytes == 0 ) return;
+        if( dst.shape.stride_ == dst.shape[0] || dst.shape[1] == 1 ){
+            utils::Assert( fi.Read( dst.dptr, nbytes ) != 0, "mshadow::LoadBinaryAligned" );
+        }else{
+            for( index_t i = 0; i < dst.shape[1]; ++ i ){
+                utils::Assert( fi.Read( dst[i].dptr, sizeof(DType) * dst.shape[0] ) != 0, "mshadow::LoadBinaryAligned" );
+            }
+        }
+        // skip padding
+        char pad[ MSHADOW_BINARY_ALIGN_BYTES ];
+        const size_t npad = utils::BinaryAlignUp( nbytes ) - nbytes;
+        if( npad != 0 ) utils::Assert( fi.Read( pad, npad ) != 0, "mshadow::LoadBinaryAligned" );
+    }
+    template<int dim, typename DType>
+    inline void LoadBinaryMapped( utils::MMapStream &fi, Tensor<cpu,dim,DType> &dst ){
+        const size_t nheader = utils::BinaryAlignedHeaderSize<dim>();
+        // the file is mapped at page boundary, so the content is aligned when the record is at aligned offset
+        utils::Assert( fi.Tell() % MSHADOW_BINARY_ALIGN_BYTES == 0, "mshadow::LoadBinaryMapped: record is not at aligned offset, the file must be written by SaveBinaryAligned" );
+        utils::Assert( nheader <= fi.Size() - fi.Tell(), "mshadow::LoadBinaryMapped: file is truncated" );
+        Shape<dim> shape = utils::ParseBinaryAlignedHeader<dim>( fi.Data() );
+        fi.Seek( fi.Tell() + nheader );
+        const size_t nbytes = sizeof(DType) * shape.Size();
+        utils::Assert( utils::BinaryAlignUp( nbytes ) <= fi.Size() - fi.Tell(), "mshadow::LoadBinaryMapped: file is truncated" );
+        dst.dptr  = reinterpret_cast<DType*>( const_cast<char*>( fi.Data() ) );
+        dst.shape = shape;
+        fi.Seek( fi.Tell() + utils::BinaryAlignUp( nbytes ) );
+    }
+#if MSHADOW_USE_MMAP
+    namespace utils{
+        /*!
+         * \brief read size bytes at offset of file, without moving file position, can be called by threads concurrently
+         * \param fd file descriptor
+         * \param ptr destination
+         * \param size number of bytes
+         * \param offset offset in file
+         */
+        inline void PRead( int fd, void *ptr, size_t size, size_t offset ){
+            char *dst = static_cast<char*>( ptr );
+            while( size != 0 ){
+                ssize_t n = pread( fd, dst, size, static_cast<off_t>( offset ) );
+                utils::Assert( n > 0, "PRead: read failed or file is truncated" );
+                dst += n; size -= n; offset += n;
+            }
+        }
+    };
+#endif
+    template<int dim, typename DType>
+    inline void LoadBinaryParallel( const char *fname, size_t &offset, Tensor<cpu,dim,DType> &dst_, bool pre_alloc ){
+        #if MSHADOW_USE_MMAP
+        int fd = open( fname, O_RDONLY );
+        utils::Assert( fd >= 0, "mshadow::LoadBinaryParallel: can not open file" );
+        Shape<dim> shape;
+        utils::PRead( fd, shape.shape_, sizeof(index_t) * dim, offset );
+        offset += sizeof(index_t) * dim;
+        if( pre_alloc ){
+            utils::Assert( shape == dst_.shape, "mshadow::LoadBinaryParallel: shape mismatch" );
+        }else{
+            dst_.shape = shape; AllocSpace( dst_ );
+        }
+        Tensor<cpu,2,DType> dst = dst_.FlatTo2D();
+        const size_t nrow = sizeof(DType) * dst.shape[0];
+        const size_t nbytes = nrow * dst.shape[1];
+        // each task reads about MSHADOW_IO_BUFFER_BYTES, a tensor that fits in one task is read by the calling thread
+        if( dst.shape.stride_ == dst.shape[0] || dst.shape[1] == 1 ){
+            const int ntask = static_cast<int>( ( nbytes + MSHADOW_IO_BUFFER_BYTES - 1 ) / MSHADOW_IO_BUFFER_BYTES );
+            char *ptr = reinterpret_cast<char*>( dst.dptr );
+            #pragma omp parallel for schedule(dynamic) if( nbytes > MSHADOW_IO_BUFFER_BYTES )
+            for( int i = 0; i < ntask; ++ i ){
+                const size_t begin = static_cast<size_t>( i ) * MSHADOW_IO_BUFFER_BYTES;
+                utils::PRead( fd, ptr + begin, std::min( nbytes - begin, static_cast<size_t>( MSHADOW_IO_BUFFER_BYTES ) ), offset + begin );
+            }
+        }else if( nrow != 0 ){
+            const index_t rows_per_task = std::max( static_cast<index_t>( MSHADOW_IO_BUFFER_BYTES / nrow ), static_cast<index_t>( 1 ) );
+            const int ntask = static_cast<int>( ( dst.shape[1] + rows_per_task - 1 ) / rows_per_task );
+            #pragma omp parallel for schedule(dynamic) if( nbytes > MSHADOW_IO_BUFFER_BYTES )
+            for( int i = 0; i < ntask; ++ i ){
+                const index_t end = std::min( static_cast<index_t>( i + 1 ) * rows_per_task, dst.shape[1] );
+                for( index_t r = static_cast<index_t>( i ) * rows_per_task; r < end; ++ r ){
+                    utils::PRead( fd, dst[r].dptr, nrow, offset + static_cast<size_t>( r ) * nrow );
+                }
+            }
+        }
+        offset += nbytes;
+        close( fd );
+        #else
+        FILE *fp = fopen( fname, "rb" );
+        utils::Assert( fp != NULL, "mshadow::LoadBinaryParallel: can not open file" );
+        // setvbuf in the stream constructor must come before the seek
+        utils::BufferedFileStream fs( fp );
+        utils::Assert( fseek( fp, static_cast<long>( offset ), SEEK_SET ) == 0, "mshadow::LoadBinaryParallel: seek failed" );
+        LoadBinary( fs, dst_, pre_alloc );
+        fs.Close();
+        offset += sizeof(index_t) * dim + sizeof(DType) * dst_.shape.Size();
+        #endif
+    }
+    template<int dim, typename DType, typename TStream>
+    inline void LoadBinary( TStream &fi, Tensor<gpu,dim,DType> &dst, bool pre_alloc ){
+        Tensor<cpu,dim,DType> tmp;
         LoadBinary( fi, tmp, false );
         if( pre_alloc ){
             utils::Assert( tmp.shape == dst.shape );
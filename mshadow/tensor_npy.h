@@ -0,0 +1,672 @@
+#ifndef MSHADOW_TENSOR_NPY_H
+#define MSHADOW_TENSOR_NPY_H
+/*!
+ * \file tensor_npy.h
+ * \brief reader and writer of NumPy .npy and .npz files
+ *
+ *  NumPy shape is highest dimension first, while Shape of mshadow is lowest dimension first,
+ *  so a Tensor<cpu,2> of shape (ncol,nrow) in mshadow is saved as array of shape (nrow,ncol), which has the same row major layout.
+ *  files are written in native byte order as little endian, and read with conversion from
+ *  float16, float32, float64, int8, uint8, int16, uint16, int32, uint32, int64, uint64 to real_t.
+ *  .npz files are zip archives of .npy files, only stored (uncompressed) members are supported, as written by numpy.savez
+ */
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include "tensor.h"
+#include "tensor_io.h"
+#include "tensor_serial.h"
+#include "tensor_codec.h"
+
+namespace mshadow{
+    /*! \brief header parsing and element conversion of .npy format */
+    namespace npy{
+        /*! \brief magic string at start of .npy file */
+        const char kMagic[6] = { '\x93','N','U','M','P','Y' };
+        /*! \brief alignment of data in .npy file, and in .npz file written by NpzWriter */
+        const size_t kAlign = 64;
+        /*! \brief header of .npy file */
+        struct Header{
+            /*! \brief dtype descriptor, e.g. "<f4" */
+            std::string descr;
+            /*! \brief whether data is stored in column major order */
+            bool fortran_order;
+            /*! \brief shape in NumPy order, highest dimension first */
+            std::vector<size_t> shape;
+            /*! \brief size of header, data starts at this offset */
+            size_t size;
+            /*! \return number of elements */
+            inline size_t Size( void ) const{
+                size_t n = 1;
+                for( size_t i = 0; i < shape.size(); ++ i ) n *= shape[i];
+                return n;
+            }
+        };
+        /*! \return dtype descriptor of real_t */
+        inline const char *RealDescr( void ){
+            return sizeof(real_t) == 4 ? "<f4" : "<f8";
+        }
+        /*! \return whether dtype descriptor is real_t in native byte order */
+        inline bool IsRealDescr( const std::string &descr ){
+            return descr == RealDescr() || descr == std::string( "=" ) + ( RealDescr() + 1 );
+        }
+        /*!
+         * \brief make header of .npy file, padded so that data starts at multiple of kAlign
+         * \param shape shape of tensor, lowest dimension first as in mshadow
+         * \param dim number of dimensions
+         */
+        inline std::string MakeHeader( const index_t *shape, int dim ){
+            std::string dict = "{'descr': '";
+            dict += RealDescr();
+            dict += "', 'fortran_order': False, 'shape': (";
+            char buf[32];
+            for( int i = dim - 1; i >= 0; -- i ){
+                sprintf( buf, "%lu", static_cast<unsigned long>( shape[i] ) );
+                dict += buf;
+                if( i != 0 || dim == 1 ) dict += ",";
+                if( i != 0 ) dict += " ";
+            }
+            dict += "), }";
+            // magic, version and length take 10 bytes, header ends with '\n'
+            const size_t total = ( 10 + dict.length() + 1 + kAlign - 1 ) / kAlign * kAlign;
+            dict.append( total - 10 - dict.length() - 1, ' ' );
+            dict += '\n';
+            utils::Assert( dict.length() <= 0xFFFF, "npy: header is too long" );
+            std::string h( kMagic, sizeof(kMagic) );
+            h += '\x01'; h += '\x00';
+            h += static_cast<char>( dict.length() & 0xFF );
+            h += static_cast<char>( dict.length() >> 8 );
+            return h + dict;
+        }
+        // find value string of key in the header dict
+        inline size_t FindKey( const std::string &dict, const char *key ){
+            const size_t pos = dict.find( std::string( "'" ) + key + "'" );
+            utils::Assert( pos != std::string::npos, "npy: key is missing in header" );
+            const size_t colon = dict.find( ':', pos );
+            utils::Assert( colon != std::string::npos, "npy: header is corrupted" );
+            return dict.find_first_not_of( " ", colon + 1 );
+        }
+        /*!
+         * \brief parse the dict part of header
+         * \param dict the dict string
+         * \param h output header, size is not set
+         */
+        inline void ParseDict( const std::string &dict, Header *h ){
+            size_t p = FindKey( dict, "descr" );
+            utils::Assert( p != std::string::npos && ( dict[p] == '\'' || dict[p] == '"' ), "npy: descr is corrupted" );
+            const size_t e = dict.find( dict[p], p + 1 );
+            utils::Assert( e != std::string::npos, "npy: descr is corrupted" );
+            h->descr = dict.substr( p + 1, e - p - 1 );
+            p = FindKey( dict, "fortran_order" );
+            h->fortran_order = dict.compare( p, 4, "True" ) == 0;
+            p = FindKey( dict, "shape" );
+            utils::Assert( p != std::string::npos && dict[p] == '(', "npy: shape is corrupted" );
+            h->shape.clear();
+            for( ++ p; p < dict.length() && dict[p] != ')'; ){
+                if( dict[p] >= '0' && dict[p] <= '9' ){
+                    size_t v = 0;
+                    for( ; dict[p] >= '0' && dict[p] <= '9'; ++ p ) v = v * 10 + ( dict[p] - '0' );
+                    h->shape.push_back( v );
+                }else{
+                    ++ p;
+                }
+            }
+            utils::Assert( p < dict.length(), "npy: shape is corrupted" );
+        }
+        /*!
+         * \brief parse header from memory
+         * \param data start of .npy content
+         * \param size available bytes
+         * \param h output header
+         */
+        inline void ParseHeader( const char *data, size_t size, Header *h ){
+            utils::Assert( size >= 10 && memcmp( data, kMagic, sizeof(kMagic) ) == 0, "npy: not a npy file" );
+            const unsigned char *p = reinterpret_cast<const unsigned char*>( data );
+            size_t len, start;
+            if( p[6] == 1 ){
+                len = p[8] | ( static_cast<size_t>( p[9] ) << 8 ); start = 10;
+            }else{
+                utils::Assert( size >= 12, "npy: file is truncated" );
+                len = p[8] | ( static_cast<size_t>( p[9] ) << 8 ) | ( static_cast<size_t>( p[10] ) << 16 ) | ( static_cast<size_t>( p[11] ) << 24 );
+                start = 12;
+            }
+            utils::Assert( start + len <= size, "npy: file is truncated" );
+            ParseDict( std::string( data + start, len ), h );
+            h->size = start + len;
+        }
+        /*! \brief read header from stream, the stream is positioned at start of data */
+        template<typename TStream>
+        inline void ReadHeader( TStream &fi, Header *h ){
+            char pre[12];
+            utils::Assert( fi.Read( pre, 10 ) != 0, "npy: file is truncated" );
+            size_t n = 10;
+            if( pre[6] != 1 ){
+                utils::Assert( fi.Read( pre + 10, 2 ) != 0, "npy: file is truncated" );
+                n = 12;
+            }
+            const unsigned char *p = reinterpret_cast<const unsigned char*>( pre );
+            size_t len = p[8] | ( static_cast<size_t>( p[9] ) << 8 );
+            if( n == 12 ) len |= ( static_cast<size_t>( p[10] ) << 16 ) | ( static_cast<size_t>( p[11] ) << 24 );
+            std::string buf( pre, n );
+            buf.resize( n + len );
+            utils::Assert( len == 0 || fi.Read( &buf[n], len ) != 0, "npy: file is truncated" );
+            ParseHeader( buf.data(), buf.length(), h );
+        }
+        /*! \brief get shape in mshadow order from header, check dimension */
+        template<int dim>
+        inline Shape<dim> GetShape( const Header &h ){
+            utils::Assert( !h.fortran_order, "npy: fortran_order array is not supported" );
+            utils::Assert( h.shape.size() == static_cast<size_t>( dim ) || ( h.shape.size() == 0 && dim == 1 ),
+                           "npy: dimension mismatch" );
+            Shape<dim> s;
+            if( h.shape.size() == 0 ){
+                s[0] = 1;
+            }else{
+                for( int i = 0; i < dim; ++ i ) s[i] = static_cast<index_t>( h.shape[ dim - 1 - i ] );
+            }
+            s.stride_ = s[0];
+            return s;
+        }
+        /*! \return size of element of dtype, check that dtype is supported */
+        inline size_t ElemSize( const std::string &descr ){
+            utils::Assert( descr.length() >= 3 && descr[0] != '>', "npy: big endian dtype is not supported" );
+            const char t = descr[1];
+            const size_t n = static_cast<size_t>( atoi( descr.c_str() + 2 ) );
+            const bool ok = ( t == 'f' && ( n == 2 || n == 4 || n == 8 ) ) || ( ( t == 'i' || t == 'u' ) && ( n == 1 || n == 2 || n == 4 || n == 8 ) );
+            utils::Assert( ok, "npy: unsupported dtype" );
+            return n;
+        }
+        template<typename T>
+        inline void ConvertFrom( real_t *dst, const char *src, size_t n ){
+            for( size_t i = 0; i < n; ++ i ){
+                T v; memcpy( &v, src + i * sizeof(T), sizeof(T) );
+                dst[i] = static_cast<real_t>( v );
+            }
+        }
+        /*!
+         * \brief convert n elements of dtype descr into real_t
+         * \param dst destination
+         * \param src source content
+         * \param n number of elements
+         * \param descr dtype descriptor
+         */
+        inline void Convert( real_t *dst, const char *src, size_t n, const std::string &descr ){
+            const char t = descr[1];
+            switch( ElemSize( descr ) ){
+            case 1: if( t == 'i' ) ConvertFrom<int8_t>( dst, src, n ); else ConvertFrom<uint8_t>( dst, src, n ); return;
+            case 2:
+                if( t == 'f' ){
+                    for( size_t i = 0; i < n; ++ i ){
+                        uint16_t v; memcpy( &v, src + i * 2, 2 );
+                        dst[i] = static_cast<real_t>( codec::HalfToFloat( v ) );
+                    }
+                }else if( t == 'i' ){
+                    ConvertFrom<int16_t>( dst, src, n );
+                }else{
+                    ConvertFrom<uint16_t>( dst, src, n );
+                }
+                return;
+            case 4:
+                if( t == 'f' ) ConvertFrom<float>( dst, src, n );
+                else if( t == 'i' ) ConvertFrom<int32_t>( dst, src, n );
+                else ConvertFrom<uint32_t>( dst, src, n );
+                return;
+            default:
+                if( t == 'f' ) ConvertFrom<double>( dst, src, n );
+                else if( t == 'i' ) ConvertFrom<int64_t>( dst, src, n );
+                else ConvertFrom<uint64_t>( dst, src, n );
+                return;
+            }
+        }
+        /*!
+         * \brief load content of npy from stream into dst, data is converted to real_t row by row
+         * \param fi input stream, positioned at start of data
+         * \param h header of npy
+         * \param dst_ destination, shape is already set and space is allocated
+         */
+        template<int dim, typename TStream>
+        inline void ReadContent( TStream &fi, const Header &h, Tensor<cpu,dim> &dst_ ){
+            Tensor<cpu,2> dst = dst_.FlatTo2D();
+            if( dst.shape.Size() == 0 ) return;
+            if( IsRealDescr( h.descr ) ){
+                if( dst.shape.stride_ == dst.shape[0] || dst.shape[1] == 1 ){
+                    utils::Assert( fi.Read( dst.dptr, sizeof(real_t) * dst.shape.Size() ) != 0, "npy: file is truncated" ); return;
+                }
+                for( index_t i = 0; i < dst.shape[1]; ++ i ){
+                    utils::Assert( fi.Read( dst[i].dptr, sizeof(real_t) * dst.shape[0] ) != 0, "npy: file is truncated" );
+                }
+                return;
+            }
+            const size_t esize = ElemSize( h.descr );
+            std::vector<char> row( esize * dst.shape[0] );
+            for( index_t i = 0; i < dst.shape[1]; ++ i ){
+                utils::Assert( fi.Read( &row[0], row.size() ) != 0, "npy: file is truncated" );
+                Convert( dst[i].dptr, &row[0], dst.shape[0], h.descr );
+            }
+        }
+    };
+
+    /*!
+     * \brief CPU/GPU: save a tensor as .npy, for GPU version, a temp Tensor<cpu,dim> storage will be allocated
+     * \param fo output stream
+     * \param src source tensor
+     * \tparam dim dimension of tensor
+     * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
+     */
+    template<int dim, typename TStream>
+    inline void SaveNpy( TStream &fo, const Tensor<cpu,dim> &src_ ){
+        const std::string h = npy::MakeHeader( src_.shape.shape_, dim );
+        fo.Write( h.data(), h.length() );
+        Tensor<cpu,2> src = src_.FlatTo2D();
+        if( src.shape.Size() == 0 ) return;
+        if( src.shape.stride_ == src.shape[0] || src.shape[1] == 1 ){
+            fo.Write( src.dptr, sizeof(real_t) * src.shape.Size() ); return;
+        }
+        for( index_t i = 0; i < src.shape[1]; ++ i ){
+            fo.Write( src[i].dptr, sizeof(real_t) * src.shape[0] );
+        }
+    }
+    /*! \brief refer to comment of cpu ver \sa SaveNpy */
+    template<int dim, typename TStream>
+    inline void SaveNpy( TStream &fo, const Tensor<gpu,dim> &src ){
+        Tensor<cpu,dim> tmp( src.shape );
+        AllocSpace( tmp );
+        Copy( tmp, src );
+        SaveNpy( fo, tmp );
+        FreeSpace( tmp );
+    }
+    /*!
+     * \brief CPU/GPU: load a .npy file, content is converted to real_t, for GPU version, a temp Tensor<cpu,dim> storage will be allocated
+     * \param fi input stream
+     * \param dst destination
+     * \param pre_alloc whether space is pre-allocated, if false, space allocation will happen
+     * \tparam dim dimension of tensor
+     * \tparam TStream type of stream, need to support Read, Write, one example is utils::IStream.
+     */
+    template<int dim, typename TStream>
+    inline void LoadNpy( TStream &fi, Tensor<cpu,dim> &dst, bool pre_alloc ){
+        npy::Header h;
+        npy::ReadHeader( fi, &h );
+        Shape<dim> shape = npy::GetShape<dim>( h );
+        if( pre_alloc ){
+            utils::Assert( shape == dst.shape, "LoadNpy: shape mismatch" );
+        }else{
+            dst.shape = shape; AllocSpace( dst );
+        }
+        npy::ReadContent( fi, h, dst );
+    }
+    /*! \brief refer to comment of cpu ver \sa LoadNpy */
+    template<int dim, typename TStream>
+    inline void LoadNpy( TStream &fi, Tensor<gpu,dim> &dst, bool pre_alloc ){
+        Tensor<cpu,dim> tmp;
+        LoadNpy( fi, tmp, false );
+        if( pre_alloc ){
+            utils::Assert( tmp.shape == dst.shape, "LoadNpy: shape mismatch" );
+        }else{
+            dst.shape = tmp.shape; AllocSpace( dst );
+        }
+        Copy( dst, tmp );
+        FreeSpace( tmp );
+    }
+    /*!
+     * \brief zero-copy load of a .npy file in a MMapStream, only possible when dtype is real_t in native order, and the data is aligned,
+     *        dst is read-only, must not be freed, and is only valid while the stream is open
+     * \param fi input stream, positioned at start of .npy content
+     * \param dst destination
+     * \return true if dst is mapped and stream moves past the array, false if dtype, order or alignment does not match,
+     *         in that case the stream is not moved, and LoadNpy can be used to load a copy
+     * \tparam dim dimension of tensor
+     */
+    template<int dim>
+    inline bool LoadNpyMapped( utils::MMapStream &fi, Tensor<cpu,dim> &dst ){
+        npy::Header h;
+        npy::ParseHeader( fi.Data(), fi.Size() - fi.Tell(), &h );
+        const char *data = fi.Data() + h.size;
+        if( !npy::IsRealDescr( h.descr ) || h.fortran_order || reinterpret_cast<size_t>( data ) % sizeof(real_t) != 0 ) return false;
+        Shape<dim> shape = npy::GetShape<dim>( h );
+        const size_t nbytes = sizeof(real_t) * shape.Size();
+        utils::Assert( nbytes <= fi.Size() - fi.Tell() - h.size, "LoadNpyMapped: file is truncated" );
+        dst.dptr = reinterpret_cast<real_t*>( const_cast<char*>( data ) );
+        dst.shape = shape;
+        fi.Seek( fi.Tell() + h.size + nbytes );
+        return true;
+    }
+};
+
+namespace mshadow{
+    /*! \brief records of zip archive used by .npz */
+    namespace npz{
+        const uint32_t kLocalSig = 0x04034b50;
+        const uint32_t kCentralSig = 0x02014b50;
+        const uint32_t kEndSig = 0x06054b50;
+        const uint32_t kEnd64Sig = 0x06064b50;
+        const uint32_t kEnd64LocatorSig = 0x07064b50;
+        /*! \brief size of fixed part of local file header */
+        const size_t kLocalSize = 30;
+        /*! \brief member of archive */
+        struct Entry{
+            /*! \brief name of array, without .npy suffix */
+            std::string name;
+            /*! \brief offset of local header */
+            uint64_t offset;
+            /*! \brief size of member */
+            uint64_t size;
+            /*! \brief crc32 of member */
+            uint32_t crc;
+        };
+        template<typename T>
+        inline T Get( const char *p ){
+            T v; memcpy( &v, p, sizeof(T) ); return v;
+        }
+    };
+
+    /*!
+     * \brief writer of .npz file, each tensor is stored uncompressed as name.npy,
+     *        data of each array is aligned to npy::kAlign bytes in the file, so NpzReader can map it without copy
+     *        files larger than 4GB are not supported
+     *
+     *  usage:
+     *    NpzWriter w( "model.npz" );
+     *    w.Write( "fc1_weight", wmat ); w.Write( "fc1_bias", bias );
+     *    w.Close();
+     */
+    class NpzWriter{
+    public:
+        /*!
+         * \brief constructor, create the file
+         * \param fname name of file
+         */
+        explicit NpzWriter( const char *fname ){
+            fp_ = fopen( fname, "wb" );
+            utils::Assert( fp_ != NULL, "NpzWriter: can not open file" );
+            pos_ = 0;
+        }
+        ~NpzWriter( void ){
+            this->Close();
+        }
+        /*!
+         * \brief write a tensor
+         * \param name name of the array, must be unique in the file
+         * \param src tensor to be written
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline void Write( const std::string &name, const Tensor<cpu,dim> &src ){
+            utils::Assert( fp_ != NULL, "NpzWriter: already closed" );
+            utils::Assert( names_.count( name ) == 0, "NpzWriter: duplicated array name" );
+            names_[ name ] = entries_.size();
+            const std::string fname = name + ".npy";
+            const std::string h = npy::MakeHeader( src.shape.shape_, dim );
+            Tensor<cpu,2> mat = src.FlatTo2D();
+            const size_t nrow = sizeof(real_t) * mat.shape[0];
+            npz::Entry e;
+            e.name = name; e.offset = pos_;
+            e.size = h.length() + static_cast<uint64_t>( nrow ) * mat.shape[1];
+            utils::Assert( pos_ + e.size + 1024 < 0xFFFFFFFFULL, "NpzWriter: file larger than 4GB is not supported" );
+            // pad extra field, so that the npy content starts at multiple of kAlign
+            const size_t start = static_cast<size_t>( pos_ ) + npz::kLocalSize + fname.length();
+            const size_t nextra = ( npy::kAlign - start % npy::kAlign ) % npy::kAlign;
+            const size_t extra = nextra == 0 || nextra >= 4 ? nextra : nextra + npy::kAlign;
+            // crc is filled after content is written
+            e.crc = 0;
+            std::string local = this->LocalHeader( e, fname, extra );
+            this->WriteRaw( local.data(), local.length() );
+            e.crc = utils::CRC32( e.crc, h.data(), h.length() );
+            this->WriteRaw( h.data(), h.length() );
+            if( mat.shape.stride_ == mat.shape[0] || mat.shape[1] == 1 ){
+                e.crc = utils::CRC32( e.crc, mat.dptr, nrow * mat.shape[1] );
+                this->WriteRaw( mat.dptr, nrow * mat.shape[1] );
+            }else{
+                for( index_t i = 0; i < mat.shape[1]; ++ i ){
+                    e.crc = utils::CRC32( e.crc, mat[i].dptr, nrow );
+                    this->WriteRaw( mat[i].dptr, nrow );
+                }
+            }
+            pos_ += local.length() + e.size;
+            // crc is at offset 14 of local header
+            utils::Assert( fseek( fp_, static_cast<long>( e.offset + 14 ), SEEK_SET ) == 0, "NpzWriter: seek failed" );
+            this->WriteRaw( &e.crc, 4 );
+            utils::Assert( fseek( fp_, 0, SEEK_END ) == 0, "NpzWriter: seek failed" );
+            entries_.push_back( e );
+        }
+        /*! \brief GPU version, a temp Tensor<cpu,dim> storage will be allocated */
+        template<int dim>
+        inline void Write( const std::string &name, const Tensor<gpu,dim> &src ){
+            Tensor<cpu,dim> tmp( src.shape );
+            AllocSpace( tmp );
+            Copy( tmp, src );
+            this->Write( name, tmp );
+            FreeSpace( tmp );
+        }
+        /*! \brief write the central directory, and close the file */
+        inline void Close( void ){
+            if( fp_ == NULL ) return;
+            std::string dir;
+            for( size_t i = 0; i < entries_.size(); ++ i ){
+                const npz::Entry &e = entries_[i];
+                const std::string fname = e.name + ".npy";
+                utils::Append( dir, npz::kCentralSig );
+                utils::Append( dir, static_cast<uint16_t>( 20 ) );
+                this->AppendCommon( dir, e, fname );
+                // comment length, disk number, internal and external attributes
+                utils::Append( dir, static_cast<uint16_t>( 0 ) );
+                utils::Append( dir, static_cast<uint16_t>( 0 ) );
+                utils::Append( dir, static_cast<uint16_t>( 0 ) );
+                utils::Append( dir, static_cast<uint32_t>( 0 ) );
+                utils::Append( dir, static_cast<uint32_t>( e.offset ) );
+                dir += fname;
+            }
+            utils::Append( dir, npz::kEndSig );
+            utils::Append( dir, static_cast<uint16_t>( 0 ) );
+            utils::Append( dir, static_cast<uint16_t>( 0 ) );
+            utils::Append( dir, static_cast<uint16_t>( entries_.size() ) );
+            utils::Append( dir, static_cast<uint16_t>( entries_.size() ) );
+            utils::Append( dir, static_cast<uint32_t>( dir.length() - 4 - 2 * 4 ) );
+            utils::Append( dir, static_cast<uint32_t>( pos_ ) );
+            utils::Append( dir, static_cast<uint16_t>( 0 ) );
+            this->WriteRaw( dir.data(), dir.length() );
+            utils::Assert( fclose( fp_ ) == 0, "NpzWriter: close failed" );
+            fp_ = NULL;
+        }
+    private:
+        /*! \brief file pointer */
+        FILE *fp_;
+        /*! \brief current position in file */
+        uint64_t pos_;
+        /*! \brief members written */
+        std::vector<npz::Entry> entries_;
+        /*! \brief names that are written */
+        std::map<std::string,size_t> names_;
+    private:
+        // fields shared by local header and central directory, from version needed to extra length
+        inline void AppendCommon( std::string &buf, const npz::Entry &e, const std::string &fname, size_t extra = 0 ){
+            utils::Append( buf, static_cast<uint16_t>( 20 ) );
+            utils::Append( buf, static_cast<uint16_t>( 0 ) );
+            utils::Append( buf, static_cast<uint16_t>( 0 ) );
+            // dos time and date: 1980-01-01 00:00
+            utils::Append( buf, static_cast<uint16_t>( 0 ) );
+            utils::Append( buf, static_cast<uint16_t>( 0x21 ) );
+            utils::Append( buf, e.crc );
+            utils::Append( buf, static_cast<uint32_t>( e.size ) );
+            utils::Append( buf, static_cast<uint32_t>( e.size ) );
+            utils::Append( buf, static_cast<uint16_t>( fname.length() ) );
+            utils::Append( buf, static_cast<uint16_t>( extra ) );
+        }
+        inline std::string LocalHeader( const npz::Entry &e, const std::string &fname, size_t extra ){
+            std::string buf;
+            utils::Append( buf, npz::kLocalSig );
+            this->AppendCommon( buf, e, fname, extra );
+            buf += fname;
+            if( extra != 0 ){
+                // padding is an extra field of unused id 0xCAFE
+                utils::Append( buf, static_cast<uint16_t>( 0xCAFE ) );
+                utils::Append( buf, static_cast<uint16_t>( extra - 4 ) );
+                buf.append( extra - 4, '\0' );
+            }
+            return buf;
+        }
+        inline void WriteRaw( const void *ptr, size_t size ){
+            if( size == 0 ) return;
+            utils::Assert( fwrite( ptr, size, 1, fp_ ) == 1, "NpzWriter: write failed" );
+        }
+        // not copyable
+        NpzWriter( const NpzWriter &w );
+        NpzWriter& operator=( const NpzWriter &w );
+    };
+
+    /*!
+     * \brief reader of .npz file, the file is memory mapped, arrays can be loaded by copy with conversion,
+     *        or mapped without copy when dtype is real_t and data is aligned
+     */
+    class NpzReader{
+    public:
+        /*!
+         * \brief constructor, open the file and load the central directory
+         * \param fname name of file
+         */
+        explicit NpzReader( const char *fname ):fi_(fname){
+            const char *base = fi_.Begin();
+            const size_t size = fi_.Size();
+            utils::Assert( size >= 22, "NpzReader: not a zip file" );
+            // end of central directory is at the end, followed by a comment of at most 64KB
+            size_t end = size - 22;
+            const size_t lowest = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+            while( npz::Get<uint32_t>( base + end ) != npz::kEndSig ){
+                utils::Assert( end != lowest, "NpzReader: not a zip file" );
+                -- end;
+            }
+            uint64_t count = npz::Get<uint16_t>( base + end + 10 );
+            uint64_t dir_offset = npz::Get<uint32_t>( base + end + 16 );
+            if( end >= 20 && npz::Get<uint32_t>( base + end - 20 ) == npz::kEnd64LocatorSig ){
+                const uint64_t end64 = npz::Get<uint64_t>( base + end - 20 + 8 );
+                utils::Assert( end64 + 56 <= size && npz::Get<uint32_t>( base + end64 ) == npz::kEnd64Sig, "NpzReader: zip64 record is corrupted" );
+                count = npz::Get<uint64_t>( base + end64 + 32 );
+                dir_offset = npz::Get<uint64_t>( base + end64 + 48 );
+            }
+            size_t pos = static_cast<size_t>( dir_offset );
+            for( uint64_t i = 0; i < count; ++ i ){
+                utils::Assert( pos + 46 <= size && npz::Get<uint32_t>( base + pos ) == npz::kCentralSig, "NpzReader: central directory is corrupted" );
+                const char *p = base + pos;
+                utils::Assert( npz::Get<uint16_t>( p + 10 ) == 0, "NpzReader: compressed npz is not supported" );
+                const size_t nname = npz::Get<uint16_t>( p + 28 ), nextra = npz::Get<uint16_t>( p + 30 ), ncomment = npz::Get<uint16_t>( p + 32 );
+                utils::Assert( pos + 46 + nname + nextra + ncomment <= size, "NpzReader: central directory is corrupted" );
+                npz::Entry e;
+                e.crc = npz::Get<uint32_t>( p + 16 );
+                e.size = npz::Get<uint32_t>( p + 24 );
+                e.offset = npz::Get<uint32_t>( p + 42 );
+                e.name.assign( p + 46, nname );
+                // sizes and offset are in zip64 extra field when they do not fit in 32 bits
+                for( size_t k = 0; k + 4 <= nextra; ){
+                    const char *x = p + 46 + nname + k;
+                    const size_t len = npz::Get<uint16_t>( x + 2 );
+                    if( npz::Get<uint16_t>( x ) == 1 ){
+                        const char *v = x + 4;
+                        if( npz::Get<uint32_t>( p + 24 ) == 0xFFFFFFFFU ){ e.size = npz::Get<uint64_t>( v ); v += 8; }
+                        if( npz::Get<uint32_t>( p + 20 ) == 0xFFFFFFFFU ) v += 8;
+                        if( npz::Get<uint32_t>( p + 42 ) == 0xFFFFFFFFU ) e.offset = npz::Get<uint64_t>( v );
+                    }
+                    k += 4 + len;
+                }
+                if( e.name.length() > 4 && e.name.compare( e.name.length() - 4, 4, ".npy" ) == 0 ){
+                    e.name.erase( e.name.length() - 4 );
+                }
+                utils::Assert( e.offset + npz::kLocalSize <= size && npz::Get<uint32_t>( base + e.offset ) == npz::kLocalSig,
+                               "NpzReader: local header is corrupted" );
+                // data starts after local header, its extra field can differ from the one in central directory
+                e.offset += npz::kLocalSize + npz::Get<uint16_t>( base + e.offset + 26 ) + npz::Get<uint16_t>( base + e.offset + 28 );
+                utils::Assert( e.offset + e.size <= size, "NpzReader: file is truncated" );
+                names_[ e.name ] = entries_.size();
+                entries_.push_back( e );
+                pos += 46 + nname + nextra + ncomment;
+            }
+        }
+        /*! \return number of arrays in file */
+        inline size_t Size( void ) const{
+            return entries_.size();
+        }
+        /*! \return name of i-th array */
+        inline const std::string &Name( size_t i ) const{
+            return entries_[i].name;
+        }
+        /*! \return whether an array of name exists */
+        inline bool Contains( const std::string &name ) const{
+            return names_.count( name ) != 0;
+        }
+        /*! \return dimension of array */
+        inline int Dim( const std::string &name ) const{
+            npy::Header h; this->GetHeader( name, &h );
+            return static_cast<int>( h.shape.size() );
+        }
+        /*!
+         * \brief get shape of array, in mshadow order
+         * \param name name of array
+         * \tparam dim dimension of array, must match the one in file
+         */
+        template<int dim>
+        inline Shape<dim> GetShape( const std::string &name ) const{
+            npy::Header h; this->GetHeader( name, &h );
+            return npy::GetShape<dim>( h );
+        }
+        /*!
+         * \brief check the content of array against checksum in the archive
+         * \param name name of array
+         * \return whether checksum matches
+         */
+        inline bool Verify( const std::string &name ) const{
+            const npz::Entry &e = this->Find( name );
+            return utils::CRC32( 0, fi_.Begin() + e.offset, static_cast<size_t>( e.size ) ) == e.crc;
+        }
+        /*!
+         * \brief load an array by copy, content is converted to real_t
+         * \param name name of array
+         * \param dst destination
+         * \param pre_alloc whether space of dst is pre-allocated, if true, shape must match, otherwise space is allocated by AllocSpace
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline void Read( const std::string &name, Tensor<cpu,dim> &dst, bool pre_alloc ){
+            fi_.Seek( static_cast<size_t>( this->Find( name ).offset ) );
+            LoadNpy( fi_, dst, pre_alloc );
+        }
+        /*! \brief GPU version, a temp Tensor<cpu,dim> storage will be allocated */
+        template<int dim>
+        inline void Read( const std::string &name, Tensor<gpu,dim> &dst, bool pre_alloc ){
+            fi_.Seek( static_cast<size_t>( this->Find( name ).offset ) );
+            LoadNpy( fi_, dst, pre_alloc );
+        }
+        /*!
+         * \brief zero-copy load of an array, dst points into the mapped file, and is only valid while the reader is alive
+         * \param name name of array
+         * \param dst destination, read-only and must not be freed
+         * \return true if dst is mapped, false if dtype, order or alignment does not match, use Read instead in that case
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline bool ReadMapped( const std::string &name, Tensor<cpu,dim> &dst ){
+            fi_.Seek( static_cast<size_t>( this->Find( name ).offset ) );
+            return LoadNpyMapped( fi_, dst );
+        }
+    private:
+        /*! \brief mapped file */
+        utils::MMapStream fi_;
+        /*! \brief members of archive */
+        std::vector<npz::Entry> entries_;
+        /*! \brief map name to member */
+        std::map<std::string,size_t> names_;
+    private:
+        inline const npz::Entry &Find( const std::string &name ) const{
+            std::map<std::string,size_t>::const_iterator it = names_.find( name );
+            utils::Assert( it != names_.end(), "NpzReader: array not found" );
+            return entries_[ it->second ];
+        }
+        inline void GetHeader( const std::string &name, npy::Header *h ) const{
+            const npz::Entry &e = this->Find( name );
+            npy::ParseHeader( fi_.Begin() + e.offset, static_cast<size_t>( e.size ), h );
+        }
+    };
+};
+#endif // MSHADOW_TENSOR_NPY_H
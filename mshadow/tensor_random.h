@@ -4,14 +4,386 @@
  *  \file tensor_random.h
  *  \brief Random inline functions for tensor.
  *  \author Bing Xu, Tianqi Chen
- *   Based on curand|MKL|stdlib
+ *   Based on curand|MKL|built-in Philox4x32-10
  */
 #include <cstdlib>
+#include <vector>
+#include <stdint.h>
 #include "tensor.h"
 #include "tensor_container.h"
 
 namespace mshadow {
-    /*! 
+    /*!
+     * \brief built-in counter based random number generator Philox4x32-10, used by Random<cpu> when MKL is not available
+     *        the stream is a sequence of 32bit integers, the integer at position i is word i%4 of Philox(key, counter=i/4),
+     *        so any part of the stream can be generated directly, without generating the part before it
+     */
+    namespace philox{
+        /*! \brief number of stream positions generated in one batch, batches always start at multiple of kBatch */
+        const index_t kBatch = 16;
+        /*! \brief number of stream positions processed by one thread task, multiple of kBatch */
+        const index_t kParallelChunk = 1 << 16;
+        /*!
+         * \brief generate the 4 integers of block idx
+         * \param out output integers
+         * \param idx block index, i.e. counter of Philox
+         * \param key key of the stream
+         */
+        MSHADOW_XINLINE void Block( uint32_t out[4], uint64_t idx, const uint32_t key[2] ){
+            uint32_t c0 = static_cast<uint32_t>( idx ), c1 = static_cast<uint32_t>( idx >> 32 ), c2 = 0, c3 = 0;
+            uint32_t k0 = key[0], k1 = key[1];
+            for( int r = 0; r < 10; ++ r ){
+                const uint64_t p0 = static_cast<uint64_t>( 0xD2511F53U ) * c0;
+                const uint64_t p1 = static_cast<uint64_t>( 0xCD9E8D57U ) * c2;
+                c0 = static_cast<uint32_t>( p1 >> 32 ) ^ c1 ^ k0;
+                c2 = static_cast<uint32_t>( p0 >> 32 ) ^ c3 ^ k1;
+                c1 = static_cast<uint32_t>( p1 );
+                c3 = static_cast<uint32_t>( p0 );
+                k0 += 0x9E3779B9U; k1 += 0xBB67AE85U;
+            }
+            out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+        }
+#if MSHADOW_USE_SSE
+        /*! \brief 32x32->64 multiply of 4 lanes, return low and high 32 bits of the products */
+        inline void MulHiLo( __m128i a, __m128i m, __m128i *lo, __m128i *hi ){
+            // products of lane 0,2 and lane 1,3, shuffled into [lo, lo, hi, hi]
+            __m128i p02 = _mm_shuffle_epi32( _mm_mul_epu32( a, m ), _MM_SHUFFLE(3,1,2,0) );
+            __m128i p13 = _mm_shuffle_epi32( _mm_mul_epu32( _mm_srli_epi64( a, 32 ), m ), _MM_SHUFFLE(3,1,2,0) );
+            *lo = _mm_unpacklo_epi32( p02, p13 );
+            *hi = _mm_unpackhi_epi32( p02, p13 );
+        }
+        /*!
+         * \brief SSE version of Block, generate block idx...idx+3 together, each lane runs one block
+         * \param out output integers, 16 elements
+         * \param idx index of first block, must be multiple of 4
+         * \param key key of the stream
+         */
+        inline void Block4( uint32_t out[16], uint64_t idx, const uint32_t key[2] ){
+            const uint32_t lo = static_cast<uint32_t>( idx );
+            __m128i c0 = _mm_set_epi32( lo + 3, lo + 2, lo + 1, lo );
+            __m128i c1 = _mm_set1_epi32( static_cast<int>( idx >> 32 ) );
+            __m128i c2 = _mm_setzero_si128(), c3 = _mm_setzero_si128();
+            const __m128i m0 = _mm_set1_epi32( static_cast<int>( 0xD2511F53U ) );
+            const __m128i m1 = _mm_set1_epi32( static_cast<int>( 0xCD9E8D57U ) );
+            uint32_t k0 = key[0], k1 = key[1];
+            for( int r = 0; r < 10; ++ r ){
+                __m128i lo0, hi0, lo1, hi1;
+                MulHiLo( c0, m0, &lo0, &hi0 );
+                MulHiLo( c2, m1, &lo1, &hi1 );
+                c0 = _mm_xor_si128( _mm_xor_si128( hi1, c1 ), _mm_set1_epi32( static_cast<int>( k0 ) ) );
+                c2 = _mm_xor_si128( _mm_xor_si128( hi0, c3 ), _mm_set1_epi32( static_cast<int>( k1 ) ) );
+                c1 = lo1; c3 = lo0;
+                k0 += 0x9E3779B9U; k1 += 0xBB67AE85U;
+            }
+            // transpose, so that each block is stored continuously
+            __m128 r0 = _mm_castsi128_ps( c0 ), r1 = _mm_castsi128_ps( c1 );
+            __m128 r2 = _mm_castsi128_ps( c2 ), r3 = _mm_castsi128_ps( c3 );
+            _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+            _mm_storeu_ps( reinterpret_cast<float*>( out ) + 0,  r0 );
+            _mm_storeu_ps( reinterpret_cast<float*>( out ) + 4,  r1 );
+            _mm_storeu_ps( reinterpret_cast<float*>( out ) + 8,  r2 );
+            _mm_storeu_ps( reinterpret_cast<float*>( out ) + 12, r3 );
+        }
+#endif
+        /*! \brief map random integer to real number uniform in [0,1) */
+        MSHADOW_XINLINE real_t ToUniform( uint32_t u ){
+            #if MSHADOW_SINGLE_PRECISION
+            return static_cast<real_t>( static_cast<int>( u >> 8 ) ) * ( 1.0f / 16777216.0f );
+            #else
+            return static_cast<real_t>( u ) * ( 1.0 / 4294967296.0 );
+            #endif
+        }
+        /*! \brief map random integer to real number uniform in (0,1] */
+        MSHADOW_XINLINE real_t ToUniformOpen( uint32_t u ){
+            #if MSHADOW_SINGLE_PRECISION
+            return static_cast<real_t>( static_cast<int>( u >> 8 ) + 1 ) * ( 1.0f / 16777216.0f );
+            #else
+            return ( static_cast<real_t>( u ) + 1.0 ) * ( 1.0 / 4294967296.0 );
+            #endif
+        }
+        /*! \brief uniform distribution in [a,b), each output takes one integer */
+        struct UniformDist{
+            /*! \brief lower bound and scale */
+            real_t a_, scale_;
+            /*! \brief constructor */
+            UniformDist( real_t a, real_t b ):a_(a), scale_(b-a){}
+            /*! \brief value of at position i of the stream, w is the block that contains i */
+            MSHADOW_XINLINE real_t Eval( const uint32_t w[4], uint64_t i ) const{
+                return ToUniform( w[ i & 3 ] ) * scale_ + a_;
+            }
+            #if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+            /*! \brief values at the 4 positions of block w */
+            inline __m128 MapSSE( const uint32_t w[4] ) const{
+                __m128i u = _mm_loadu_si128( reinterpret_cast<const __m128i*>( w ) );
+                __m128 x = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( u, 8 ) ), _mm_set1_ps( 1.0f / 16777216.0f ) );
+                return _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( scale_ ) ), _mm_set1_ps( a_ ) );
+            }
+            #endif
+            /*! \brief map kBatch integers to kBatch outputs */
+            inline void Map( real_t *out, const uint32_t w[kBatch] ) const{
+                #if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+                const __m128 unit = _mm_set1_ps( 1.0f / 16777216.0f );
+                const __m128 scale = _mm_set1_ps( scale_ ), a = _mm_set1_ps( a_ );
+                for( index_t i = 0; i < kBatch; i += 4 ){
+                    __m128i u = _mm_loadu_si128( reinterpret_cast<const __m128i*>( w + i ) );
+                    __m128 x = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( u, 8 ) ), unit );
+                    _mm_storeu_ps( out + i, _mm_add_ps( _mm_mul_ps( x, scale ), a ) );
+                }
+                #else
+                for( index_t i = 0; i < kBatch; ++ i ){
+                    out[i] = ToUniform( w[i] ) * scale_ + a_;
+                }
+                #endif
+            }
+        };
+        /*! 
+         * \brief gaussian distribution, generated by Box-Muller transform, 
+         *        output at position 2j and 2j+1 are the pair transformed from integers at 2j and 2j+1
+         */
+        struct GaussianDist{
+            /*! \brief mean and standard deviation */
+            real_t mu_, sigma_;
+            /*! \brief constructor */
+            GaussianDist( real_t mu, real_t sigma ):mu_(mu), sigma_(sigma){}
+            /*! \brief value of at position i of the stream, w is the block that contains i */
+            inline real_t Eval( const uint32_t w[4], uint64_t i ) const{
+                const index_t j = static_cast<index_t>( i & 2 );
+                #if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+                // same arithmetic as Map, so that the value does not depend on which one generates it
+                const __m128 lg = sse2::Log( sse2::FVec<float>( _mm_set1_ps( ToUniformOpen( w[j] ) ) ) ).data_;
+                const float r = _mm_cvtss_f32( _mm_sqrt_ps( _mm_mul_ps( _mm_set1_ps( -2.0f ), lg ) ) ) * sigma_;
+                sse2::FVec<float> vsin, vcos;
+                sse2::SinCos( sse2::FVec<float>( _mm_set1_ps( ToUniform( w[j+1] ) * ( 2.0f * kPi ) ) ), &vsin, &vcos );
+                return _mm_cvtss_f32( (i & 1) ? vsin.data_ : vcos.data_ ) * r + mu_;
+                #else
+                const real_t r = std::sqrt( -2.0f * std::log( ToUniformOpen( w[j] ) ) ) * sigma_;
+                const real_t theta = ( 2.0f * kPi ) * ToUniform( w[j+1] );
+                return ( (i & 1) ? std::sin( theta ) : std::cos( theta ) ) * r + mu_;
+                #endif
+            }
+            #if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+            /*! \brief values at the 4 positions of block w */
+            inline __m128 MapSSE( const uint32_t w[4] ) const{
+                __m128 v = _mm_loadu_ps( reinterpret_cast<const float*>( w ) );
+                // lane k uses pair k/2, even lanes take cosine and odd lanes take sine
+                __m128i u1 = _mm_castps_si128( _mm_shuffle_ps( v, v, _MM_SHUFFLE(2,2,0,0) ) );
+                __m128i u2 = _mm_castps_si128( _mm_shuffle_ps( v, v, _MM_SHUFFLE(3,3,1,1) ) );
+                const __m128 unit = _mm_set1_ps( 1.0f / 16777216.0f );
+                __m128 x1 = _mm_mul_ps( _mm_cvtepi32_ps( _mm_add_epi32( _mm_srli_epi32( u1, 8 ), _mm_set1_epi32( 1 ) ) ), unit );
+                __m128 x2 = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( u2, 8 ) ), unit );
+                __m128 r = _mm_sqrt_ps( _mm_mul_ps( _mm_set1_ps( -2.0f ), sse2::Log( sse2::FVec<float>( x1 ) ).data_ ) );
+                r = _mm_mul_ps( r, _mm_set1_ps( sigma_ ) );
+                sse2::FVec<float> vsin, vcos;
+                sse2::SinCos( sse2::FVec<float>( _mm_mul_ps( x2, _mm_set1_ps( 2.0f * kPi ) ) ), &vsin, &vcos );
+                const __m128 odd = _mm_castsi128_ps( _mm_set_epi32( -1, 0, -1, 0 ) );
+                __m128 sc = _mm_or_ps( _mm_and_ps( odd, vsin.data_ ), _mm_andnot_ps( odd, vcos.data_ ) );
+                return _mm_add_ps( _mm_mul_ps( sc, r ), _mm_set1_ps( mu_ ) );
+            }
+            #endif
+            /*! \brief map kBatch integers to kBatch outputs */
+            inline void Map( real_t *out, const uint32_t w[kBatch] ) const{
+                #if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+                const __m128 unit = _mm_set1_ps( 1.0f / 16777216.0f );
+                const __m128 sigma = _mm_set1_ps( sigma_ ), mu = _mm_set1_ps( mu_ );
+                for( index_t i = 0; i < kBatch; i += 8 ){
+                    __m128 v0 = _mm_loadu_ps( reinterpret_cast<const float*>( w + i ) );
+                    __m128 v1 = _mm_loadu_ps( reinterpret_cast<const float*>( w + i + 4 ) );
+                    // split the pairs: u1 from even positions, u2 from odd positions
+                    __m128i u1 = _mm_castps_si128( _mm_shuffle_ps( v0, v1, _MM_SHUFFLE(2,0,2,0) ) );
+                    __m128i u2 = _mm_castps_si128( _mm_shuffle_ps( v0, v1, _MM_SHUFFLE(3,1,3,1) ) );
+                    __m128 x1 = _mm_mul_ps( _mm_cvtepi32_ps( _mm_add_epi32( _mm_srli_epi32( u1, 8 ), _mm_set1_epi32( 1 ) ) ), unit );
+                    __m128 x2 = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( u2, 8 ) ), unit );
+                    __m128 r = _mm_sqrt_ps( _mm_mul_ps( _mm_set1_ps( -2.0f ), sse2::Log( sse2::FVec<float>( x1 ) ).data_ ) );
+                    r = _mm_mul_ps( r, sigma );
+                    sse2::FVec<float> vsin, vcos;
+                    sse2::SinCos( sse2::FVec<float>( _mm_mul_ps( x2, _mm_set1_ps( 2.0f * kPi ) ) ), &vsin, &vcos );
+                    __m128 gc = _mm_add_ps( _mm_mul_ps( vcos.data_, r ), mu );
+                    __m128 gs = _mm_add_ps( _mm_mul_ps( vsin.data_, r ), mu );
+                    _mm_storeu_ps( out + i,     _mm_unpacklo_ps( gc, gs ) );
+                    _mm_storeu_ps( out + i + 4, _mm_unpackhi_ps( gc, gs ) );
+                }
+                #else
+                for( index_t i = 0; i < kBatch; i += 2 ){
+                    const real_t r = std::sqrt( -2.0f * std::log( ToUniformOpen( w[i] ) ) ) * sigma_;
+                    const real_t theta = ( 2.0f * kPi ) * ToUniform( w[i+1] );
+                    out[i]   = std::cos( theta ) * r + mu_;
+                    out[i+1] = std::sin( theta ) * r + mu_;
+                }
+                #endif
+            }
+        };
+        /*!
+         * \brief generate the integers of one batch
+         * \param w output integers, kBatch elements
+         * \param bstart start position of the batch in stream, must be multiple of kBatch
+         * \param key key of the stream
+         */
+        inline void GenWords( uint32_t w[kBatch], uint64_t bstart, const uint32_t key[2] ){
+            #if MSHADOW_USE_SSE
+            Block4( w, bstart >> 2, key );
+            #else
+            for( index_t i = 0; i < kBatch; i += 4 ){
+                Block( w + i, ( bstart + i ) >> 2, key );
+            }
+            #endif
+        }
+        /*!
+         * \brief generate one batch of outputs
+         * \param out output, kBatch elements
+         * \param bstart start position of the batch in stream, must be multiple of kBatch
+         * \param key key of the stream
+         * \param dist distribution
+         */
+        template<typename Dist>
+        inline void GenBatch( real_t *out, uint64_t bstart, const uint32_t key[2], const Dist &dist ){
+            uint32_t w[ kBatch ];
+            GenWords( w, bstart, key );
+            dist.Map( out, w );
+        }
+        /*!
+         * \brief fill dst with outputs at position [begin, begin+size) of the stream,
+         *        the result only depends on the positions, not on how the range is split in calls
+         * \param dst destination
+         * \param begin start position in stream
+         * \param size number of outputs
+         * \param key key of the stream
+         * \param dist distribution
+         */
+        template<typename Dist>
+        inline void Fill( real_t *dst, uint64_t begin, size_t size, const uint32_t key[2], const Dist &dist ){
+            const uint64_t end = begin + size;
+            uint64_t pos = begin;
+            real_t tmp[ kBatch ];
+            while( pos < end ){
+                const uint64_t bstart = pos / kBatch * kBatch;
+                if( pos == bstart && end - pos >= kBatch ){
+                    GenBatch( dst + ( pos - begin ), bstart, key, dist );
+                    pos += kBatch;
+                }else{
+                    // partial batch at boundary
+                    GenBatch( tmp, bstart, key, dist );
+                    const uint64_t bend = std::min( bstart + kBatch, end );
+                    for( ; pos < bend; ++ pos ){
+                        dst[ pos - begin ] = tmp[ pos - bstart ];
+                    }
+                }
+            }
+        }
+    }; // namespace philox
+
+    namespace expr{
+        /*!
+         * \brief random values generated by the built-in generator, value at [y][x] is position base+y*shape[0]+x of the stream,
+         *        values are generated when the expression is evaluated, no buffer is needed
+         * \tparam Dist distribution, philox::UniformDist or philox::GaussianDist
+         * \tparam dim dimension of expression
+         */
+        template<typename Dist, int dim>
+        struct RandomExp: public MakeTensorExp< RandomExp<Dist,dim>, cpu, dim >{
+            /*! \brief distribution */
+            Dist dist_;
+            /*! \brief key of the stream */
+            uint32_t key_[2];
+            /*! \brief stream position of first element */
+            uint64_t base_;
+            /*! \brief constructor */
+            RandomExp( Shape<dim> shape, const Dist &dist, const uint32_t key[2], uint64_t base )
+                :dist_(dist), base_(base){
+                key_[0] = key[0]; key_[1] = key[1];
+                this->shape_ = shape;
+            }
+        };
+        // random expression has no source expression, it can only be evaluated on cpu
+        template<typename Dist, int dim>
+        struct ExpInfo< MakeTensorExp< RandomExp<Dist,dim>, cpu, dim > >{
+            typedef real_t DType;
+            const static int kDim = dim;
+            const static int kDevMask = cpu::kDevMask;
+        };
+
+        template<typename Dist, int dim>
+        struct Plan< RandomExp<Dist,dim> >{
+        public:
+            Plan( const RandomExp<Dist,dim> &e )
+                :dist_(e.dist_), base_(e.base_), width_(e.shape_[0]){
+                key_[0] = e.key_[0]; key_[1] = e.key_[1];
+            }
+            inline real_t Eval( index_t y, index_t x ) const{
+                const uint64_t i = base_ + static_cast<uint64_t>( y ) * width_ + x;
+                uint32_t w[4];
+                philox::Block( w, i >> 2, key_ );
+                return dist_.Eval( w, i );
+            }
+        private:
+            Dist dist_;
+            uint32_t key_[2];
+            uint64_t base_;
+            index_t width_;
+        };
+    }; // namespace expr
+
+#if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+    namespace expr{
+        template<typename Dist, int dim>
+        class SSEPlan< RandomExp<Dist,dim> >{
+        public:
+            SSEPlan( const RandomExp<Dist,dim> &e )
+                :plan_(e), dist_(e.dist_), base_(e.base_), width_(e.shape_[0]){
+                key_[0] = e.key_[0]; key_[1] = e.key_[1];
+            }
+            // position of [y][x] is multiple of 4, guaranteed by SSEAlignCheck, so the 4 values come from one block
+            MSHADOW_CINLINE sse2::FVec<real_t> EvalSSE( index_t y, index_t x ) const{
+                uint32_t w[4];
+                philox::Block( w, ( base_ + static_cast<uint64_t>( y ) * width_ + x ) >> 2, key_ );
+                return sse2::FVec<real_t>( dist_.MapSSE( w ) );
+            }
+            MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const{
+                return plan_.Eval( y, x );
+            }
+        private:
+            Plan< RandomExp<Dist,dim> > plan_;
+            Dist dist_;
+            uint32_t key_[2];
+            uint64_t base_;
+            index_t width_;
+        };
+        template<typename Dist, int dim>
+        struct SSECheck< MakeTensorExp< RandomExp<Dist,dim>, cpu, dim > >{
+            const static bool kPass = true;
+        };
+        template<typename Dist, int dim>
+        struct SSEAlignCheck< dim, MakeTensorExp< RandomExp<Dist,dim>, cpu, dim > >{
+            inline static bool Check( const MakeTensorExp< RandomExp<Dist,dim>, cpu, dim > &t ){
+                return t.shape_[0] % 4 == 0;
+            }
+        };
+    }; // namespace expr
+#endif
+
+    /*!
+     * \brief bit packed 0/1 mask of a tensor viewed as 2D, used to store dropout mask, 
+     *        each row starts at a new 32-bit word, so rows can be written by different threads
+     */
+    struct BitMask{
+        /*! \brief shape of the masked tensor, after FlatTo2D */
+        Shape<2> shape;
+        /*! \brief number of words in each row */
+        index_t stride;
+        /*! \brief packed bits, bit x%32 of word [y*stride+x/32] is element [y][x] */
+        std::vector<uint32_t> bits;
+        /*! \brief allocate space for mask of shape s */
+        inline void Resize( const Shape<2> &s ){
+            shape = s;
+            stride = ( s[0] + 31 ) / 32;
+            bits.resize( static_cast<size_t>( stride ) * s[1] );
+        }
+        /*! \brief value of element [y][x] */
+        inline bool Get( index_t y, index_t x ) const{
+            return ( bits[ y * stride + ( x >> 5 ) ] >> ( x & 31 ) ) & 1;
+        }
+    };
+
+    /*!
      * \brief random number generator 
      * \tparam Device the device of random number generator
      */
@@ -30,10 +402,8 @@ namespace mshadow {
             #if MSHADOW_USE_MKL
             int status = vslNewStream(&vStream_, VSL_BRNG_MT19937, seed);
             utils::Assert( status == VSL_STATUS_OK, "MKL VSL Random engine failed to be initialized.\n" );
-            #else
-            srand(seed);
             #endif
-            buffer_.Resize( Shape1( kRandBufferSize ) );
+            this->SeedPhilox( seed );
         }
         ~Random<cpu>() {
             #if MSHADOW_USE_MKL
@@ -50,9 +420,8 @@ namespace mshadow {
             utils::Assert(status == VSL_STATUS_OK);
             status = vslNewStream(&vStream_, VSL_BRNG_MT19937, seed);
             utils::Assert(status == VSL_STATUS_OK);
-            #else
-            srand( seed );
             #endif
+            this->SeedPhilox( seed );
         }
         /*!
          * \brief generate data from uniform [a,b)
@@ -63,22 +432,19 @@ namespace mshadow {
          */
         template<int dim>
         inline void SampleUniform( Tensor<cpu, dim> &dst, real_t a=0.0f, real_t b=1.0f ) {
+            #if MSHADOW_USE_MKL
             Tensor<cpu, 2> mat = dst.FlatTo2D();
             for ( index_t i = 0; i < mat.shape[1]; ++i ) {
-                #if MSHADOW_USE_MKL
                 #if MSHADOW_SINGLE_PRECISION
                 int status = vsRngUniform( 0, vStream_, mat.shape[0], mat[i].dptr, a, b );
                 #else
                 int status = vdRngUniform( 0, vStream_, mat.shape[0], mat[i].dptr, a, b );
                 #endif
                 utils::Assert(status == VSL_STATUS_OK, "Failed to generate random number by MKL.\n" );
-                #else
-                // use stdlib
-                for ( index_t j = 0; j < mat.shape[0]; ++j ) {
-                    mat[i][j] = this->RandNext()*(b-a) + a;
-                }
-                #endif
             }
+            #else
+            this->SampleByPhilox( dst, philox::UniformDist( a, b ) );
+            #endif
         }
         /*!
          * \brief generate data from standard gaussian
@@ -92,93 +458,191 @@ namespace mshadow {
             if( sigma <= 0.0f ) {
                 dst = mu; return;
             }
+            #if MSHADOW_USE_MKL
             Tensor<cpu, 2> mat = dst.FlatTo2D();
             for (index_t i = 0; i < mat.shape[1]; ++i) {
-                #if MSHADOW_USE_MKL
                 #if MSHADOW_SINGLE_PRECISION
                 int status = vsRngGaussian( 0, vStream_, mat.shape[0], mat[i].dptr, mu, sigma );
                 #else
                 int status = vdRngGaussian( 0, vStream_, mat.shape[0], mat[i].dptr, mu, sigma );
                 #endif
                 utils::Assert(status == VSL_STATUS_OK, "Failed to generate random number by MKL.\n" );
-                #else
-                real_t g1 = 0.0f, g2 = 0.0f;
-                for (index_t j = 0; j < mat.shape[0]; ++j) {
-                    if( (j & 1) == 0 ){
-                        this->SampleNormal2D( g1, g2 );
-                        mat[i][j] = mu + g1 * sigma;
-                    }else{
-                        mat[i][j] = mu + g2 * sigma;
-                    }
-                }
-                #endif
             }
+            #else
+            this->SampleByPhilox( dst, philox::GaussianDist( mu, sigma ) );
+            #endif
         }
         /*!
-         * \brief return a temporal expression storing standard gaussian random variables
-         *        the temporal tensor is only valid before next call of gaussian or uniform
-         *        can be used as part of expression
-         *  Caution: this means expression such as A = gaussian(s1) * gaussian(s2) will give invalid result,
-         *           since second call of gaussian(s2) makes gaussian(s1) invalid
-         *           A = gaussian(s1)*B+C; is correct; use one gaussian/uniform in each expression
+         * \brief return an expression of standard gaussian random variables, 
+         *        values are generated lazily when the expression is evaluated, no temporal space is allocated,
+         *        each call takes a new part of the random stream, so the expression stays valid after later calls,
+         *        e.g. A = gaussian(s1) * gaussian(s2) gives independent values
+         *        the values are generated by built-in generator, also in MKL build
          * \param shape shape of the tensor
          * \tparam dim dimension of tensor
          */
         template<int dim>
-        inline expr::ReshapeExp<Tensor<cpu,1>,dim,1> gaussian( Shape<dim> shape ){
-            buffer_.Resize( Shape1( shape.Size() ) );
-            this->SampleGaussian( buffer_, 0.0f, 1.0f );
-            return expr::reshape( buffer_, shape );
+        inline expr::RandomExp<philox::GaussianDist,dim> gaussian( Shape<dim> shape ){
+            return expr::RandomExp<philox::GaussianDist,dim>( shape, philox::GaussianDist( 0.0f, 1.0f ), key_, this->Advance( shape.Size() ) );
         }
         /*!
-         * \brief return a temporal expression storing standard uniform [0,1)
-         *        the temporal tensor is only valid before next call of gaussian or uniform
-         *        can be used as part of expression
-         *  Caution: this means expression such as A = gaussian(s1) * gaussian(s2) will give invalid result,
-         *           since second call of gaussian(s2) makes gaussian(s1) invalid
-         *           A = gaussian(s1)*B+C; is correct; use one gaussian/uniform in each expression
+         * \brief return an expression of standard uniform [0,1),
+         *        values are generated lazily when the expression is evaluated, no temporal space is allocated,
+         *        each call takes a new part of the random stream, so the expression stays valid after later calls
+         *        the values are generated by built-in generator, also in MKL build
          * \param shape shape of the tensor
          * \tparam dim dimension of tensor
          */
         template<int dim>
-        inline expr::ReshapeExp<Tensor<cpu,1>,dim,1> uniform( Shape<dim> shape ){
-            buffer_.Resize( Shape1( shape.Size() ) );
-            this->SampleUniform( buffer_, 0.0f, 1.0f );
-            return expr::reshape( buffer_, shape );
+        inline expr::RandomExp<philox::UniformDist,dim> uniform( Shape<dim> shape ){
+            return expr::RandomExp<philox::UniformDist,dim>( shape, philox::UniformDist( 0.0f, 1.0f ), key_, this->Advance( shape.Size() ) );
+        }
+        /*!
+         * \brief dropout, in one pass: keep each element with probability pkeep and scale it by 1/pkeep, set others to 0,
+         *        the decision is recorded in mask for DropoutBackprop, using 1 bit per element
+         *        element kept equals to SampleUniform( u ), u < pkeep, generated from the built-in generator, also in MKL build
+         * \param data data to apply dropout, modified in place
+         * \param mask output mask, resized to shape of data
+         * \param pkeep probability of keeping an element, in (0,1]
+         * \tparam dim dimension of tensor
+         */
+        template<int dim>
+        inline void Dropout( Tensor<cpu,dim> data, BitMask &mask, real_t pkeep ){
+            utils::Assert( pkeep > 0.0f && pkeep <= 1.0f, "Dropout: pkeep must be in (0,1]" );
+            Tensor<cpu,2> mat = data.FlatTo2D();
+            mask.Resize( mat.shape );
+            const uint64_t begin = this->Advance( mat.shape.Size() );
+            // uniform value (u>>8)*2^-24 < pkeep iff (u>>8) < ceil(pkeep*2^24)
+            const uint32_t thresh = static_cast<uint32_t>( std::ceil( static_cast<double>( pkeep ) * 16777216.0 ) );
+            const real_t scale = 1.0f / pkeep;
+            const index_t width = mat.shape[0];
+            const int nrow = static_cast<int>( mat.shape[1] );
+            #pragma omp parallel for schedule(static) if( mat.shape.Size() > philox::kParallelChunk )
+            for( int y = 0; y < nrow; ++ y ){
+                real_t *row = mat[y].dptr;
+                uint32_t *mrow = &mask.bits[ static_cast<size_t>( y ) * mask.stride ];
+                std::fill( mrow, mrow + mask.stride, 0U );
+                const uint64_t pos = begin + static_cast<uint64_t>( y ) * width;
+                uint32_t w[ philox::kBatch ];
+                // process the row in pieces that lie in one batch of the stream
+                for( index_t x = 0; x < width; ){
+                    const uint64_t bstart = ( pos + x ) / philox::kBatch * philox::kBatch;
+                    const index_t off = static_cast<index_t>( pos + x - bstart );
+                    const index_t n = std::min( philox::kBatch - off, width - x );
+                    philox::GenWords( w, bstart, key_ );
+                    index_t i = 0;
+                    #if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+                    for( ; i + 4 <= n; i += 4 ){
+                        __m128i u = _mm_loadu_si128( reinterpret_cast<const __m128i*>( w + off + i ) );
+                        __m128 keep = _mm_castsi128_ps( _mm_cmplt_epi32( _mm_srli_epi32( u, 8 ), _mm_set1_epi32( static_cast<int>( thresh ) ) ) );
+                        __m128 v = _mm_mul_ps( _mm_loadu_ps( row + x + i ), _mm_set1_ps( scale ) );
+                        _mm_storeu_ps( row + x + i, _mm_and_ps( v, keep ) );
+                        SetBits( mrow, x + i, static_cast<uint32_t>( _mm_movemask_ps( keep ) ), 4 );
+                    }
+                    #endif
+                    for( ; i < n; ++ i ){
+                        const uint32_t keep = ( w[ off + i ] >> 8 ) < thresh ? 1U : 0U;
+                        row[ x + i ] = keep ? row[ x + i ] * scale : 0.0f;
+                        SetBits( mrow, x + i, keep, 1 );
+                    }
+                    x += n;
+                }
+            }
         }
     private:
-        /*! \brief get next random number from rand */
-        inline real_t RandNext( void ){
-            return static_cast<real_t>(rand()) / (static_cast<real_t>(RAND_MAX)+1.0f);
+        /*! \brief set nbits bits of mask row starting at bit x, the bits may cross a word boundary */
+        inline static void SetBits( uint32_t *mrow, index_t x, uint32_t bits, index_t nbits ){
+            const index_t sh = x & 31;
+            mrow[ x >> 5 ] |= bits << sh;
+            if( sh + nbits > 32 ) mrow[ ( x >> 5 ) + 1 ] |= bits >> ( 32 - sh );
         }
-        /*! \brief return a real numer uniform in (0,1) */
-        inline real_t RandNext2( void ){
-            return (static_cast<real_t>( rand() ) + 1.0 ) / (static_cast<real_t>(RAND_MAX) + 2.0);
+        /*! \brief seed the built-in generator */
+        inline void SeedPhilox( int seed ){
+            key_[0] = static_cast<uint32_t>( seed );
+            key_[1] = 0x6A09E667U;
+            counter_ = 0;
         }
         /*!
-         * \brief sample iid xx,yy ~N(0,1)
-         * \param xx first  gaussian output
-         * \param yy second gaussian output
+         * \brief reserve size positions of the built-in stream, next call starts from a fresh batch
+         * \return start position of the reserved part
          */
-        inline void SampleNormal2D( real_t &xx, real_t &yy ){
-            real_t x,y,s;
-            do{
-                x = 2.0f * RandNext2() - 1.0f;
-                y = 2.0f * RandNext2() - 1.0f;
-                s = x*x + y*y;
-            }while( s >= 1.0f || s == 0.0f );
-            real_t t = std::sqrt( -2.0f * std::log( s ) / s ) ;
-            xx = x * t; yy = y * t;
+        inline uint64_t Advance( size_t size ){
+            const uint64_t begin = counter_;
+            counter_ += ( size + philox::kBatch - 1 ) / philox::kBatch * philox::kBatch;
+            return begin;
+        }
+        /*!
+         * \brief fill dst with the built-in generator, elements of dst take consecutive positions of the stream 
+         * \param dst destination
+         * \param dist distribution
+         */
+        template<int dim, typename Dist>
+        inline void SampleByPhilox( Tensor<cpu,dim> &dst, const Dist &dist ){
+            Tensor<cpu,2> mat = dst.FlatTo2D();
+            const uint64_t begin = this->Advance( mat.shape.Size() );
+            // each element takes a fixed stream position, so the result is the same for any number of threads
+            if( mat.shape.stride_ == mat.shape[0] || mat.shape[1] == 1 ){
+                const size_t size = mat.shape.Size();
+                const int nchunk = static_cast<int>( ( size + philox::kParallelChunk - 1 ) / philox::kParallelChunk );
+                #pragma omp parallel for schedule(static) if( nchunk > 1 )
+                for( int c = 0; c < nchunk; ++ c ){
+                    const size_t start = static_cast<size_t>( c ) * philox::kParallelChunk;
+                    philox::Fill( mat.dptr + start, begin + start, std::min( size - start, static_cast<size_t>( philox::kParallelChunk ) ), key_, dist );
+                }
+            }else{
+                const int nrow = static_cast<int>( mat.shape[1] );
+                #pragma omp parallel for schedule(static) if( mat.shape.Size() > philox::kParallelChunk )
+                for( int i = 0; i < nrow; ++ i ){
+                    philox::Fill( mat[i].dptr, begin + static_cast<uint64_t>( i ) * mat.shape[0], mat.shape[0], key_, dist );
+                }
+            }
         }
     private:
         #if MSHADOW_USE_MKL
         /*! \brief stream used by MKL VSL */
         VSLStreamStatePtr vStream_;
         #endif
-        /*! \brief temporal space used to store random numbers */
-        TensorContainer<cpu,1> buffer_;
+        /*! \brief key of built-in generator */
+        uint32_t key_[2];
+        /*! \brief position of built-in generator in its stream */
+        uint64_t counter_;
     }; // class Random<cpu>
 
+    /*!
+     * \brief backprop of Random<cpu>::Dropout, in one pass: scale the gradient of kept elements by 1/pkeep, set others to 0
+     * \param grad gradient to the output of dropout, modified in place to gradient to the input
+     * \param mask mask recorded by Dropout
+     * \param pkeep probability of keeping an element, same as in Dropout
+     * \tparam dim dimension of tensor
+     */
+    template<int dim>
+    inline void DropoutBackprop( Tensor<cpu,dim> grad, const BitMask &mask, real_t pkeep ){
+        Tensor<cpu,2> mat = grad.FlatTo2D();
+        utils::Assert( mat.shape == mask.shape, "DropoutBackprop: shape of mask and gradient do not match" );
+        const real_t scale = 1.0f / pkeep;
+        const int nrow = static_cast<int>( mat.shape[1] );
+        #pragma omp parallel for schedule(static) if( mat.shape.Size() > philox::kParallelChunk )
+        for( int y = 0; y < nrow; ++ y ){
+            real_t *row = mat[y].dptr;
+            const uint32_t *mrow = &mask.bits[ static_cast<size_t>( y ) * mask.stride ];
+            index_t x = 0;
+            #if MSHADOW_USE_SSE && MSHADOW_SINGLE_PRECISION
+            // expand 4 bits at a time into lane masks
+            const __m128i lane = _mm_set_epi32( 8, 4, 2, 1 );
+            for( ; x + 4 <= mat.shape[0]; x += 4 ){
+                const uint32_t b = ( mrow[ x >> 5 ] >> ( x & 31 ) ) | ( ( x & 31 ) > 28 ? mrow[ ( x >> 5 ) + 1 ] << ( 32 - ( x & 31 ) ) : 0U );
+                const __m128i m = _mm_and_si128( _mm_set1_epi32( static_cast<int>( b ) ), lane );
+                __m128 keep = _mm_castsi128_ps( _mm_cmpeq_epi32( m, lane ) );
+                __m128 v = _mm_mul_ps( _mm_loadu_ps( row + x ), _mm_set1_ps( scale ) );
+                _mm_storeu_ps( row + x, _mm_and_ps( v, keep ) );
+            }
+            #endif
+            for( ; x < mat.shape[0]; ++ x ){
+                row[x] = ( ( mrow[ x >> 5 ] >> ( x & 31 ) ) & 1 ) ? row[x] * scale : 0.0f;
+            }
+        }
+    }
+
 #ifdef __CUDACC__
 
     /*! \brief GPU random number generator */
@@ -0,0 +1,68 @@
+#ifndef MSHADOW_TENSOR_SERIAL_H
+#define MSHADOW_TENSOR_SERIAL_H
+/*!
+ * \file tensor_serial.h
+ * \brief helpers shared by the file formats: CRC32 checksum, and appending POD values to a record buffer
+ */
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include "tensor_base.h"
+
+namespace mshadow{
+    namespace utils{
+        /*! \brief table of CRC32, IEEE polynomial, 8 tables for slicing by 8 */
+        struct CRC32Table{
+            uint32_t t[8][256];
+            CRC32Table( void ){
+                for( uint32_t i = 0; i < 256; ++ i ){
+                    uint32_t c = i;
+                    for( int k = 0; k < 8; ++ k ){
+                        c = ( c & 1 ) ? ( 0xEDB88320U ^ ( c >> 1 ) ) : ( c >> 1 );
+                    }
+                    t[0][i] = c;
+                }
+                for( uint32_t i = 0; i < 256; ++ i ){
+                    for( int k = 1; k < 8; ++ k ){
+                        t[k][i] = ( t[k-1][i] >> 8 ) ^ t[0][ t[k-1][i] & 0xFF ];
+                    }
+                }
+            }
+            /*! \brief get the global table */
+            inline static const CRC32Table &Get( void ){
+                static CRC32Table inst;
+                return inst;
+            }
+        };
+        /*!
+         * \brief update CRC32 checksum with a block of data
+         * \param crc checksum of previous data, 0 for start
+         * \param data pointer to data
+         * \param size number of bytes
+         * \return checksum of previous data followed by the block
+         */
+        inline uint32_t CRC32( uint32_t crc, const void *data, size_t size ){
+            const CRC32Table &tab = CRC32Table::Get();
+            const unsigned char *p = static_cast<const unsigned char*>( data );
+            crc = ~crc;
+            // process 8 bytes each step
+            for( ; size >= 8; size -= 8, p += 8 ){
+                uint32_t lo, hi;
+                memcpy( &lo, p, 4 ); memcpy( &hi, p + 4, 4 );
+                lo ^= crc;
+                crc = tab.t[7][ lo & 0xFF ] ^ tab.t[6][ ( lo >> 8 ) & 0xFF ] ^ tab.t[5][ ( lo >> 16 ) & 0xFF ] ^ tab.t[4][ lo >> 24 ] ^
+                      tab.t[3][ hi & 0xFF ] ^ tab.t[2][ ( hi >> 8 ) & 0xFF ] ^ tab.t[1][ ( hi >> 16 ) & 0xFF ] ^ tab.t[0][ hi >> 24 ];
+            }
+            for( ; size != 0; -- size, ++ p ){
+                crc = tab.t[0][ ( crc ^ *p ) & 0xFF ] ^ ( crc >> 8 );
+            }
+            return ~crc;
+        }
+        /*! \brief append a POD value to buffer, in native byte order */
+        template<typename T>
+        inline void Append( std::string &buf, const T &v ){
+            buf.append( reinterpret_cast<const char*>( &v ), sizeof(T) );
+        }
+    };
+};
+#endif // MSHADOW_TENSOR_SERIAL_H
@@ -0,0 +1,185 @@
+#ifndef MSHADOW_TENSOR_SHARED_H
+#define MSHADOW_TENSOR_SHARED_H
+/*!
+ * \file tensor_shared.h
+ * \brief reference counted tensor storage, views of the storage keep it alive
+ */
+#include "tensor.h"
+
+namespace mshadow{
+    /*!
+     * \brief storage block shared by SharedTensor, space is freed when refcount_ drops to 0
+     * \tparam Device which device the space is on
+     * \tparam DType element type of the space
+     */
+    template<typename Device, typename DType = real_t>
+    struct SharedChunk{
+        /*! \brief allocated space */
+        Tensor<Device,2,DType> space;
+        /*! \brief number of SharedTensor referring to this chunk */
+        int refcount_;
+    };
+
+    /*!
+     * \brief tensor that shares a reference counted storage with other SharedTensor,
+     *        slices, reshapes and sub-tensors taken from it are also SharedTensor, and refer to the same storage,
+     *        the storage is freed when the last SharedTensor referring to it is destroyed.
+     *        assignment between SharedTensor rebinds the handle, same as Tensor, no content is copied.
+     *        Caution: the reference count is not thread safe, do not share one storage between threads
+     *                 by creating and destroying views concurrently
+     *
+     * \tparam Device which device the tensor is on
+     * \tparam dimension dimension of the tensor
+     * \tparam DType element type of the tensor
+     */
+    template<typename Device, int dimension, typename DType = real_t>
+    class SharedTensor: public Tensor<Device,dimension,DType>{
+    public:
+        /*! \brief type of storage chunk */
+        typedef SharedChunk<Device,DType> Chunk;
+    public:
+        /*! \brief default constructor, empty tensor with no storage */
+        SharedTensor( void ){
+            chunk_ = NULL;
+            this->dptr = NULL;
+            this->shape[0] = 0;
+            this->shape.stride_ = 0;
+        }
+        /*!
+         * \brief constructor, allocate a new storage with padding alignment
+         * \param shape shape of tensor
+         */
+        SharedTensor( const Shape<dimension> &shape ){
+            this->Alloc( shape, MSHADOW_ALLOC_PAD );
+        }
+        /*!
+         * \brief constructor, allocate a new storage and initialize it
+         * \param shape shape of tensor
+         * \param initv initial value
+         * \param pad whether use padding alignment in space allocation
+         */
+        SharedTensor( const Shape<dimension> &shape, typename DataType<DType>::ComputeType initv, bool pad = MSHADOW_ALLOC_PAD ){
+            if( initv == DType(0) ){
+                this->Alloc( shape, pad, true );
+            }else{
+                this->Alloc( shape, pad );
+                (*this) = initv;
+            }
+        }
+        /*! \brief copy constructor, share the storage of src */
+        SharedTensor( const SharedTensor<Device,dimension,DType> &src )
+            :Tensor<Device,dimension,DType>( src.dptr, src.shape ), chunk_( src.chunk_ ){
+            this->Retain();
+        }
+        /*!
+         * \brief construct a view of existing chunk, used to create views
+         * \param dptr data pointer inside chunk
+         * \param shape shape of the view
+         * \param chunk the chunk to be shared
+         */
+        SharedTensor( DType *dptr, const Shape<dimension> &shape, Chunk *chunk )
+            :Tensor<Device,dimension,DType>( dptr, shape ), chunk_( chunk ){
+            this->Retain();
+        }
+        ~SharedTensor( void ){
+            this->Release();
+        }
+        /*! \brief rebind this handle to the storage of src */
+        inline SharedTensor<Device,dimension,DType>& operator=( const SharedTensor<Device,dimension,DType> &src ){
+            if( chunk_ != src.chunk_ ){
+                this->Release();
+                chunk_ = src.chunk_;
+                this->Retain();
+            }
+            this->dptr  = src.dptr;
+            this->shape = src.shape;
+            return *this;
+        }
+        /*! \return number of SharedTensor referring to the storage, 0 if no storage */
+        inline int RefCount( void ) const{
+            return chunk_ == NULL ? 0 : chunk_->refcount_;
+        }
+        /*!
+         * \brief shared version of Tensor::FlatTo2D
+         * \return view that collapses the higher dimensions together
+         */
+        inline SharedTensor<Device,2,DType> FlatTo2D( void ) const{
+            return SharedTensor<Device,2,DType>( this->dptr, this->shape.FlatTo2D(), chunk_ );
+        }
+        /*!
+         * \brief shared version of Tensor::Slice, slice the tensor in highest dimension [begin,end)
+         * \param begin begin position of slice
+         * \param end end position of slice
+         * \return view of the slice
+         */
+        inline SharedTensor<Device,dimension,DType> Slice( index_t begin, index_t end ) const{
+            Tensor<Device,dimension,DType> t = Tensor<Device,dimension,DType>::Slice( begin, end );
+            return SharedTensor<Device,dimension,DType>( t.dptr, t.shape, chunk_ );
+        }
+        /*!
+         * \brief shared version of Tensor::operator[], get a element of dimension - 1
+         * \param idx index
+         * \return view of the sub tensor
+         */
+        inline SharedTensor<Device,dimension-1,DType> SubTensor( index_t idx ) const{
+            Tensor<Device,dimension-1,DType> t = Tensor<Device,dimension,DType>::operator[]( idx );
+            return SharedTensor<Device,dimension-1,DType>( t.dptr, t.shape, chunk_ );
+        }
+        /*!
+         * \brief view the content in another shape, the tensor must be continuous in memory
+         * \param shape target shape, shape.Size() must equal to the current size
+         * \return view of the reshaped tensor
+         * \tparam dimdst target dimension
+         */
+        template<int dimdst>
+        inline SharedTensor<Device,dimdst,DType> Reshape( const Shape<dimdst> &shape ) const{
+            utils::Assert( shape.Size() == this->shape.Size(), "SharedTensor::Reshape: size must match" );
+            utils::Assert( this->shape.stride_ == this->shape[0] || this->shape.FlatTo2D()[1] == 1,
+                           "SharedTensor::Reshape: only continuous tensor can be reshaped" );
+            Shape<dimdst> s = shape;
+            s.stride_ = s[0];
+            return SharedTensor<Device,dimdst,DType>( this->dptr, s, chunk_ );
+        }
+    public:
+        // functions to fit exp template
+        inline Tensor<Device,dimension,DType>& operator=( typename DataType<DType>::ComputeType s ){
+            return this->__assign( s );
+        }
+        template<typename E>
+        inline Tensor<Device,dimension,DType>& operator=( const expr::Exp<E,expr::type::kMapper> &exp ){
+            return this->__assign( exp );
+        }
+        template<typename E>
+        inline Tensor<Device,dimension,DType>& operator=( const expr::Exp<E,expr::type::kComplex> &exp ){
+            return this->__assign( exp );
+        }
+    private:
+        /*! \brief the chunk referred by this tensor */
+        Chunk *chunk_;
+    private:
+        inline void Alloc( const Shape<dimension> &shape, bool pad, bool zero = false ){
+            chunk_ = new Chunk();
+            chunk_->refcount_ = 1;
+            chunk_->space.shape = shape.FlatTo2D();
+            if( zero ){
+                mshadow::AllocZeroSpace( chunk_->space, pad );
+            }else{
+                mshadow::AllocSpace( chunk_->space, pad );
+            }
+            this->dptr  = chunk_->space.dptr;
+            this->shape = shape;
+            this->shape.stride_ = chunk_->space.shape.stride_;
+        }
+        inline void Retain( void ){
+            if( chunk_ != NULL ) ++ chunk_->refcount_;
+        }
+        inline void Release( void ){
+            if( chunk_ != NULL && -- chunk_->refcount_ == 0 ){
+                mshadow::FreeSpace( chunk_->space );
+                delete chunk_;
+            }
+            chunk_ = NULL;
+        }
+    };
+};// namespace mshadow
+#endif // MSHADOW_TENSOR_SHARED_H
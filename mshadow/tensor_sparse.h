@@ -0,0 +1,327 @@
+#ifndef MSHADOW_TENSOR_SPARSE_H
+#define MSHADOW_TENSOR_SPARSE_H
+/*!
+ * \file tensor_sparse.h
+ * \brief sparse matrices on cpu: CSRTensor for sparse input, RowSparseTensor for gradient of weight of sparse input,
+ *        the cost of dot with sparse operand is proportional to the number of non-zeros
+ *
+ *  usage, first layer of a network with sparse input:
+ *    hidden = dot( csr, wmat );                 // forward, csr is ( nbatch, ninput ), wmat is ( ninput, nhidden )
+ *    gwmat  = dot( csr.T(), ghidden );          // backward, gwmat is RowSparseTensor, only rows of features in batch are stored
+ *    UpdateSGD( wmat, gwmat, eta, wd );         // update only the rows in gwmat
+ *  supported forms are dot( csr, dense ) and dot( csr.T(), dense ), saved to Tensor<cpu,2>, and dot( csr.T(), dense ) saved to RowSparseTensor
+ */
+#include <vector>
+#include <algorithm>
+#include "tensor.h"
+
+namespace mshadow{
+    /*!
+     * \brief compressed sparse row matrix on cpu, row y has entries ( col_idx[k], value[k] ) for k in [ row_ptr[y], row_ptr[y+1] ),
+     *        shape[1] is number of rows and shape[0] is number of columns, same as Tensor<cpu,2>,
+     *        CSRTensor does not own the space, see CSRContainer
+     */
+    struct CSRTensor{
+        /*! \brief shape of the matrix */
+        Shape<2> shape;
+        /*! \brief start of each row in col_idx and value, shape[1] + 1 elements */
+        index_t *row_ptr;
+        /*! \brief column index of each entry */
+        index_t *col_idx;
+        /*! \brief value of each entry */
+        real_t *value;
+        /*! \brief default constructor */
+        CSRTensor( void ){}
+        /*! \brief constructor from data pointers */
+        CSRTensor( const Shape<2> &shape, index_t *row_ptr, index_t *col_idx, real_t *value )
+            :shape(shape), row_ptr(row_ptr), col_idx(col_idx), value(value){}
+        /*! \return number of non-zero entries */
+        inline index_t NumNonZero( void ) const{
+            return row_ptr[ shape[1] ] - row_ptr[0];
+        }
+        /*! \brief slice rows [begin,end), e.g. a mini-batch of a dataset, entries are shared */
+        inline CSRTensor Slice( index_t begin, index_t end ) const{
+            return CSRTensor( Shape2( end - begin, shape[0] ), row_ptr + begin, col_idx, value );
+        }
+        /*! \brief transpose of the matrix, used as dot( csr.T(), dense ) */
+        inline expr::TransposeExp<CSRTensor> T( void ) const{
+            return expr::TransposeExp<CSRTensor>( *this );
+        }
+    };
+
+    /*! \brief CSR matrix that owns its space, rows are appended by PushRow */
+    class CSRContainer: public CSRTensor{
+    public:
+        /*!
+         * \brief constructor of empty matrix
+         * \param ncol number of columns
+         */
+        CSRContainer( index_t ncol = 0 ){
+            this->Clear( ncol );
+        }
+        CSRContainer( const CSRContainer &src )
+            :CSRTensor(src), row_ptr_(src.row_ptr_), col_idx_(src.col_idx_), value_(src.value_){
+            this->Sync();
+        }
+        inline CSRContainer &operator=( const CSRContainer &src ){
+            this->shape = src.shape;
+            row_ptr_ = src.row_ptr_; col_idx_ = src.col_idx_; value_ = src.value_;
+            this->Sync();
+            return *this;
+        }
+        /*! \brief remove all rows, and set number of columns */
+        inline void Clear( index_t ncol ){
+            row_ptr_.assign( 1, 0 );
+            col_idx_.clear(); value_.clear();
+            this->shape = Shape2( 0, ncol );
+            this->Sync();
+        }
+        /*!
+         * \brief append a row
+         * \param idx column index of entries, each less than number of columns
+         * \param val value of entries
+         * \param n number of entries
+         */
+        inline void PushRow( const index_t *idx, const real_t *val, index_t n ){
+            for( index_t i = 0; i < n; ++ i ){
+                utils::Assert( idx[i] < this->shape[0], "CSRContainer: column index exceed bound" );
+                col_idx_.push_back( idx[i] );
+                value_.push_back( val[i] );
+            }
+            row_ptr_.push_back( static_cast<index_t>( col_idx_.size() ) );
+            this->shape[1] += 1;
+            this->Sync();
+        }
+    private:
+        std::vector<index_t> row_ptr_, col_idx_;
+        std::vector<real_t> value_;
+        // point the tensor to the vectors, vectors can reallocate when rows are pushed
+        inline void Sync( void ){
+            this->row_ptr = &row_ptr_[0];
+            this->col_idx = col_idx_.size() != 0 ? &col_idx_[0] : NULL;
+            this->value = value_.size() != 0 ? &value_[0] : NULL;
+        }
+    };
+
+    /*!
+     * \brief row sparse matrix, rows in index are stored in data, other rows are zero,
+     *        e.g. gradient of weight whose input is sparse, dot( csr.T(), grad ) only has rows of features present in csr
+     */
+    struct RowSparseTensor{
+        /*! \brief shape of the full matrix */
+        Shape<2> shape;
+        /*! \brief index of stored rows, sorted and unique */
+        std::vector<index_t> index;
+        /*! \brief content of stored rows, data[i] is row index[i] of the full matrix */
+        TensorContainer<cpu,2> data;
+        /*! \brief default constructor */
+        RowSparseTensor( void ){
+            shape = Shape2( 0, 0 );
+        }
+        /*! \return number of stored rows */
+        inline index_t NumRow( void ) const{
+            return static_cast<index_t>( index.size() );
+        }
+        /*! \brief dst = dot( csr.T(), dense ) * scale, only rows of columns present in csr are stored */
+        inline RowSparseTensor &operator=( const expr::DotExp< CSRTensor, Tensor<cpu,2>, true, false > &exp );
+    };
+
+    /*!
+     * \brief CPU: copy row sparse matrix to dense matrix, rows not stored are set to zero
+     * \param dst destination, same shape as src
+     * \param src source
+     */
+    inline void Copy( Tensor<cpu,2> dst, const RowSparseTensor &src );
+
+    /*!
+     * \brief sgd update of the rows in grad, weight[r] -= eta * ( wd * weight[r] + grad[r] ),
+     *        rows not in grad are unchanged, so the cost is proportional to the number of rows in grad,
+     *        note the weight decay of a row is applied only when the row appears in grad
+     * \param weight weight to be updated
+     * \param grad row sparse gradient, same shape as weight
+     * \param eta learning rate
+     * \param wd weight decay
+     */
+    inline void UpdateSGD( Tensor<cpu,2> weight, const RowSparseTensor &grad, real_t eta, real_t wd = 0.0f );
+    /*!
+     * \brief momentum update of the rows in grad,
+     *        mom[r] = momentum * mom[r] - eta * ( wd * weight[r] + grad[r] ); weight[r] += mom[r],
+     *        the momentum of rows not in grad is kept as it is instead of decaying, so only rows in grad are touched
+     * \param weight weight to be updated
+     * \param mom momentum buffer, same shape as weight
+     * \param grad row sparse gradient, same shape as weight
+     * \param eta learning rate
+     * \param momentum momentum
+     * \param wd weight decay
+     */
+    inline void UpdateMomentum( Tensor<cpu,2> weight, Tensor<cpu,2> mom, const RowSparseTensor &grad,
+                                real_t eta, real_t momentum, real_t wd = 0.0f );
+
+    /*! \brief namespace of helpers of sparse matrix */
+    namespace sparse{
+        /*! \brief y += a * x for n elements, SSE is used when x and y are aligned */
+        inline void Axpy( real_t *y, const real_t *x, real_t a, index_t n ){
+            index_t i = 0;
+            #if MSHADOW_USE_SSE
+            if( sse2::CheckAlign( y ) && sse2::CheckAlign( const_cast<real_t*>( x ) ) ){
+                const sse2::FVec<real_t> va( a );
+                const index_t xlen = sse2::LowerAlign( n, sizeof(real_t) );
+                for( ; i < xlen; i += sse2::FVec<real_t>::kSize ){
+                    sse2::FVec<real_t> ans = sse2::SSEOp<op::plus>::Map( sse2::FVec<real_t>( y + i ),
+                                                                         sse2::SSEOp<op::mul>::Map( va, sse2::FVec<real_t>( x + i ) ) );
+                    ans.Store( y + i );
+                }
+            }
+            #endif
+            for( ; i < n; ++ i ) y[i] += a * x[i];
+        }
+        /*! \brief entry of sparse matrix */
+        struct Entry{
+            index_t col, row;
+            real_t value;
+            inline bool operator<( const Entry &b ) const{
+                return col < b.col || ( col == b.col && row < b.row );
+            }
+        };
+        /*!
+         * \brief get entries of csr sorted by column, entries of the same column are contiguous,
+         *        so the rows of csr.T() can be processed independently
+         * \param csr the matrix
+         * \param entries sorted entries, row is relative to the first row of csr
+         * \param group start of each column in entries, with a end mark
+         */
+        inline void SortByColumn( const CSRTensor &csr, std::vector<Entry> &entries, std::vector<index_t> &group ){
+            entries.resize( csr.NumNonZero() );
+            for( index_t y = 0, i = 0; y < csr.shape[1]; ++ y ){
+                for( index_t k = csr.row_ptr[y]; k < csr.row_ptr[y+1]; ++ k, ++ i ){
+                    entries[i].col = csr.col_idx[k]; entries[i].row = y; entries[i].value = csr.value[k];
+                }
+            }
+            std::sort( entries.begin(), entries.end() );
+            group.clear();
+            for( index_t i = 0; i < entries.size(); ++ i ){
+                if( i == 0 || entries[i].col != entries[i-1].col ) group.push_back( i );
+            }
+            group.push_back( static_cast<index_t>( entries.size() ) );
+        }
+        /*!
+         * \brief add scale * value * rhs[row] of entries of each group to one row of dst, each group is processed by one thread
+         * \param dst destination
+         * \param by_col whether the row of dst is the column of the group, otherwise it is the index of the group
+         */
+        inline void ScatterGroups( Tensor<cpu,2> dst, bool by_col, const std::vector<Entry> &entries, const std::vector<index_t> &group,
+                                   const Tensor<cpu,2> &rhs, real_t scale ){
+            const long ngroup = static_cast<long>( group.size() ) - 1;
+            #pragma omp parallel for schedule(dynamic, 16) if( static_cast<size_t>( entries.size() ) * rhs.shape[0] >= MSHADOW_PARALLEL_WORK_THRESHOLD )
+            for( long g = 0; g < ngroup; ++ g ){
+                real_t *drow = dst[ by_col ? entries[ group[g] ].col : static_cast<index_t>( g ) ].dptr;
+                for( index_t i = group[g]; i < group[g+1]; ++ i ){
+                    Axpy( drow, rhs[ entries[i].row ].dptr, scale * entries[i].value, rhs.shape[0] );
+                }
+            }
+        }
+    }; // namespace sparse
+
+    namespace expr{
+        // csr takes part in dot only
+        template<>
+        struct ExpInfo< CSRTensor >{
+            typedef real_t DType;
+            const static int kDim = 2;
+            const static int kDevMask = cpu::kDevMask;
+        };
+        /*! \brief dot operator def of sparse lhs */
+        template<typename TB>
+        inline DotExp<CSRTensor,TB,false,false> dot( const CSRTensor &lhs, const ContainerExp<TB,real_t> &rhs ){
+            return DotExp<CSRTensor,TB,false,false>( lhs, rhs.self(), 1.0f );
+        }
+        /*!
+         * \brief dst = dot( csr, rhs ), rows of dst are computed in parallel,
+         *        each row is the sum of rows of rhs selected by the entries of csr
+         */
+        template<typename SV>
+        struct ExpComplexEngine< SV, cpu, 2, real_t, DotExp< CSRTensor, Tensor<cpu,2>, false, false > >{
+            inline static void Eval( Tensor<cpu,2> &dst, const DotExp< CSRTensor, Tensor<cpu,2>, false, false > &exp ){
+                const CSRTensor &lhs = exp.lhs_;
+                const Tensor<cpu,2> &rhs = exp.rhs_;
+                utils::Assert( dst.shape[1] == lhs.shape[1] && dst.shape[0] == rhs.shape[0] \
+                               && lhs.shape[0] == rhs.shape[1], "dot-csr: matrix shape mismatch" );
+                const real_t alpha = exp.scale_ * SV::kAlphaBLAS;
+                const long nrow = static_cast<long>( dst.shape[1] );
+                #pragma omp parallel for schedule(dynamic, 16) if( static_cast<size_t>( lhs.NumNonZero() ) * rhs.shape[0] >= MSHADOW_PARALLEL_WORK_THRESHOLD )
+                for( long y = 0; y < nrow; ++ y ){
+                    Tensor<cpu,1> drow = dst[y];
+                    if( SV::kBetaBLAS == 0.0f ) drow = 0.0f;
+                    for( index_t k = lhs.row_ptr[y]; k < lhs.row_ptr[y+1]; ++ k ){
+                        sparse::Axpy( drow.dptr, rhs[ lhs.col_idx[k] ].dptr, alpha * lhs.value[k], rhs.shape[0] );
+                    }
+                }
+            }
+        };
+        /*!
+         * \brief dst = dot( csr.T(), rhs ), entries are grouped by column of csr, i.e. by row of dst,
+         *        so rows of dst are updated in parallel without conflict
+         */
+        template<typename SV>
+        struct ExpComplexEngine< SV, cpu, 2, real_t, DotExp< CSRTensor, Tensor<cpu,2>, true, false > >{
+            inline static void Eval( Tensor<cpu,2> &dst, const DotExp< CSRTensor, Tensor<cpu,2>, true, false > &exp ){
+                const CSRTensor &lhs = exp.lhs_;
+                const Tensor<cpu,2> &rhs = exp.rhs_;
+                utils::Assert( dst.shape[1] == lhs.shape[0] && dst.shape[0] == rhs.shape[0] \
+                               && lhs.shape[1] == rhs.shape[1], "dot-csr: matrix shape mismatch" );
+                if( SV::kBetaBLAS == 0.0f ) dst = 0.0f;
+                std::vector<sparse::Entry> entries;
+                std::vector<index_t> group;
+                sparse::SortByColumn( lhs, entries, group );
+                sparse::ScatterGroups( dst, true, entries, group, rhs, exp.scale_ * SV::kAlphaBLAS );
+            }
+        };
+    }; // namespace expr
+
+    inline RowSparseTensor &RowSparseTensor::operator=( const expr::DotExp< CSRTensor, Tensor<cpu,2>, true, false > &exp ){
+        const CSRTensor &lhs = exp.lhs_;
+        const Tensor<cpu,2> &rhs = exp.rhs_;
+        utils::Assert( lhs.shape[1] == rhs.shape[1], "dot-csr: matrix shape mismatch" );
+        std::vector<sparse::Entry> entries;
+        std::vector<index_t> group;
+        sparse::SortByColumn( lhs, entries, group );
+        this->shape = Shape2( lhs.shape[0], rhs.shape[0] );
+        this->index.resize( group.size() - 1 );
+        for( index_t g = 0; g < index.size(); ++ g ) index[g] = entries[ group[g] ].col;
+        this->data.Resize( Shape2( this->NumRow(), rhs.shape[0] ), 0.0f );
+        sparse::ScatterGroups( this->data, false, entries, group, rhs, exp.scale_ );
+        return *this;
+    }
+
+    inline void Copy( Tensor<cpu,2> dst, const RowSparseTensor &src ){
+        utils::Assert( dst.shape == src.shape, "Copy:shape mismatch" );
+        dst = 0.0f;
+        for( index_t i = 0; i < src.NumRow(); ++ i ){
+            Copy( dst[ src.index[i] ], src.data[i] );
+        }
+    }
+
+    // rows of grad are unique, so they are updated in parallel without conflict
+    inline void UpdateSGD( Tensor<cpu,2> weight, const RowSparseTensor &grad, real_t eta, real_t wd ){
+        utils::Assert( weight.shape == grad.shape, "UpdateSGD: shape mismatch" );
+        const long nrow = static_cast<long>( grad.NumRow() );
+        #pragma omp parallel for schedule(static) if( grad.data.shape.Size() >= MSHADOW_PARALLEL_WORK_THRESHOLD )
+        for( long i = 0; i < nrow; ++ i ){
+            Tensor<cpu,1> wrow = weight[ grad.index[i] ];
+            wrow -= eta * ( wd * wrow + grad.data[i] );
+        }
+    }
+    inline void UpdateMomentum( Tensor<cpu,2> weight, Tensor<cpu,2> mom, const RowSparseTensor &grad,
+                                real_t eta, real_t momentum, real_t wd ){
+        utils::Assert( weight.shape == grad.shape && mom.shape == grad.shape, "UpdateMomentum: shape mismatch" );
+        const long nrow = static_cast<long>( grad.NumRow() );
+        #pragma omp parallel for schedule(static) if( grad.data.shape.Size() >= MSHADOW_PARALLEL_WORK_THRESHOLD )
+        for( long i = 0; i < nrow; ++ i ){
+            Tensor<cpu,1> wrow = weight[ grad.index[i] ];
+            Tensor<cpu,1> mrow = mom[ grad.index[i] ];
+            mrow = momentum * mrow - eta * ( wd * wrow + grad.data[i] );
+            wrow += mrow;
+        }
+    }
+};
+#endif // MSHADOW_TENSOR_SPARSE_H
@@ -5,11 +5,17 @@
  * \brief support of sse2 optimization of some operations
  * \author Tianqi Chen
  */
+#include <cstring>
+#include <cstdlib>
 #ifdef __APPLE__
 #include <stdlib.h>
 #else
 #include <malloc.h>
 #endif
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include "tensor_expr.h"
 #include "tensor.h"
@@ -18,23 +24,67 @@ namespace mshadow {
     /*! \brief namespace to support sse2 vectorization */
     namespace sse2{
         /*! 
-         * \brief analog to cudaMallocPitch, allocate a aligned space with num_line * lspace cells
+         * \brief get the pitch of each line used by AlignedMallocPitch
+         *        lines that are wide enough are aligned to MSHADOW_CPU_ALIGN_BYTES, 
+         *        and shifted by one more cache line if the pitch would alias in cache, see MSHADOW_CPU_ANTI_ALIAS
+         * \param lspace number of cells required for each line
+         * \param num_line number of lines to be allocated
+         * \return pitch of each line
+         */
+        inline size_t GetAlignPitch( size_t lspace, size_t num_line ){
+            const size_t align = MSHADOW_CPU_ALIGN_BYTES;
+            if( num_line < 2 || lspace < MSHADOW_MIN_PAD_RATIO * align ){
+                return ((lspace+15) >> 4) << 4;
+            }
+            size_t pitch = (lspace + align - 1) / align * align;
+            #if MSHADOW_CPU_ANTI_ALIAS
+            if( (pitch & 4095) == 0 || ( pitch >= 512 && (pitch & (pitch-1)) == 0 ) ){
+                pitch += align;
+            }
+            #endif
+            return pitch;
+        }
+        /*! 
+         * \brief fill newly allocated space with zero, 
+         *        on linux, whole pages of large space are handed back to system by madvise, 
+         *        and come back as pre-zeroed pages when they are first touched, so no explicit write pass happens
+         * \param ptr start of space
+         * \param size number of bytes
+         */
+        inline void ZeroNewSpace( void *ptr, size_t size ){
+            char *begin = static_cast<char*>( ptr ), *end = begin + size;
+            #ifdef __linux__
+            const size_t page = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+            if( size >= ( 1UL << 20 ) ){
+                char *pbegin = reinterpret_cast<char*>( ( reinterpret_cast<size_t>( begin ) + page - 1 ) / page * page );
+                char *pend = reinterpret_cast<char*>( reinterpret_cast<size_t>( end ) / page * page );
+                if( madvise( pbegin, pend - pbegin, MADV_DONTNEED ) == 0 ){
+                    memset( begin, 0, pbegin - begin );
+                    memset( pend, 0, end - pend );
+                    return;
+                }
+            }
+            #endif
+            memset( begin, 0, end - begin );
+        }
+        /*! 
+         * \brief analog to cudaMallocPitch, allocate a aligned space with num_line * lspace cells,
+         *        the space is aligned to MSHADOW_CPU_ALIGN_BYTES and is freed by AlignedFree
          * \param pitch output parameter, the actuall space allocated for each line
          * \param lspace number of cells required for each line
          * \param num_line number of lines to be allocated
+         * \param zero whether the space need to be filled with zero, see ZeroNewSpace
          */
-        inline void* AlignedMallocPitch( size_t &pitch, size_t lspace, size_t num_line ){
-            pitch = ((lspace+15) >> 4) << 4;
+        inline void* AlignedMallocPitch( size_t &pitch, size_t lspace, size_t num_line, bool zero = false ){
+            pitch = GetAlignPitch( lspace, num_line );
             #ifdef _MSC_VER
-            void * res = _aligned_malloc( pitch*num_line, 16 ); 
-            #else
-            #ifdef __APPLE__
-            void *res = malloc( pitch * num_line );
+            void * res = _aligned_malloc( pitch*num_line, MSHADOW_CPU_ALIGN_BYTES ); 
             #else
-            void * res = memalign( 16, pitch*num_line ); 
-            #endif
+            void * res = NULL;
+            if( posix_memalign( &res, MSHADOW_CPU_ALIGN_BYTES, pitch*num_line ) != 0 ) res = NULL;
             #endif
             utils::Assert( res != NULL, "AlignedMallocPitch failed" );
+            if( zero ) ZeroNewSpace( res, pitch*num_line );
             return res;
         }
         /*! 
@@ -165,6 +215,141 @@ namespace mshadow{
         };
     };
 
+    namespace sse2{
+        /*! 
+         * \brief copy memory using non-temporal streaming store, the data written bypasses the cache
+         *        use it for block that is much larger than cache, to avoid evicting useful data
+         * \param dst destination, no alignment requirement
+         * \param src source, no alignment requirement
+         * \param size number of bytes to copy
+         */
+        inline void StreamCopy( void *dst, const void *src, size_t size ){
+            char *d = static_cast<char*>( dst );
+            const char *s = static_cast<const char*>( src );
+            // copy head until dst is aligned
+            size_t head = ( 16 - ((size_t)d & 15) ) & 15;
+            if( head > size ) head = size;
+            memcpy( d, s, head );
+            d += head; s += head; size -= head;
+            const size_t nvec = size >> 4;
+            for( size_t i = 0; i < nvec; ++ i ){
+                _mm_stream_si128( reinterpret_cast<__m128i*>( d ) + i,
+                                  _mm_loadu_si128( reinterpret_cast<const __m128i*>( s ) + i ) );
+            }
+            memcpy( d + (nvec << 4), s + (nvec << 4), size & 15 );
+            _mm_sfence();
+        }
+        /*!
+         * \brief copy rows of src selected by index into continuous rows of dst, rows that come next are prefetched,
+         *        since the source rows are visited in random order, and hardware prefetcher can not predict them
+         * \param dst destination, i-th row starts at dst + i * dst_pitch
+         * \param dst_pitch pitch of dst in bytes
+         * \param src source, i-th row starts at src + i * src_pitch
+         * \param src_pitch pitch of src in bytes
+         * \param index rows to copy
+         * \param nrow number of rows to copy
+         * \param size number of bytes in each row
+         */
+        inline void GatherRows( char *dst, size_t dst_pitch, const char *src, size_t src_pitch,
+                                const index_t *index, size_t nrow, size_t size ){
+            // number of rows to prefetch ahead
+            const size_t kAhead = 4;
+            for( size_t i = 0; i < nrow; ++ i ){
+                if( i + kAhead < nrow ){
+                    const char *r = src + index[ i + kAhead ] * src_pitch;
+                    for( size_t k = 0; k < size; k += 64 ) _mm_prefetch( r + k, _MM_HINT_T0 );
+                }
+                // memcpy of libc is vectorized, and faster than a hand written SSE2 loop
+                memcpy( dst + i * dst_pitch, src + index[i] * src_pitch, size );
+            }
+        }
+    }; // namespace sse2
+
+    namespace sse2{
+        // vectorized elementary functions, polynomial approximations from cephes library
+        /*! 
+         * \brief natural logarithm of each element
+         * \param x input, all elements must be positive normalized float
+         */
+        MSHADOW_CINLINE FVec<float> Log( const FVec<float> &src ){
+            const __m128 one = _mm_set1_ps( 1.0f );
+            __m128 x = src.data_;
+            // split into exponent and mantissa in [0.5,1)
+            __m128i emm0 = _mm_srli_epi32( _mm_castps_si128( x ), 23 );
+            x = _mm_and_ps( x, _mm_castsi128_ps( _mm_set1_epi32( ~0x7f800000 ) ) );
+            x = _mm_or_ps( x, _mm_set1_ps( 0.5f ) );
+            emm0 = _mm_sub_epi32( emm0, _mm_set1_epi32( 0x7f ) );
+            __m128 e = _mm_add_ps( _mm_cvtepi32_ps( emm0 ), one );
+            // if x < sqrt(0.5), e -= 1, x = x + x - 1, else x = x - 1
+            __m128 mask = _mm_cmplt_ps( x, _mm_set1_ps( 0.707106781186547524f ) );
+            __m128 tmp  = _mm_and_ps( x, mask );
+            x = _mm_sub_ps( x, one );
+            e = _mm_sub_ps( e, _mm_and_ps( one, mask ) );
+            x = _mm_add_ps( x, tmp );
+            __m128 z = _mm_mul_ps( x, x );
+            __m128 y = _mm_set1_ps( 7.0376836292E-2f );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -1.1514610310E-1f ) );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 1.1676998740E-1f ) );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -1.2420140846E-1f ) );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 1.4249322787E-1f ) );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -1.6668057665E-1f ) );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 2.0000714765E-1f ) );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -2.4999993993E-1f ) );
+            y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 3.3333331174E-1f ) );
+            y = _mm_mul_ps( _mm_mul_ps( y, x ), z );
+            y = _mm_add_ps( y, _mm_mul_ps( e, _mm_set1_ps( -2.12194440e-4f ) ) );
+            y = _mm_sub_ps( y, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) );
+            x = _mm_add_ps( x, y );
+            x = _mm_add_ps( x, _mm_mul_ps( e, _mm_set1_ps( 0.693359375f ) ) );
+            return FVec<float>( x );
+        }
+        /*! 
+         * \brief sine and cosine of each element, accurate for |x| up to a few thousands
+         * \param src input
+         * \param vsin output sine
+         * \param vcos output cosine
+         */
+        MSHADOW_CINLINE void SinCos( const FVec<float> &src, FVec<float> *vsin, FVec<float> *vcos ){
+            const __m128 sign_mask = _mm_castsi128_ps( _mm_set1_epi32( 0x80000000 ) );
+            __m128 x = _mm_andnot_ps( sign_mask, src.data_ );
+            __m128 sign_sin = _mm_and_ps( src.data_, sign_mask );
+            // octant of x, j = (int)(x * 4/pi), j = (j+1) & ~1
+            __m128i emm2 = _mm_cvttps_epi32( _mm_mul_ps( x, _mm_set1_ps( 1.27323954473516f ) ) );
+            emm2 = _mm_add_epi32( emm2, _mm_set1_epi32( 1 ) );
+            emm2 = _mm_and_si128( emm2, _mm_set1_epi32( ~1 ) );
+            __m128 y = _mm_cvtepi32_ps( emm2 );
+            __m128i emm4 = emm2;
+            __m128 swap_sign_sin = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( emm2, _mm_set1_epi32( 4 ) ), 29 ) );
+            __m128 poly_mask = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( emm2, _mm_set1_epi32( 2 ) ), _mm_setzero_si128() ) );
+            // extended precision modular arithmetic, x = ((x - y * DP1) - y * DP2) - y * DP3
+            x = _mm_add_ps( x, _mm_mul_ps( y, _mm_set1_ps( -0.78515625f ) ) );
+            x = _mm_add_ps( x, _mm_mul_ps( y, _mm_set1_ps( -2.4187564849853515625e-4f ) ) );
+            x = _mm_add_ps( x, _mm_mul_ps( y, _mm_set1_ps( -3.77489497744594108e-8f ) ) );
+            emm4 = _mm_sub_epi32( emm4, _mm_set1_epi32( 2 ) );
+            emm4 = _mm_andnot_si128( emm4, _mm_set1_epi32( 4 ) );
+            __m128 sign_cos = _mm_castsi128_ps( _mm_slli_epi32( emm4, 29 ) );
+            sign_sin = _mm_xor_ps( sign_sin, swap_sign_sin );
+            // cosine polynomial in [0,pi/4]
+            __m128 z = _mm_mul_ps( x, x );
+            __m128 yc = _mm_set1_ps( 2.443315711809948E-005f );
+            yc = _mm_add_ps( _mm_mul_ps( yc, z ), _mm_set1_ps( -1.388731625493765E-003f ) );
+            yc = _mm_add_ps( _mm_mul_ps( yc, z ), _mm_set1_ps( 4.166664568298827E-002f ) );
+            yc = _mm_mul_ps( _mm_mul_ps( yc, z ), z );
+            yc = _mm_sub_ps( yc, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) );
+            yc = _mm_add_ps( yc, _mm_set1_ps( 1.0f ) );
+            // sine polynomial in [0,pi/4]
+            __m128 ys = _mm_set1_ps( -1.9515295891E-4f );
+            ys = _mm_add_ps( _mm_mul_ps( ys, z ), _mm_set1_ps( 8.3321608736E-3f ) );
+            ys = _mm_add_ps( _mm_mul_ps( ys, z ), _mm_set1_ps( -1.6666654611E-1f ) );
+            ys = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( ys, z ), x ), x );
+            // select the polynomial by octant
+            __m128 rsin = _mm_or_ps( _mm_and_ps( poly_mask, ys ), _mm_andnot_ps( poly_mask, yc ) );
+            __m128 rcos = _mm_or_ps( _mm_and_ps( poly_mask, yc ), _mm_andnot_ps( poly_mask, ys ) );
+            vsin->data_ = _mm_xor_ps( rsin, sign_sin );
+            vcos->data_ = _mm_xor_ps( rcos, sign_cos );
+        }
+    }; // namespace sse2
+
     namespace sse2{
         /*! \brief sse2 operator type of certain operator */
         template<typename OP>
@@ -257,45 +442,61 @@ namespace mshadow{
             MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const;
         };
 
-        template <typename Device, int dim>
-        class SSEPlan< Tensor<Device,dim> >{
+        template <typename Device, int dim, typename DType>
+        class SSEPlan< Tensor<Device,dim,DType> >{
         public:
-            SSEPlan( const Tensor<Device,dim> &t )
+            SSEPlan( const Tensor<Device,dim,DType> &t )
                 :dptr_(t.dptr),stride_(t.shape.stride_){}
-            MSHADOW_CINLINE sse2::FVec<real_t> EvalSSE( index_t y, index_t x ) const{
-                return sse2::FVec<real_t>( &dptr_[ y*stride_+x ] );
+            MSHADOW_CINLINE sse2::FVec<DType> EvalSSE( index_t y, index_t x ) const{
+                return sse2::FVec<DType>( &dptr_[ y*stride_+x ] );
             }
-            MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_CINLINE DType Eval( index_t y, index_t x ) const{
                 return dptr_[ y * stride_ + x ];
             }
         private:
-            const real_t  *dptr_;
+            const DType  *dptr_;
             index_t stride_;
         };
 
-        template<>
-        class SSEPlan<ScalarExp>{
+        template<typename DType>
+        class SSEPlan< ScalarExp<DType> >{
         public:
-            SSEPlan( real_t scalar ):scalar_(scalar){}
-            MSHADOW_CINLINE sse2::FVec<real_t> EvalSSE( index_t y, index_t x ) const{
-                return sse2::FVec<real_t>( scalar_ );
+            SSEPlan( DType scalar ):scalar_(scalar){}
+            MSHADOW_CINLINE sse2::FVec<DType> EvalSSE( index_t y, index_t x ) const{
+                return sse2::FVec<DType>( scalar_ );
             }
-            MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_CINLINE DType Eval( index_t y, index_t x ) const{
                 return scalar_;
             }
         private:
-            real_t scalar_;
+            DType scalar_;
+        };
+
+        template<typename SubType, typename SrcExp, int dim>
+        class SSEPlan< MakeTensorExp<SubType,SrcExp,dim> >{
+        public:
+            typedef typename ExpInfo< MakeTensorExp<SubType,SrcExp,dim> >::DType DType;
+            SSEPlan( const SSEPlan<SubType> &src ):src_(src){}
+            MSHADOW_CINLINE sse2::FVec<DType> EvalSSE( index_t y, index_t x ) const{
+                return src_.EvalSSE( y, x );
+            }
+            MSHADOW_CINLINE DType Eval( index_t y, index_t x ) const{
+                return src_.Eval( y, x );
+            }
+        private:
+            SSEPlan<SubType> src_;
         };
 
         template<typename OP, typename TA, typename TB,int etype>
         class SSEPlan< BinaryMapExp<OP,TA,TB,etype> >{
         public:
+            typedef typename ExpInfo<TA>::DType DType;
             SSEPlan( const SSEPlan<TA> &lhs, const SSEPlan<TB> &rhs )
                 :lhs_(lhs), rhs_(rhs){}
-            MSHADOW_CINLINE sse2::FVec<real_t> EvalSSE( index_t y, index_t x ) const{
+            MSHADOW_CINLINE sse2::FVec<DType> EvalSSE( index_t y, index_t x ) const{
                 return sse2::SSEOp<OP>::Map( lhs_.EvalSSE( y, x ), rhs_.EvalSSE( y, x ) );
             }
-            MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_CINLINE DType Eval( index_t y, index_t x ) const{
                 return OP::Map( lhs_.Eval( y, x ), rhs_.Eval( y, x ) );
             }
         private:
@@ -306,11 +507,12 @@ namespace mshadow{
         template<typename OP, typename TA, int etype>
         class SSEPlan< UnaryMapExp<OP,TA,etype> >{
         public:
+            typedef typename ExpInfo<TA>::DType DType;
             SSEPlan( const SSEPlan<TA> &src ):src_(src){}
-            MSHADOW_CINLINE sse2::FVec<real_t> EvalSSE( index_t y, index_t x ) const{
+            MSHADOW_CINLINE sse2::FVec<DType> EvalSSE( index_t y, index_t x ) const{
                 return sse2::SSEOp<OP>::Map( src_.EvalSSE( y, x ) );
             }
-            MSHADOW_CINLINE real_t Eval( index_t y, index_t x ) const{
+            MSHADOW_CINLINE DType Eval( index_t y, index_t x ) const{
                 return OP::Map( src_.Eval( y, x ) );
             }
         private:
@@ -320,17 +522,18 @@ namespace mshadow{
         template<typename OP, typename TA, typename TB, int etype>
         inline SSEPlan< BinaryMapExp<OP,TA,TB,etype> > MakeSSEPlan( const BinaryMapExp<OP,TA,TB,etype> &e );
 
-        inline SSEPlan<ScalarExp> MakeSSEPlan( const ScalarExp &e ){
-            return SSEPlan<ScalarExp>( e.scalar_ );
+        template<typename DType>
+        inline SSEPlan< ScalarExp<DType> > MakeSSEPlan( const ScalarExp<DType> &e ){
+            return SSEPlan< ScalarExp<DType> >( e.scalar_ );
         }
 
-        template<typename T>
-        inline SSEPlan<T> MakeSSEPlan( const ContainerExp<T> &e ){
+        template<typename T, typename DType>
+        inline SSEPlan<T> MakeSSEPlan( const ContainerExp<T,DType> &e ){
             return SSEPlan<T>( e.self() );
         }
 
-        template<typename T,int dim>
-        inline SSEPlan<T> MakeSSEPlan( const MakeTensorExp<T,cpu,dim> &e ){
+        template<typename T, typename SrcExp, int dim>
+        inline SSEPlan<T> MakeSSEPlan( const MakeTensorExp<T,SrcExp,dim> &e ){
             return SSEPlan<T>( e.real_self() );
         }
 
@@ -357,12 +560,21 @@ namespace mshadow{
         struct SSECheck{
             const static bool kPass = false;
         };
+        // only float and double have sse vector type
+        template<>
+        struct SSECheck< ScalarExp<float> >{
+            const static bool kPass = true;
+        };
         template<>
-        struct SSECheck<ScalarExp>{
+        struct SSECheck< ScalarExp<double> >{
+            const static bool kPass = true;
+        };
+        template<int dim>
+        struct SSECheck< Tensor<cpu,dim,float> >{
             const static bool kPass = true;
         };
         template<int dim>
-        struct SSECheck<Tensor<cpu,dim> >{
+        struct SSECheck< Tensor<cpu,dim,double> >{
             const static bool kPass = true;
         };
         
@@ -383,16 +595,16 @@ namespace mshadow{
                 return false;
             }
         };
-        template<int dim>
-        struct SSEAlignCheck< dim, ScalarExp >{
-            inline static bool Check( const ScalarExp &exp ){
+        template<int dim, typename DType>
+        struct SSEAlignCheck< dim, ScalarExp<DType> >{
+            inline static bool Check( const ScalarExp<DType> &exp ){
                 return true;
             }
         };
-        template<int dim>
-        struct SSEAlignCheck< dim,Tensor<cpu,dim> >{
-            inline static bool Check( const Tensor<cpu,dim> &t ){
-                return sse2::CheckAlign( t.dptr ) && sse2::CheckAlign( t.shape.stride_ * sizeof( real_t ) );
+        template<int dim, typename DType>
+        struct SSEAlignCheck< dim,Tensor<cpu,dim,DType> >{
+            inline static bool Check( const Tensor<cpu,dim,DType> &t ){
+                return sse2::CheckAlign( t.dptr ) && sse2::CheckAlign( t.shape.stride_ * sizeof( DType ) );
             }
         };
         template<int dim, typename OP, typename TA, int etype>
@@ -411,15 +623,15 @@ namespace mshadow{
     }; // namespace expr
 
     /*! 
-     * \brief use SSEPlan to compute result
+     * \brief use SSEPlan to compute result, the vector has the compute type of DType
      */
-    template<typename SV, typename E, int dim>
-    inline void MapSSEPlan(Tensor<cpu,dim> _dst, const expr::SSEPlan<E> &plan){        
-        Tensor<cpu,2> dst = _dst.FlatTo2D();
-        const index_t xlen = sse2::LowerAlign( dst.shape[0], sizeof(real_t) );
+    template<typename SV, typename E, int dim, typename DType>
+    inline void MapSSEPlan(Tensor<cpu,dim,DType> _dst, const expr::SSEPlan<E> &plan){        
+        Tensor<cpu,2,DType> dst = _dst.FlatTo2D();
+        const index_t xlen = sse2::LowerAlign( dst.shape[0], sizeof(DType) );
         for ( index_t y = 0; y < dst.shape[1]; y ++ ) {
-            for( index_t x = 0; x < xlen; x += sse2::FVec<real_t>::kSize ){
-                sse2::Saver<SV,real_t>::Save( &dst[y][x], plan.EvalSSE( y,x ) );
+            for( index_t x = 0; x < xlen; x += sse2::FVec< typename DataType<DType>::ComputeType >::kSize ){
+                sse2::Saver<SV,DType>::Save( &dst[y][x], plan.EvalSSE( y,x ) );
             }
             for( index_t x = xlen; x < dst.shape[0]; x ++ ){
                 SV::Save( dst[y][x], plan.Eval(y,x) );
@@ -0,0 +1,138 @@
+#ifndef MSHADOW_TENSOR_THREAD_H
+#define MSHADOW_TENSOR_THREAD_H
+/*!
+ * \file tensor_thread.h
+ * \brief minimal thread utilities used by background workers, wrappers of pthread
+ *        when MSHADOW_USE_PTHREAD is 0, the lock operations do nothing and threads can not be created
+ */
+#include "tensor_base.h"
+#if MSHADOW_USE_PTHREAD
+#include <pthread.h>
+#endif
+
+namespace mshadow{
+    namespace utils{
+        /*! \brief mutual exclusion lock */
+        class Mutex{
+        public:
+            Mutex( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_mutex_init( &mutex_, NULL );
+                #endif
+            }
+            ~Mutex( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_mutex_destroy( &mutex_ );
+                #endif
+            }
+            inline void Lock( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_mutex_lock( &mutex_ );
+                #endif
+            }
+            inline void Unlock( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_mutex_unlock( &mutex_ );
+                #endif
+            }
+        private:
+            friend class ConditionVariable;
+            #if MSHADOW_USE_PTHREAD
+            pthread_mutex_t mutex_;
+            #endif
+            // not copyable
+            Mutex( const Mutex &m );
+            Mutex& operator=( const Mutex &m );
+        };
+        /*! \brief hold the lock of mutex in the scope */
+        class ScopedLock{
+        public:
+            explicit ScopedLock( Mutex &m ):m_(m){
+                m_.Lock();
+            }
+            ~ScopedLock( void ){
+                m_.Unlock();
+            }
+        private:
+            Mutex &m_;
+            ScopedLock( const ScopedLock &l );
+            ScopedLock& operator=( const ScopedLock &l );
+        };
+        /*! \brief condition variable, used with Mutex */
+        class ConditionVariable{
+        public:
+            ConditionVariable( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_cond_init( &cond_, NULL );
+                #endif
+            }
+            ~ConditionVariable( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_cond_destroy( &cond_ );
+                #endif
+            }
+            /*! \brief wait for signal, m must be locked by the caller */
+            inline void Wait( Mutex &m ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_cond_wait( &cond_, &m.mutex_ );
+                #else
+                utils::Error( "ConditionVariable: waiting without thread support would block forever" );
+                #endif
+            }
+            /*! \brief wake up one waiting thread */
+            inline void Signal( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_cond_signal( &cond_ );
+                #endif
+            }
+            /*! \brief wake up all waiting threads */
+            inline void Broadcast( void ){
+                #if MSHADOW_USE_PTHREAD
+                pthread_cond_broadcast( &cond_ );
+                #endif
+            }
+        private:
+            #if MSHADOW_USE_PTHREAD
+            pthread_cond_t cond_;
+            #endif
+            ConditionVariable( const ConditionVariable &c );
+            ConditionVariable& operator=( const ConditionVariable &c );
+        };
+        /*! \brief a thread running a function */
+        class Thread{
+        public:
+            Thread( void ):started_(false){}
+            /*!
+             * \brief start the thread
+             * \param func function to run
+             * \param arg argument passed to func
+             */
+            inline void Start( void *(*func)( void* ), void *arg ){
+                #if MSHADOW_USE_PTHREAD
+                utils::Assert( !started_, "Thread: already started" );
+                utils::Assert( pthread_create( &thread_, NULL, func, arg ) == 0, "Thread: failed to create thread" );
+                started_ = true;
+                #else
+                utils::Error( "Thread: compiled without thread support, set MSHADOW_USE_PTHREAD=1" );
+                #endif
+            }
+            /*! \brief wait for the thread to finish */
+            inline void Join( void ){
+                #if MSHADOW_USE_PTHREAD
+                if( started_ ){
+                    pthread_join( thread_, NULL );
+                    started_ = false;
+                }
+                #endif
+            }
+        private:
+            bool started_;
+            #if MSHADOW_USE_PTHREAD
+            pthread_t thread_;
+            #endif
+            Thread( const Thread &t );
+            Thread& operator=( const Thread &t );
+        };
+    };
+};
+#endif // MSHADOW_TENSOR_THREAD_H